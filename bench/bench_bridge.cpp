@@ -0,0 +1,189 @@
+#include "benchmark/benchmark.h"
+
+#include "bridge.hpp"
+#include "mockmixer.hpp"
+#include "package.hpp"
+
+#include "asio/co_spawn.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "libremidi/message.hpp"
+#include "spdlog/spdlog.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sls3mcubridge {
+
+namespace {
+const size_t MESSAGES_PER_READ = 16;
+// Every start creates the virtual midi ports of the bridge anew.
+const int STARTUPS = 20;
+
+// A bridge connected to the mock mixer on the loopback interface, which only
+// answers the handshake. The mixer runs on the io_context of the bridge.
+class BridgeFixture {
+public:
+  BridgeFixture()
+      : m_acceptor(m_io_context, asio::ip::tcp::endpoint(
+                                     asio::ip::address_v4::loopback(), 0)) {
+    serve_mock_mixer(m_io_context, m_acceptor, TrafficConfig{}, nullptr);
+    // Keep per message logging out of the measurements.
+    spdlog::set_level(spdlog::level::err);
+    m_bridge = std::make_shared<Bridge>(
+        m_io_context.get_executor(), "127.0.0.1",
+        m_acceptor.local_endpoint().port(), BridgeConfig{});
+    bool started = false;
+    asio::co_spawn(m_io_context, m_bridge->start(),
+                   [this, &started](const std::exception_ptr &error) {
+                     started = true;
+                     try {
+                       if (error) {
+                         std::rethrow_exception(error);
+                       }
+                     } catch (std::exception &exc) {
+                       m_error = exc.what();
+                     }
+                   });
+    while (!started) {
+      m_io_context.run_one();
+    }
+  }
+  BridgeFixture(const BridgeFixture &obj) = delete;
+  BridgeFixture(BridgeFixture &&obj) = delete;
+  BridgeFixture &operator=(const BridgeFixture &obj) = delete;
+  BridgeFixture &operator=(BridgeFixture &&obj) = delete;
+  ~BridgeFixture() {
+    m_bridge->stop();
+    m_bridge.reset();
+    m_acceptor.close();
+    m_io_context.restart();
+    m_io_context.run();
+  }
+
+  static BridgeFixture &get() {
+    static BridgeFixture fixture;
+    return fixture;
+  }
+
+  Bridge *bridge() { return m_bridge.get(); }
+  asio::io_context &io_context() { return m_io_context; }
+  [[nodiscard]] const std::string &error() const { return m_error; }
+
+private:
+  asio::io_context m_io_context;
+  asio::ip::tcp::acceptor m_acceptor;
+  std::shared_ptr<Bridge> m_bridge;
+  std::string m_error;
+};
+} // namespace
+
+// Mixer to DAW: one fader move per package.
+static void BM_BridgeHandleTcpRead(benchmark::State &state) {
+  auto &fixture = BridgeFixture::get();
+  if (!fixture.error().empty()) {
+    state.SkipWithError(fixture.error().c_str());
+    return;
+  }
+  auto frame = FADER_FRAME;
+  for (auto _ : state) {
+    auto package =
+        tcp::PackageView(tcp::BufferView(frame.begin(), frame.end()));
+    fixture.bridge()->handle_tcp_read(package);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_BridgeHandleTcpRead);
+
+// DAW to mixer: a burst of fader moves, coalesced and written to the socket.
+static void BM_BridgeHandleMidiRead(benchmark::State &state) {
+  auto &fixture = BridgeFixture::get();
+  if (!fixture.error().empty()) {
+    state.SkipWithError(fixture.error().c_str());
+    return;
+  }
+  std::vector<libremidi::message> messages;
+  for (unsigned char i = 0; i < MESSAGES_PER_READ; i++) {
+    messages.emplace_back(libremidi::message({0xe0, i, 0x40}));
+  }
+  for (auto _ : state) {
+    for (const auto &message : messages) {
+      fixture.bridge()->handle_midi_read(0, message);
+    }
+    fixture.io_context().restart();
+    fixture.io_context().poll();
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * MESSAGES_PER_READ));
+}
+BENCHMARK(BM_BridgeHandleMidiRead);
+
+// Bridge::start() against the mock mixer on the loopback interface, which
+// announces `devices` midi devices: connecting, the handshake and creating
+// the virtual midi ports, until the bridge forwards. Every start uses ports of
+// its own.
+static void BM_BridgeStartup(benchmark::State &state) {
+  TrafficConfig mixer_config;
+  mixer_config.devices = static_cast<int>(state.range(0));
+  spdlog::set_level(spdlog::level::err);
+  int run = 0;
+  for (auto _ : state) {
+    asio::io_context io_context;
+    asio::ip::tcp::acceptor acceptor(
+        io_context,
+        asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    serve_mock_mixer(io_context, acceptor, mixer_config, nullptr);
+    BridgeConfig config;
+    config.midi_port_prefix = "BenchStartup" + std::to_string(run++) + "_";
+    auto bridge = std::make_shared<Bridge>(io_context.get_executor(),
+                                           "127.0.0.1",
+                                           acceptor.local_endpoint().port(),
+                                           config);
+
+    bool started = false;
+    std::string error;
+    auto begin = std::chrono::steady_clock::now();
+    asio::co_spawn(io_context, bridge->start(),
+                   [&started, &error](const std::exception_ptr &exc) {
+                     started = true;
+                     try {
+                       if (exc) {
+                         std::rethrow_exception(exc);
+                       }
+                     } catch (std::exception &failure) {
+                       error = failure.what();
+                     }
+                   });
+    while (!started) {
+      io_context.run_one();
+    }
+    state.SetIterationTime(std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - begin)
+                               .count());
+
+    bridge->stop();
+    bridge.reset();
+    acceptor.close();
+    io_context.restart();
+    io_context.run();
+    if (!error.empty()) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+}
+BENCHMARK(BM_BridgeStartup)
+    ->ArgName("devices")
+    ->Arg(1)
+    ->Arg(5)
+    ->Iterations(STARTUPS)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace sls3mcubridge
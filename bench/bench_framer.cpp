@@ -0,0 +1,170 @@
+#include "benchmark/benchmark.h"
+
+#include "framer.hpp"
+#include "package.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace sls3mcubridge::tcp {
+
+namespace {
+const size_t CAPTURE_FRAMES = 1024;
+const size_t RECEIVE_BUFFER_SIZE = 1500;
+const size_t MAX_GARBAGE_SIZE = 32;
+const size_t READ_SIZE = 256;
+
+// Builds a capture of mixer to DAW traffic: channel messages mixed with short
+// LCD SysEx updates, as seen while moving faders.
+std::vector<std::byte> make_capture(std::mt19937 &rng) {
+  const std::array<std::byte, 16> midi_frame = {
+      std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+      std::byte(0x0a), std::byte(0x00), std::byte(0x4d), std::byte(0x4d),
+      std::byte(0x00), std::byte(0x00), std::byte(0x6c), std::byte(0x00),
+      std::byte(0xe0), std::byte(0x10), std::byte(0x7f), std::byte(0x00)};
+  const std::array<std::byte, 21> sysex_frame = {
+      std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+      std::byte(0x0f), std::byte(0x00), std::byte(0x53), std::byte(0x53),
+      std::byte(0x00), std::byte(0x00), std::byte(0x6c), std::byte(0x00),
+      std::byte(0x07), std::byte(0x00), std::byte(0xf0), std::byte(0x00),
+      std::byte(0x00), std::byte(0x66), std::byte(0x15), std::byte(0x00),
+      std::byte(0xf7)};
+
+  std::uniform_int_distribution<int> pick(0, 7);
+  std::uniform_int_distribution<int> value(0, 0x7f);
+  std::vector<std::byte> capture;
+  for (size_t i = 0; i < CAPTURE_FRAMES; i++) {
+    if (pick(rng) == 0) {
+      capture.insert(capture.end(), sysex_frame.begin(), sysex_frame.end());
+    } else {
+      auto frame = midi_frame;
+      frame[13] = std::byte(value(rng));
+      frame[14] = std::byte(value(rng));
+      capture.insert(capture.end(), frame.begin(), frame.end());
+    }
+  }
+  return capture;
+}
+
+// Inserts 1 to MAX_GARBAGE_SIZE random bytes in front of about one in
+// `garbage_every` frames of the capture.
+std::vector<std::byte> inject_garbage(std::mt19937 &rng,
+                                      const std::vector<std::byte> &capture,
+                                      int64_t garbage_every) {
+  std::uniform_int_distribution<int64_t> pick(1, garbage_every);
+  std::uniform_int_distribution<size_t> size(1, MAX_GARBAGE_SIZE);
+  std::uniform_int_distribution<int> value(0, UINT8_MAX);
+  std::vector<std::byte> output;
+  for (size_t i = 0; i < capture.size(); i++) {
+    // Every frame starts with 'U', 'C'.
+    if (capture[i] == std::byte('U') && i + 1 < capture.size() &&
+        capture[i + 1] == std::byte('C') && pick(rng) == 1) {
+      for (auto garbage = size(rng); garbage > 0; garbage--) {
+        output.push_back(std::byte(value(rng)));
+      }
+    }
+    output.push_back(capture[i]);
+  }
+  return output;
+}
+
+// Splits the capture into reads of random size, up to `max_fragment` bytes.
+std::vector<size_t> make_fragments(std::mt19937 &rng, size_t capture_size,
+                                   size_t max_fragment) {
+  std::uniform_int_distribution<size_t> size(1, max_fragment);
+  std::vector<size_t> fragments;
+  size_t total = 0;
+  while (total < capture_size) {
+    auto fragment = std::min(size(rng), capture_size - total);
+    fragments.push_back(fragment);
+    total += fragment;
+  }
+  return fragments;
+}
+} // namespace
+
+static void BM_FramerFragmentedCapture(benchmark::State &state) {
+  std::mt19937 rng(42); // NOLINT
+  auto capture = make_capture(rng);
+  auto fragments =
+      make_fragments(rng, capture.size(), static_cast<size_t>(state.range(0)));
+  StreamFramer framer(RECEIVE_BUFFER_SIZE);
+
+  size_t frames = 0;
+  for (auto _ : state) {
+    const auto *source = capture.data();
+    for (auto fragment : fragments) {
+      auto free_space = framer.prepare();
+      auto read_size = std::min(fragment, free_space.distance());
+      std::copy(source, source + read_size, free_space.begin());
+      source += read_size;
+      framer.commit(read_size);
+      while (auto frame = framer.next_frame()) {
+        benchmark::DoNotOptimize(frame->begin());
+        frames++;
+      }
+      framer.compact();
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(frames));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(capture.size()));
+}
+BENCHMARK(BM_FramerFragmentedCapture)
+    ->Arg(1)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(256)
+    ->Arg(RECEIVE_BUFFER_SIZE);
+
+// Capture with random bytes in front of one in `garbage_every` frames, 0 for
+// none, read by a resynchronizing framer.
+static void BM_FramerResync(benchmark::State &state) {
+  std::mt19937 rng(42); // NOLINT
+  auto capture = make_capture(rng);
+  if (state.range(0) > 0) {
+    capture = inject_garbage(rng, capture, state.range(0));
+  }
+  StreamFramer framer(RECEIVE_BUFFER_SIZE, true);
+
+  size_t frames = 0;
+  for (auto _ : state) {
+    const auto *source = capture.data();
+    auto remaining = capture.size();
+    while (remaining > 0) {
+      auto free_space = framer.prepare();
+      auto read_size = std::min({READ_SIZE, remaining, free_space.distance()});
+      std::copy(source, source + read_size, free_space.begin());
+      source += read_size;
+      remaining -= read_size;
+      framer.commit(read_size);
+      while (auto frame = framer.next_frame()) {
+        benchmark::DoNotOptimize(frame->begin());
+        frames++;
+      }
+      framer.compact();
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(frames));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(capture.size()));
+  state.counters["resyncs"] =
+      benchmark::Counter(static_cast<double>(framer.get_resyncs()),
+                         benchmark::Counter::kAvgIterations);
+  state.counters["skipped_bytes"] =
+      benchmark::Counter(static_cast<double>(framer.get_skipped_bytes()),
+                         benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_FramerResync)
+    ->ArgName("garbage_every")
+    ->Arg(0)
+    ->Arg(1000)
+    ->Arg(100)
+    ->Arg(10)
+    ->Arg(1);
+
+} // namespace sls3mcubridge::tcp
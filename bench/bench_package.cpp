@@ -0,0 +1,163 @@
+#include "benchmark/benchmark.h"
+
+#include "package.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sls3mcubridge::tcp {
+
+namespace {
+// Bodies as received from and sent to the mixer, see test_unit_package.cpp.
+const std::vector<std::byte> INCOMMING_MIDI_BODY = {
+    std::byte(0x4d), std::byte(0x4d), std::byte(0x00), std::byte(0x00),
+    std::byte(0x6c), std::byte(0x00), std::byte(0x90), std::byte(0x10),
+    std::byte(0x7f), std::byte(0x00)};
+
+const std::vector<std::byte> OUTGOING_MIDI_BODY = {
+    std::byte(0x4d), std::byte(0x41), std::byte(0x00), std::byte(0x00),
+    std::byte(0x68), std::byte(0x00), std::byte(0x0f), std::byte(0xb0),
+    std::byte(0x40), std::byte(0x30), std::byte(0xb0), std::byte(0x41),
+    std::byte(0x30), std::byte(0xb0), std::byte(0x42), std::byte(0x30),
+    std::byte(0xb0), std::byte(0x43), std::byte(0x30), std::byte(0xb0),
+    std::byte(0x44), std::byte(0x30), std::byte(0xb0), std::byte(0x45),
+    std::byte(0x30), std::byte(0xb0), std::byte(0x46), std::byte(0x30),
+    std::byte(0xb0), std::byte(0x47), std::byte(0x30), std::byte(0xb0),
+    std::byte(0x48), std::byte(0x30), std::byte(0xb0), std::byte(0x49),
+    std::byte(0x30), std::byte(0xb0), std::byte(0x4b), std::byte(0x30),
+    std::byte(0xb0), std::byte(0x4a), std::byte(0x30), std::byte(0xb0),
+    std::byte(0x30), std::byte(0x30), std::byte(0xb0), std::byte(0x31),
+    std::byte(0x30), std::byte(0xb0), std::byte(0x32), std::byte(0x30)};
+
+const std::vector<std::byte> SYSEX_BODY = {
+    std::byte(0x53), std::byte(0x53), std::byte(0x00), std::byte(0x00),
+    std::byte(0x68), std::byte(0x00), std::byte(0x07), std::byte(0x00),
+    std::byte(0xf0), std::byte(0x00), std::byte(0x00), std::byte(0x66),
+    std::byte(0x15), std::byte(0x00), std::byte(0xf7)};
+
+const std::vector<std::byte> HEADER = {std::byte('U'),  std::byte('C'),
+                                       std::byte(0x00), std::byte(0x01),
+                                       std::byte(0x0a), std::byte(0x00)};
+
+const std::vector<std::byte> UNKOWN_BODY = {
+    std::byte(0x3d), std::byte(0x4d), std::byte(0x00), std::byte(0x00),
+    std::byte(0x6c), std::byte(0x00), std::byte(0x90), std::byte(0x10),
+    std::byte(0x7f), std::byte(0x00)};
+
+std::vector<std::byte> make_frame(const std::vector<std::byte> &body) {
+  std::vector<std::byte> frame = {std::byte('U'),  std::byte('C'),
+                                  std::byte(0x00), std::byte(0x01),
+                                  std::byte(body.size()), std::byte(0x00)};
+  frame.insert(frame.end(), body.begin(), body.end());
+  return frame;
+}
+} // namespace
+
+static void BM_HeaderParse(benchmark::State &state) {
+  auto buffer = HEADER;
+  for (auto _ : state) {
+    auto header =
+        Header(BufferView(buffer.data(), buffer.data() + buffer.size()));
+    benchmark::DoNotOptimize(header.get_body_size());
+  }
+}
+BENCHMARK(BM_HeaderParse);
+
+static void BM_HeaderSerializeInto(benchmark::State &state) {
+  auto buffer = HEADER;
+  auto header =
+      Header(BufferView(buffer.data(), buffer.data() + buffer.size()));
+  std::array<std::byte, HEADER_SIZE> output{};
+  for (auto _ : state) {
+    auto size = header.serialize_into(output);
+    benchmark::DoNotOptimize(size);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_HeaderSerializeInto);
+
+static void BM_BodyCreate(benchmark::State &state,
+                          const std::vector<std::byte> &input) {
+  auto buffer = input;
+  for (auto _ : state) {
+    auto body = Body::create(BufferView(buffer.data(),
+                                        buffer.data() + buffer.size()));
+    benchmark::DoNotOptimize(body.get());
+  }
+}
+BENCHMARK_CAPTURE(BM_BodyCreate, IncommingMidi, INCOMMING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_BodyCreate, OutgoingMidi, OUTGOING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_BodyCreate, SysEx, SYSEX_BODY);
+BENCHMARK_CAPTURE(BM_BodyCreate, Unkown, UNKOWN_BODY);
+
+static void BM_DecodeBody(benchmark::State &state,
+                          const std::vector<std::byte> &input) {
+  auto buffer = input;
+  for (auto _ : state) {
+    auto body =
+        decode_body(BufferView(buffer.data(), buffer.data() + buffer.size()));
+    benchmark::DoNotOptimize(body);
+  }
+}
+BENCHMARK_CAPTURE(BM_DecodeBody, IncommingMidi, INCOMMING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_DecodeBody, OutgoingMidi, OUTGOING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_DecodeBody, SysEx, SYSEX_BODY);
+BENCHMARK_CAPTURE(BM_DecodeBody, Unkown, UNKOWN_BODY);
+
+// A vector per call, the baseline for BM_BodySerializeInto.
+static void BM_BodySerialize(benchmark::State &state,
+                             const std::vector<std::byte> &input) {
+  auto buffer = input;
+  auto body =
+      Body::create(BufferView(buffer.data(), buffer.data() + buffer.size()));
+  for (auto _ : state) {
+    auto bytes = body->serialize();
+    benchmark::DoNotOptimize(bytes.data());
+  }
+}
+BENCHMARK_CAPTURE(BM_BodySerialize, IncommingMidi, INCOMMING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_BodySerialize, OutgoingMidi, OUTGOING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_BodySerialize, SysEx, SYSEX_BODY);
+BENCHMARK_CAPTURE(BM_BodySerialize, Unkown, UNKOWN_BODY);
+
+static void BM_BodySerializeInto(benchmark::State &state,
+                                 const std::vector<std::byte> &input) {
+  auto buffer = input;
+  auto body =
+      Body::create(BufferView(buffer.data(), buffer.data() + buffer.size()));
+  std::array<std::byte, MAX_PACKAGE_SIZE> output{};
+  for (auto _ : state) {
+    auto size = body->serialize_into(output);
+    benchmark::DoNotOptimize(size);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK_CAPTURE(BM_BodySerializeInto, IncommingMidi, INCOMMING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_BodySerializeInto, OutgoingMidi, OUTGOING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_BodySerializeInto, SysEx, SYSEX_BODY);
+BENCHMARK_CAPTURE(BM_BodySerializeInto, Unkown, UNKOWN_BODY);
+
+// Parses a complete frame and serializes it again, as a proxy that forwards
+// packages would do.
+static void BM_PackageRoundTrip(benchmark::State &state,
+                                const std::vector<std::byte> &body) {
+  auto frame = make_frame(body);
+  std::array<std::byte, MAX_PACKAGE_SIZE> output{};
+  for (auto _ : state) {
+    auto package =
+        Package(BufferView(frame.data(), frame.data() + frame.size()));
+    auto size = package.serialize_into(output);
+    benchmark::DoNotOptimize(size);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(frame.size()));
+}
+BENCHMARK_CAPTURE(BM_PackageRoundTrip, IncommingMidi, INCOMMING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_PackageRoundTrip, OutgoingMidi, OUTGOING_MIDI_BODY);
+BENCHMARK_CAPTURE(BM_PackageRoundTrip, SysEx, SYSEX_BODY);
+BENCHMARK_CAPTURE(BM_PackageRoundTrip, Unkown, UNKOWN_BODY);
+
+} // namespace sls3mcubridge::tcp
@@ -0,0 +1,99 @@
+#include "benchmark/benchmark.h"
+
+#include "latency.hpp"
+#include "realtime.hpp"
+
+#include "asio/io_context.hpp"
+#include "asio/steady_timer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+namespace sls3mcubridge {
+
+namespace {
+const std::chrono::microseconds TIMER_PERIOD(500);
+const int64_t TIMER_WAKEUPS = 4000;
+
+// Keeps every CPU busy at normal priority while it exists, like desktop load
+// competing with the bridge.
+class CpuLoad {
+public:
+  CpuLoad() {
+    auto nr_threads = std::max(1U, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < nr_threads; i++) {
+      m_threads.emplace_back([this]() {
+        while (!m_stop.load(std::memory_order_relaxed)) {
+        }
+      });
+    }
+  }
+  CpuLoad(const CpuLoad &obj) = delete;
+  CpuLoad(CpuLoad &&obj) = delete;
+  CpuLoad &operator=(const CpuLoad &obj) = delete;
+  CpuLoad &operator=(CpuLoad &&obj) = delete;
+  ~CpuLoad() {
+    m_stop.store(true, std::memory_order_relaxed);
+    for (auto &thread : m_threads) {
+      thread.join();
+    }
+  }
+
+private:
+  std::atomic<bool> m_stop = false;
+  std::vector<std::thread> m_threads;
+};
+
+double to_microseconds(std::chrono::nanoseconds value) {
+  return std::chrono::duration<double, std::micro>(value).count();
+}
+} // namespace
+
+// Lateness of an io_context timer, how the bridge wakes up for a coalesce
+// window or meter refresh, while all CPUs are busy. Arg 1 runs the timer
+// thread like --realtime does, which needs CAP_SYS_NICE or an rtprio limit.
+static void BM_TimerJitterUnderLoad(benchmark::State &state) {
+  int policy = 0;
+  sched_param param{};
+  pthread_getschedparam(pthread_self(), &policy, &param);
+  if (state.range(0) != 0) {
+    if (!make_thread_realtime(RealtimeConfig{}, "benchmark thread")) {
+      state.SkipWithError("SCHED_FIFO not permitted");
+      return;
+    }
+    prefault_stack();
+  }
+
+  LatencyHistogram lateness;
+  {
+    CpuLoad load;
+    asio::io_context io_context;
+    asio::steady_timer timer(io_context);
+    for (auto _ : state) {
+      auto due = std::chrono::steady_clock::now() + TIMER_PERIOD;
+      timer.expires_at(due);
+      timer.wait();
+      lateness.record(std::chrono::steady_clock::now() - due);
+    }
+  }
+  pthread_setschedparam(pthread_self(), policy, &param);
+
+  auto summary = lateness.summarize();
+  state.counters["p50_late_us"] = to_microseconds(summary.p50);
+  state.counters["p99_late_us"] = to_microseconds(summary.p99);
+  state.counters["max_late_us"] = to_microseconds(summary.max);
+}
+BENCHMARK(BM_TimerJitterUnderLoad)
+    ->ArgName("realtime")
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(TIMER_WAKEUPS)
+    ->UseRealTime();
+
+} // namespace sls3mcubridge
@@ -0,0 +1,173 @@
+#include "benchmark/benchmark.h"
+
+#include "coalescer.hpp"
+#include "framer.hpp"
+#include "libremidi/message.hpp"
+#include "midimessage.hpp"
+#include "package.hpp"
+#include "sysex.hpp"
+#include "writebatch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace sls3mcubridge::tcp {
+
+namespace {
+const size_t LCD_SYSEX_SIZE = 64;
+const size_t BATCH_SIZE = 16;
+// Room for the largest frame, like the client.
+const size_t RECEIVE_BUFFER_SIZE = MAX_PACKAGE_SIZE;
+
+Package make_control_change_package() {
+  // Outlives the packages referring to it.
+  static const ShortMessage message({0xb0, 0x10, 0x01});
+  std::shared_ptr<Body> body = std::make_shared<OutgoingMidiBody>(
+      std::byte(0x67), std::span(&message, 1));
+  return Package(body);
+}
+
+libremidi::message make_sysex(size_t size) {
+  libremidi::message message;
+  message.bytes.assign(size, 0x41);
+  message.bytes.front() = 0xf0;
+  message.bytes.back() = 0xf7;
+  return message;
+}
+
+Package make_sysex_package() {
+  // Outlives the packages referring to it.
+  static const auto message = make_sysex(LCD_SYSEX_SIZE);
+  std::shared_ptr<Body> body = std::make_shared<SysExMidiBody>(
+      std::byte(0x67), std::as_bytes(std::span(message.bytes)));
+  return Package(body);
+}
+} // namespace
+
+static void BM_SerializeVector_ControlChange(benchmark::State &state) {
+  auto package = make_control_change_package();
+  for (auto _ : state) {
+    auto bytes = package.serialize();
+    benchmark::DoNotOptimize(bytes.data());
+  }
+}
+BENCHMARK(BM_SerializeVector_ControlChange);
+
+static void BM_SerializeInto_ControlChange(benchmark::State &state) {
+  auto package = make_control_change_package();
+  std::array<std::byte, MAX_PACKAGE_SIZE> buffer{};
+  for (auto _ : state) {
+    auto size = package.serialize_into(buffer);
+    benchmark::DoNotOptimize(size);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_SerializeInto_ControlChange);
+
+static void BM_SerializeVector_SysEx(benchmark::State &state) {
+  auto package = make_sysex_package();
+  for (auto _ : state) {
+    auto bytes = package.serialize();
+    benchmark::DoNotOptimize(bytes.data());
+  }
+}
+BENCHMARK(BM_SerializeVector_SysEx);
+
+static void BM_SerializeInto_SysEx(benchmark::State &state) {
+  auto package = make_sysex_package();
+  std::array<std::byte, MAX_PACKAGE_SIZE> buffer{};
+  for (auto _ : state) {
+    auto size = package.serialize_into(buffer);
+    benchmark::DoNotOptimize(size);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_SerializeInto_SysEx);
+
+// Gathering a burst of packages into one write, compared with a vector per
+// package as Bridge::handle_midi_read used to do.
+static void BM_SerializeVector_Burst(benchmark::State &state) {
+  auto package = make_control_change_package();
+  for (auto _ : state) {
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+      auto bytes = package.serialize();
+      benchmark::DoNotOptimize(bytes.data());
+    }
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * BATCH_SIZE));
+}
+BENCHMARK(BM_SerializeVector_Burst);
+
+static void BM_WriteBatch_Burst(benchmark::State &state) {
+  auto package = make_control_change_package();
+  WriteBatch batch(BATCH_SIZE * package.serialized_size());
+  for (auto _ : state) {
+    batch.clear();
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+      batch.add(package);
+    }
+    benchmark::DoNotOptimize(batch.buffers().data());
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * BATCH_SIZE));
+}
+BENCHMARK(BM_WriteBatch_Burst);
+
+// Multi-kilobyte SysEx, e.g. a sample dump, written in one body or fragmented
+// when longer than one, and joined again from the frames the receiving side
+// reads. The longest is two fragments, MAX_SYSEX_SIZE.
+static void BM_LargeSysExRoundTrip(benchmark::State &state) {
+  auto sysex = make_sysex(static_cast<size_t>(state.range(0)));
+  MessageRun messages;
+  messages.push_back(std::span(sysex.bytes));
+  WriteBatch batch(MAX_SEGMENT_SIZE);
+  StreamFramer framer(RECEIVE_BUFFER_SIZE);
+  SysExAssembler assembler;
+  size_t joined = 0;
+  auto receive = [&](const WriteBatch &written) {
+    for (const auto &buffer : written.buffers()) {
+      auto remaining = std::span(static_cast<const std::byte *>(buffer.data()),
+                                 buffer.size());
+      // Read in pieces as large as the free space, like the client does.
+      while (!remaining.empty()) {
+        auto free_space = framer.prepare();
+        auto size = std::min(remaining.size(), free_space.distance());
+        std::copy_n(remaining.begin(), size, free_space.begin());
+        framer.commit(size);
+        remaining = remaining.subspan(size);
+        while (auto frame = framer.next_frame()) {
+          auto package = PackageView(*frame);
+          const auto &body = package.get_body<SysExMidiBodyView>();
+          joined +=
+              assembler.add({body.message.begin(), body.message.end()}).size();
+        }
+        framer.compact();
+      }
+    }
+  };
+
+  for (auto _ : state) {
+    batch.clear();
+    MidiCoalescer::encode(std::byte(0x67), messages, batch,
+                          [&](const WriteBatch &full) { receive(full); });
+    receive(batch);
+  }
+  if (joined != sysex.size() * state.iterations()) {
+    state.SkipWithError("SysEx not joined again");
+  }
+  state.SetBytesProcessed(
+      static_cast<int64_t>(state.iterations() * sysex.size()));
+}
+BENCHMARK(BM_LargeSysExRoundTrip)
+    ->Arg(1024)
+    ->Arg(4096)
+    ->Arg(16384)
+    ->Arg(MAX_SYSEX_SIZE);
+
+} // namespace sls3mcubridge::tcp
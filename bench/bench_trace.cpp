@@ -0,0 +1,34 @@
+#include "benchmark/benchmark.h"
+
+#include "package.hpp"
+#include "trace.hpp"
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+
+namespace sls3mcubridge {
+
+namespace {
+const std::array<std::byte, 3> FADER_MOVE = {std::byte(0xE0), std::byte(0x10),
+                                             std::byte(0x40)};
+} // namespace
+
+// Cost of a trace point on the hot path, Arg 1 records into the ring of the
+// thread, Arg 0 is the disabled check every trace point pays.
+static void BM_TraceRecord(benchmark::State &state) {
+  if (state.range(0) != 0) {
+    enable_tracing(
+        (std::filesystem::temp_directory_path() / "bench_trace.trace")
+            .string());
+  }
+  for (auto _ : state) {
+    trace(TraceStage::MixerFrame, 0, tcp::Body::Type::IncommingMidi,
+          FADER_MOVE);
+    benchmark::ClobberMemory();
+  }
+  disable_tracing();
+}
+BENCHMARK(BM_TraceRecord)->ArgName("enabled")->Arg(0)->Arg(1);
+
+} // namespace sls3mcubridge
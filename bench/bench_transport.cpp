@@ -0,0 +1,274 @@
+#include "benchmark/benchmark.h"
+
+#include "client.hpp"
+#include "latency.hpp"
+#include "lowlatency.hpp"
+#include "mockmixer.hpp"
+#include "package.hpp"
+#include "writebatch.hpp"
+
+#include "asio/awaitable.hpp"
+#include "asio/buffer.hpp"
+#include "asio/co_spawn.hpp"
+#include "asio/detached.hpp"
+#include "asio/error.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/post.hpp"
+#include "asio/read.hpp"
+#include "asio/write.hpp"
+#include "spdlog/spdlog.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace sls3mcubridge {
+
+namespace {
+const std::chrono::seconds CONNECT_TIMEOUT(1);
+const std::chrono::milliseconds ACCEPT_POLL_INTERVAL(1);
+const int64_t ROUND_TRIPS = 10000;
+const int64_t LOW_LATENCY_ROUND_TRIPS = 200;
+const std::chrono::microseconds SPIN_READ(50);
+const double FRAMES_PER_REPORT = 10000.0;
+
+double to_microseconds(std::chrono::nanoseconds value) {
+  return std::chrono::duration<double, std::micro>(value).count();
+}
+
+// Answers every frame from the mixer with `replies` writes of the same frame
+// through the client, the way the bridge reads and writes the mixer
+// connection.
+asio::awaitable<void> connect_and_echo(std::shared_ptr<Client> client,
+                                       uint16_t port, size_t replies,
+                                       WriteBatch &echo) {
+  co_await client->async_connect("127.0.0.1", port, CONNECT_TIMEOUT);
+  client->start_reading([raw_client = client.get(), replies,
+                         &echo](tcp::PackageView & /*package*/) {
+    for (size_t i = 0; i < replies; i++) {
+      echo.clear();
+      echo.add(asio::buffer(FADER_FRAME));
+      raw_client->write(echo);
+    }
+  });
+}
+
+// A client on its own thread connected to a mixer stand-in on the loopback
+// interface. The stand-in is used blocking from the benchmark thread.
+class LoopbackMixer {
+public:
+  LoopbackMixer(std::optional<LowLatencyConfig> low_latency, size_t replies)
+      : m_echo(FADER_FRAME.size()),
+        m_acceptor(m_io_context, asio::ip::tcp::endpoint(
+                                     asio::ip::address_v4::loopback(), 0)),
+        m_client(std::make_shared<Client>(m_io_context.get_executor())),
+        m_mixer(m_io_context) {
+    spdlog::set_level(spdlog::level::err);
+    m_client->set_low_latency(low_latency);
+    asio::co_spawn(m_io_context,
+                   connect_and_echo(m_client,
+                                    m_acceptor.local_endpoint().port(),
+                                    replies, m_echo),
+                   asio::detached);
+    m_thread = std::thread([this]() {
+      m_tid = gettid();
+      m_io_context.run();
+    });
+    accept();
+    if (!m_error) {
+      m_mixer.set_option(asio::ip::tcp::no_delay(true), m_error);
+    }
+    while (m_tid == 0) {
+    }
+    pthread_getcpuclockid(m_thread.native_handle(), &m_clock);
+  }
+  LoopbackMixer(const LoopbackMixer &obj) = delete;
+  LoopbackMixer(LoopbackMixer &&obj) = delete;
+  LoopbackMixer &operator=(const LoopbackMixer &obj) = delete;
+  LoopbackMixer &operator=(LoopbackMixer &&obj) = delete;
+  ~LoopbackMixer() {
+    asio::post(m_io_context, [this]() {
+      m_client->close();
+      m_io_context.stop();
+    });
+    m_thread.join();
+  }
+
+  asio::ip::tcp::socket &mixer() { return m_mixer; }
+  [[nodiscard]] const asio::error_code &error() const { return m_error; }
+  // CPU time of the client thread.
+  [[nodiscard]] std::chrono::nanoseconds cpu_time() const {
+    timespec now{};
+    clock_gettime(m_clock, &now);
+    return std::chrono::seconds(now.tv_sec) +
+           std::chrono::nanoseconds(now.tv_nsec);
+  }
+  // Times the client thread blocked waiting, once per wakeup by the socket
+  // backend.
+  [[nodiscard]] uint64_t wakeups() const {
+    std::ifstream status("/proc/self/task/" + std::to_string(m_tid) +
+                         "/status");
+    std::string key;
+    while (status >> key) {
+      if (key == "voluntary_ctxt_switches:") {
+        uint64_t value = 0;
+        status >> value;
+        return value;
+      }
+    }
+    return 0;
+  }
+
+private:
+  // Waits at most CONNECT_TIMEOUT for the client, which may fail to connect.
+  void accept() {
+    m_acceptor.non_blocking(true, m_error);
+    auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+    while (!m_error) {
+      m_acceptor.accept(m_mixer, m_error);
+      if (m_error != asio::error::would_block) {
+        return;
+      }
+      if (std::chrono::steady_clock::now() >= deadline) {
+        m_error = asio::error::timed_out;
+        return;
+      }
+      m_error.clear();
+      std::this_thread::sleep_for(ACCEPT_POLL_INTERVAL);
+    }
+  }
+
+  WriteBatch m_echo;
+  asio::io_context m_io_context;
+  asio::ip::tcp::acceptor m_acceptor;
+  std::shared_ptr<Client> m_client;
+  asio::ip::tcp::socket m_mixer;
+  asio::error_code m_error;
+  std::thread m_thread;
+  std::atomic<pid_t> m_tid = 0;
+  clockid_t m_clock{};
+};
+
+void report_round_trips(benchmark::State &state,
+                        const LatencyHistogram &round_trips) {
+  auto summary = round_trips.summarize();
+  state.counters["p50_rtt_us"] = to_microseconds(summary.p50);
+  state.counters["p99_rtt_us"] = to_microseconds(summary.p99);
+  state.counters["p999_rtt_us"] = to_microseconds(summary.p999);
+  state.counters["max_rtt_us"] = to_microseconds(summary.max);
+}
+} // namespace
+
+// Round trips of fader frames between a mixer stand-in and a client on the
+// loopback interface, `burst` frames per write of the stand-in. Build once
+// with and once without -DIO_URING=ON and compare the two, the label names
+// the backend. Reports the CPU time of the client thread per 10k frames, its
+// wakeups per frame and the round trip percentiles. Count the syscalls with
+// `perf stat -e raw_syscalls:sys_enter` around the run.
+static void BM_MixerRoundTrip(benchmark::State &state) {
+  auto burst = static_cast<size_t>(state.range(0));
+  std::vector<std::byte> frames;
+  for (size_t i = 0; i < burst; i++) {
+    frames.insert(frames.end(), FADER_FRAME.begin(), FADER_FRAME.end());
+  }
+  std::vector<std::byte> replies(frames.size());
+
+  LoopbackMixer loopback(std::nullopt, 1);
+  if (loopback.error()) {
+    state.SkipWithError(loopback.error().message().c_str());
+    return;
+  }
+  LatencyHistogram round_trips;
+  asio::error_code error;
+  auto cpu_start = loopback.cpu_time();
+  auto wakeups_start = loopback.wakeups();
+  for (auto _ : state) {
+    auto sent = std::chrono::steady_clock::now();
+    asio::write(loopback.mixer(), asio::buffer(frames), error);
+    asio::read(loopback.mixer(), asio::buffer(replies), error);
+    round_trips.record(std::chrono::steady_clock::now() - sent);
+    if (error) {
+      state.SkipWithError(error.message().c_str());
+      break;
+    }
+  }
+  if (error) {
+    return;
+  }
+  auto cpu = loopback.cpu_time() - cpu_start;
+  auto wakeups = loopback.wakeups() - wakeups_start;
+
+  auto nr_frames = static_cast<double>(state.iterations() * burst);
+  state.SetLabel(std::string(io_backend()));
+  state.SetItemsProcessed(static_cast<int64_t>(nr_frames));
+  state.counters["cpu_us_per_10k_frames"] =
+      to_microseconds(cpu) / nr_frames * FRAMES_PER_REPORT;
+  state.counters["wakeups_per_frame"] =
+      static_cast<double>(wakeups) / nr_frames;
+  report_round_trips(state, round_trips);
+}
+BENCHMARK(BM_MixerRoundTrip)
+    ->ArgName("burst")
+    ->Arg(1)
+    ->Arg(16)
+    ->Iterations(ROUND_TRIPS)
+    ->UseRealTime();
+
+// Round trip of a single frame from the mixer stand-in. A fader move is
+// answered with one write, a button press with two, like the LED and display
+// feedback of the DAW. Without TCP_NODELAY the second write waits for the
+// delayed ACK of the first. Profile 0 keeps the default socket options, 1 is
+// --low-latency and 2 adds --spin-read.
+static void BM_LowLatencyRoundTrip(benchmark::State &state) {
+  auto replies = static_cast<size_t>(state.range(0));
+  std::optional<LowLatencyConfig> low_latency;
+  if (state.range(1) > 0) {
+    low_latency.emplace();
+  }
+  if (state.range(1) > 1) {
+    low_latency->spin_read = SPIN_READ;
+  }
+  std::vector<std::byte> reply_bytes(replies * FADER_FRAME.size());
+
+  LoopbackMixer loopback(low_latency, replies);
+  if (loopback.error()) {
+    state.SkipWithError(loopback.error().message().c_str());
+    return;
+  }
+  LatencyHistogram round_trips;
+  asio::error_code error;
+  for (auto _ : state) {
+    auto sent = std::chrono::steady_clock::now();
+    asio::write(loopback.mixer(), asio::buffer(FADER_FRAME), error);
+    asio::read(loopback.mixer(), asio::buffer(reply_bytes), error);
+    round_trips.record(std::chrono::steady_clock::now() - sent);
+    if (error) {
+      state.SkipWithError(error.message().c_str());
+      break;
+    }
+  }
+  if (error) {
+    return;
+  }
+  report_round_trips(state, round_trips);
+}
+BENCHMARK(BM_LowLatencyRoundTrip)
+    ->ArgNames({"replies", "profile"})
+    ->ArgsProduct({{1, 2}, {0, 1, 2}})
+    // A stalled round trip takes about 40 ms.
+    ->Iterations(LOW_LATENCY_ROUND_TRIPS)
+    ->UseRealTime();
+
+} // namespace sls3mcubridge
@@ -1,35 +1,69 @@
 
 #include "bridge.hpp"
 
+#include "capture.hpp"
 #include "client.hpp"
+#include "coalescer.hpp"
+#include "latency.hpp"
+#include "meters.hpp"
+#include "metrics.hpp"
 #include "mididevice.hpp"
+#include "midimessage.hpp"
 #include "package.hpp"
+#include "portwatcher.hpp"
+#include "realtime.hpp"
+#include "surfacestate.hpp"
+#include "sysex.hpp"
+#include "trace.hpp"
+#include "writebatch.hpp"
 
+#include "asio/awaitable.hpp"
 #include "asio/buffer.hpp"
+#include "asio/co_spawn.hpp"
+#include "asio/error_code.hpp"
+#include "asio/post.hpp"
+#include "asio/use_awaitable.hpp"
 #include "libremidi/message.hpp"
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstddef>
-#include <iomanip>
-#include <ios>
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <memory>
-#include <sstream>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
-#include <thread>
+#include <utility>
 #include <vector>
 
-const int DELAY_BETWEEN_MIDI_DEVICE_CREATION_MS = 100;
-const size_t MAX_INITIAL_MESSAGE_SIZE = 400;
+const std::chrono::seconds CONNECT_TIMEOUT(5);
+const std::chrono::seconds HANDSHAKE_TIMEOUT(2);
+// Delay before the second reconnect attempt, doubled after every failed one.
+// The first attempt is immediate.
+const std::chrono::milliseconds INITIAL_RECONNECT_DELAY(250);
+const std::chrono::milliseconds MAX_RECONNECT_DELAY(8000);
+// Time for a new virtual port to be announced by the midi backend. Some
+// backends never announce it, the next device is created afterwards anyway.
+const std::chrono::milliseconds PORT_ANNOUNCE_TIMEOUT(100);
+// Time for a restarted DAW to open all its ports and send its own state
+// before the surfaces are resynced.
+const std::chrono::milliseconds DAW_RESYNC_DELAY(500);
 
 const std::array<std::string_view, 5> MIDI_DEVICE_NAMES = {
     "MAIN", "EXT1", "EXT2", "EXT3", "EXT4"};
 
 namespace sls3mcubridge {
 
+// The fragments of the longest SysEx message the coalescer sends fit the
+// write queue of the client.
+static_assert(MAX_SYSEX_FRAGMENTS * tcp::MAX_PACKAGE_SIZE <=
+              MAX_QUEUED_WRITE_SIZE);
+
 const std::array<std::byte, 16> FIRST_INIT_MESSAGE = {
     std::byte{0x55}, std::byte{0x43}, std::byte{0x00}, std::byte{0x01},
     std::byte{0x0a}, std::byte{0x00}, std::byte{0x45}, std::byte{0x51},
@@ -53,117 +87,517 @@ const std::array<std::byte, 60> SECOND_INIT_MESSAGE = {
     std::byte{0x4d}, std::byte{0x69}, std::byte{0x64}, std::byte{0x63},
     std::byte{0x00}, std::byte{0x00}, std::byte{0x00}, std::byte{0x00}};
 
-Bridge::Bridge(asio::io_context &io_context, const std::string &ip_address,
-               int port)
-    : tcp_client(std::make_shared<Client>(io_context)) {
-  tcp_client->connect(ip_address, port);
-  init();
+Bridge::Bridge(const asio::any_io_executor &executor, std::string ip_address,
+               int port, const BridgeConfig &config)
+    : executor(executor), ip_address(std::move(ip_address)), port(port),
+      config(config), latency(std::make_shared<LatencyMonitor>()),
+      metrics(std::make_shared<Metrics>()), latency_timer(executor),
+      reconnect_timer(executor), daw_resync_timer(executor),
+      tcp_client(std::make_shared<Client>(executor)) {
+  if (!config.capture_file.empty()) {
+    capture = std::make_shared<CaptureWriter>(config.capture_file);
+    tcp_client->set_capture(capture);
+  }
+  tcp_client->set_latency(latency);
+  tcp_client->set_metrics(metrics);
+  tcp_client->set_buffer_while_disconnected(config.buffer_while_disconnected);
+  tcp_client->set_low_latency(config.low_latency);
+  if (!config.metrics_socket.empty()) {
+    metrics_server = std::make_shared<MetricsServer>(
+        executor, config.metrics_socket, metrics);
+  }
 }
 
-void Bridge::start() {
-  tcp_client->start_reading(std::bind(
-      &Bridge::handle_tcp_read, shared_from_this(), std::placeholders::_1));
+asio::awaitable<void> Bridge::start() {
+  // Keeps the bridge alive while suspended.
+  auto self = shared_from_this();
+  auto started = std::chrono::steady_clock::now();
+  port_watcher = std::make_shared<MidiPortWatcher>(executor);
+  port_watcher->start();
+  co_await tcp_client->async_connect(ip_address, port, CONNECT_TIMEOUT);
+  co_await handshake();
+  start_forwarding();
+  spdlog::info(
+      "Bridge started in " +
+      std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - started)
+                         .count()) +
+      " ms");
+}
 
+void Bridge::stop() {
+  stopped = true;
+  tcp_client->close();
+  latency_timer.cancel();
+  reconnect_timer.cancel();
+  daw_resync_timer.cancel();
+  if (port_watcher) {
+    port_watcher->stop();
+  }
+  if (metrics_server) {
+    metrics_server->stop();
+  }
+}
+
+void Bridge::start_forwarding() {
+  tcp_client->set_disconnect_handler(
+      [self = weak_from_this()](const asio::error_code &error) {
+        if (auto bridge = self.lock()) {
+          bridge->handle_disconnect(error);
+        }
+      });
+  start_reading_mixer();
   for (size_t i = 0; i < midi_devices.size(); i++) {
-    midi_devices.at(i)->start_reading(std::bind(&Bridge::handle_midi_read,
-                                                shared_from_this(), i,
-                                                std::placeholders::_2));
+    start_reading_midi_device(i);
+  }
+  port_watcher->set_reappear_handler(
+      [self = weak_from_this()](const std::string &port_name) {
+        if (auto bridge = self.lock()) {
+          bridge->schedule_daw_resync(port_name);
+        }
+      });
+  schedule_latency_report();
+  register_metrics();
+  if (metrics_server) {
+    metrics_server->start();
   }
 }
 
-void Bridge::init() {
-  tcp_client->write(asio::buffer(FIRST_INIT_MESSAGE));
+void Bridge::start_reading_mixer() {
+  tcp_client->start_reading(
+      [self = shared_from_this()](tcp::PackageView &package) {
+        self->handle_tcp_read(package, self->tcp_client->get_receive_time());
+      });
+}
 
-  spdlog::info("getting midi device requirements from mixer.");
+void Bridge::start_reading_midi_device(size_t device_index) {
+  midi_devices.at(device_index)
+      ->start_reading([reader = midi_reader(device_index)](
+                          int /*port*/, const libremidi::message &message) {
+        reader(message);
+      });
+}
+
+std::function<void(const libremidi::message &)>
+Bridge::midi_reader(size_t device_index) {
+  return [self = shared_from_this(), device_index,
+          coalescer = coalescers.at(device_index),
+          meter = meters.empty() ? nullptr : meters.at(device_index)](
+             const libremidi::message &message) {
+    self->forward_midi_read(device_index, *coalescer, meter.get(), message);
+  };
+}
 
-  std::array<std::byte, MAX_INITIAL_MESSAGE_SIZE> buffer{};
-  auto bytes_read = tcp_client->read_some(asio::buffer(buffer));
-  auto package = tcp::Package(
-      tcp::BufferView(buffer.begin(), buffer.begin() + bytes_read));
-
-  switch (package.get_body()->get_type()) {
-  case tcp::Body::Type::InitialResponse: {
-    auto body =
-        std::dynamic_pointer_cast<tcp::InitialResponseBody>(package.get_body());
-    auto nr_devices = body->get_nr_of_midi_devices();
-
-    for (uint8_t i = 0; i < nr_devices; i++) {
-      midi_devices.push_back(std::make_shared<MidiDevice>(
-          "StudioLive_" + std::string(MIDI_DEVICE_NAMES.at(i))));
-      spdlog::info("Created midi device StudioLive_" +
-                   std::string(MIDI_DEVICE_NAMES.at(i)));
-      // Not entirely sure why the sleep is needed. On Linux some devices seem
-      // to not be created when executed too fast after each other.
-      std::this_thread::sleep_for(
-          std::chrono::milliseconds(DELAY_BETWEEN_MIDI_DEVICE_CREATION_MS));
+void Bridge::handle_disconnect(const asio::error_code &error) {
+  if (stopped) {
+    return;
+  }
+  spdlog::warn("Lost connection to the mixer: " + error.message());
+  asio::co_spawn(executor, reconnect(), [](const std::exception_ptr &exc) {
+    if (!exc) {
+      return;
+    }
+    try {
+      std::rethrow_exception(exc);
+    } catch (const std::exception &error) {
+      // Only the timer cancelled by stop() throws.
+      spdlog::debug("Reconnecting stopped: " + std::string(error.what()));
+    }
+  });
+}
+
+asio::awaitable<void> Bridge::reconnect() {
+  // Keeps the bridge alive while suspended.
+  auto self = shared_from_this();
+  auto disconnected = std::chrono::steady_clock::now();
+  auto nr_devices = midi_devices.size();
+  std::chrono::milliseconds delay(0);
+  while (true) {
+    reconnect_timer.expires_after(delay);
+    co_await reconnect_timer.async_wait(asio::use_awaitable);
+    try {
+      co_await tcp_client->async_connect(ip_address, port, CONNECT_TIMEOUT);
+      co_await handshake();
+      break;
+    } catch (const std::exception &exc) {
+      tcp_client->close();
+      delay = std::clamp(delay * 2, INITIAL_RECONNECT_DELAY,
+                         MAX_RECONNECT_DELAY);
+      spdlog::warn("Reconnecting failed: " + std::string(exc.what()) +
+                   ", retrying in " + std::to_string(delay.count()) + " ms");
+    }
+    if (stopped) {
+      co_return;
     }
-    break;
   }
-  default:
+  if (stopped) {
+    tcp_client->close();
+    co_return;
+  }
+  start_reading_mixer();
+  resync_surfaces();
+  // Devices the mixer asks for on top of the ones kept from before.
+  for (size_t i = nr_devices; i < midi_devices.size(); i++) {
+    start_reading_midi_device(i);
+  }
+  last_recovery = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - disconnected);
+  metrics->count(Metrics::Event::Reconnect);
+  spdlog::info("Reconnected to the mixer in " +
+               std::to_string(last_recovery.count()) + " ms");
+}
+
+void Bridge::resync_surfaces() {
+  size_t nr_messages = 0;
+  MessageRun messages;
+  WriteBatch batch(MAX_SEGMENT_SIZE);
+  auto sink = [client = tcp_client](const WriteBatch &full) {
+    client->write(full);
+  };
+  for (size_t i = 0; i < surfaces.size(); i++) {
+    // What the mixer shows apart from the replayed state is unknown.
+    surfaces.at(i)->forget_lcd();
+    messages.clear();
+    surfaces.at(i)->replay(messages);
+    nr_messages += messages.size();
+    MidiCoalescer::encode(tcp::Package::index_to_midi_device_byte(
+                              static_cast<int>(i)),
+                          messages, batch, sink, metrics.get());
+  }
+  if (!batch.empty()) {
+    sink(batch);
+  }
+  spdlog::info("Resynced the surfaces with " + std::to_string(nr_messages) +
+               " messages");
+}
+
+void Bridge::schedule_daw_resync(const std::string &port_name) {
+  if (stopped || is_own_port(port_name)) {
+    return;
+  }
+  spdlog::debug("Midi port " + port_name + " is back");
+  // Restarts the delay for every port of the DAW.
+  daw_resync_timer.expires_after(DAW_RESYNC_DELAY);
+  daw_resync_timer.async_wait(
+      [self = shared_from_this()](const asio::error_code &error) {
+        if (!error && self->tcp_client->is_connected()) {
+          self->resync_surfaces();
+        }
+      });
+}
+
+bool Bridge::is_own_port(const std::string &port_name) const {
+  return std::any_of(MIDI_DEVICE_NAMES.begin(), MIDI_DEVICE_NAMES.end(),
+                     [this, &port_name](std::string_view device) {
+                       return port_name.find(config.midi_port_prefix +
+                                             std::string(device)) !=
+                              std::string::npos;
+                     });
+}
+
+void Bridge::schedule_latency_report() {
+  if (config.latency_report_interval.count() <= 0) {
+    return;
+  }
+  latency_timer.expires_after(config.latency_report_interval);
+  latency_timer.async_wait(
+      [self = shared_from_this()](const asio::error_code &error) {
+        if (!error) {
+          self->report_latency();
+          self->schedule_latency_report();
+        }
+      });
+}
+
+void Bridge::report_latency() { latency->report(); }
+
+void Bridge::export_metrics() {
+  if (config.metrics_file.empty()) {
+    return;
+  }
+  try {
+    metrics->write_file(config.metrics_file);
+  } catch (const std::exception &exc) {
+    spdlog::warn("Failed to write metrics: " + std::string(exc.what()));
+  }
+}
+
+void Bridge::register_metrics() {
+  metrics->add_callback(
+      {"sls3_tcp_write_queue_bytes", "Bytes waiting for the mixer socket.",
+       "gauge", "", [client = tcp_client]() {
+         return static_cast<uint64_t>(client->get_queued_size());
+       }});
+  metrics->add_callback(
+      {"sls3_connected", "1 while connected to the mixer.", "gauge", "",
+       [client = tcp_client]() {
+         return static_cast<uint64_t>(client->is_connected());
+       }});
+  metrics->add_callback(
+      {"sls3_last_recovery_milliseconds",
+       "Time from losing the mixer connection to the end of the handshake, of "
+       "the last reconnect.",
+       "gauge", "", [self = weak_from_this()]() -> uint64_t {
+         auto bridge = self.lock();
+         return bridge ? static_cast<uint64_t>(bridge->last_recovery.count())
+                       : 0;
+       }});
+}
+
+void Bridge::register_device_metrics(size_t device_index) {
+  auto device = "device=\"" + std::to_string(device_index) + "\"";
+  metrics->add_callback(
+      {"sls3_midi_queue_depth",
+       "Midi messages from the DAW waiting to be sent to the mixer.", "gauge",
+       device, [coalescer = coalescers.at(device_index)]() {
+         return static_cast<uint64_t>(coalescer->get_queue_depth());
+       }});
+  if (!config.collapse_continuous) {
+    return;
+  }
+  // The filters are only used on the executor, like the exporter.
+  metrics->add_callback(
+      {"sls3_collapsed_total",
+       "Continuous control values replaced by a newer value.", "counter",
+       "direction=\"daw_to_mixer\"," + device,
+       [coalescer = coalescers.at(device_index)]() {
+         return coalescer->get_filter()->get_collapsed();
+       }});
+  metrics->add_callback(
+      {"sls3_collapsed_total",
+       "Continuous control values replaced by a newer value.", "counter",
+       "direction=\"mixer_to_daw\"," + device,
+       [self = weak_from_this(), device_index]() -> uint64_t {
+         auto bridge = self.lock();
+         return bridge
+                    ? bridge->daw_queues.at(device_index).filter.get_collapsed()
+                    : 0;
+       }});
+}
+
+asio::awaitable<void> Bridge::handshake() {
+  co_await tcp_client->async_write(asio::buffer(FIRST_INIT_MESSAGE));
+
+  spdlog::info("getting midi device requirements from mixer.");
+
+  auto response = co_await tcp_client->async_read_package(HANDSHAKE_TIMEOUT);
+  if (response->get_type() != tcp::Body::Type::InitialResponse) {
     throw std::runtime_error("Expected initialResponse, got: " +
-                             std::to_string(package.get_body()->get_type()));
+                             std::to_string(response->get_type()));
   }
-  tcp_client->write(asio::buffer(SECOND_INIT_MESSAGE));
+  auto body = std::dynamic_pointer_cast<tcp::InitialResponseBody>(response);
+  co_await create_midi_devices(body->get_nr_of_midi_devices());
+
+  co_await tcp_client->async_write(asio::buffer(SECOND_INIT_MESSAGE));
 }
 
-void Bridge::handle_tcp_read(tcp::Package &package) {
+asio::awaitable<void> Bridge::create_midi_devices(uint8_t nr_devices) {
+  // After a reconnect the devices of the previous connection are kept, so the
+  // DAW stays attached to them.
+  if (midi_devices.size() >= nr_devices) {
+    co_return;
+  }
+  // The input threads of the devices kept from before keep running while
+  // devices are added. Their readers hold their own pointers, the vectors
+  // are not moved under them either way.
+  midi_devices.reserve(MIDI_DEVICE_NAMES.size());
+  coalescers.reserve(MIDI_DEVICE_NAMES.size());
+  surfaces.reserve(MIDI_DEVICE_NAMES.size());
+  meters.reserve(MIDI_DEVICE_NAMES.size());
+  daw_queues.reserve(MIDI_DEVICE_NAMES.size());
+
+  for (auto i = static_cast<uint8_t>(midi_devices.size()); i < nr_devices;
+       i++) {
+    auto name = config.midi_port_prefix + std::string(MIDI_DEVICE_NAMES.at(i));
+    midi_devices.push_back(std::make_shared<MidiDevice>(name));
+    midi_devices.back()->set_capture(capture, i);
+    if (config.realtime) {
+      midi_devices.back()->set_input_thread_setup(
+          [realtime = *config.realtime, name]() {
+            make_thread_realtime(realtime, name + " midi input thread");
+            prefault_stack();
+          });
+    }
+    coalescers.push_back(std::make_shared<MidiCoalescer>(
+        executor, tcp::Package::index_to_midi_device_byte(i),
+        config.coalesce_window, config.collapse_continuous,
+        [client = tcp_client](const WriteBatch &batch) {
+          client->write(batch);
+        }));
+    coalescers.back()->set_metrics(metrics);
+    surfaces.push_back(std::make_shared<SurfaceState>());
+    coalescers.back()->set_surface_state(surfaces.back());
+    coalescers.back()->set_compress_lcd(config.compress_lcd);
+    if (config.meter_interval.count() > 0) {
+      meters.push_back(std::make_shared<MeterDecimator>(
+          executor, tcp::Package::index_to_midi_device_byte(i),
+          config.meter_interval,
+          [client = tcp_client](const WriteBatch &batch) {
+            client->write(batch);
+          }));
+      meters.back()->set_metrics(metrics);
+    }
+    daw_queues.emplace_back();
+    register_device_metrics(i);
+    // On Linux some devices are not created when the next one is opened
+    // before the previous one is announced.
+    if (!co_await port_watcher->wait_for(name, PORT_ANNOUNCE_TIMEOUT)) {
+      spdlog::debug("No announcement of midi device " + name);
+    }
+    spdlog::info("Created midi device " + name);
+  }
+}
+
+void Bridge::handle_tcp_read(tcp::PackageView &package) {
+  handle_tcp_read(package, std::chrono::steady_clock::now());
+}
+
+void Bridge::handle_tcp_read(tcp::PackageView &package,
+                             std::chrono::steady_clock::time_point received) {
 
   spdlog::debug("Bridge handle read");
-  switch (package.get_body()->get_type()) {
+  switch (package.get_type()) {
   case tcp::Body::Type::IncommingMidi: {
-    auto midi_body =
-        std::dynamic_pointer_cast<tcp::IncommingMidiBody>(package.get_body());
-    midi_devices.at(midi_body->get_device_index())
-        ->send_message(midi_body->get_message());
+    const auto &midi_body = package.get_body<tcp::IncommingMidiBodyView>();
+    auto device_index = static_cast<size_t>(midi_body.device.get_index());
+    trace(TraceStage::MixerFrame, static_cast<uint8_t>(device_index),
+          package.get_type(),
+          {midi_body.message.begin(), midi_body.message.end()});
+    surfaces.at(device_index)
+        ->update_from_surface(
+            {midi_body.message.begin(), midi_body.message.end()});
+    if (config.collapse_continuous) {
+      if (midi_body.message.distance() <= ShortMessage::MAX_SIZE) {
+        queue_to_daw(device_index,
+                     {midi_body.message.begin(), midi_body.message.end()},
+                     received);
+        break;
+      }
+      // Longer than a channel message, sent behind the pending ones.
+      flush_to_daw(device_index);
+    }
+    midi_devices.at(device_index)
+        ->send_message({midi_body.message.begin(), midi_body.message.end()});
+    record_to_daw(device_index,
+                  {midi_body.message.begin(), midi_body.message.end()},
+                  received);
     break;
   }
   case tcp::Body::Type::OutgoingMidi:
     throw std::invalid_argument("Received unexpected package of type: " +
-                                std::to_string(package.get_body()->get_type()));
+                                std::to_string(package.get_type()));
   case tcp::Body::Type::SysEx: {
-    auto midi_body =
-        std::dynamic_pointer_cast<tcp::SysExMidiBody>(package.get_body());
-    midi_devices.at(midi_body->get_device_index())
-        ->send_message(midi_body->get_message());
+    const auto &midi_body = package.get_body<tcp::SysExMidiBodyView>();
+    auto device_index = static_cast<size_t>(midi_body.device.get_index());
+    trace(TraceStage::MixerFrame, static_cast<uint8_t>(device_index),
+          package.get_type(),
+          {midi_body.message.begin(), midi_body.message.end()});
+    auto &assembler = daw_queues.at(device_index).sysex;
+    auto message =
+        assembler.add({midi_body.message.begin(), midi_body.message.end()});
+    if (message.empty()) {
+      break;
+    }
+    if (assembler.was_assembled()) {
+      metrics->count(Metrics::Event::AssembledSysEx);
+    }
+    if (config.collapse_continuous) {
+      flush_to_daw(device_index);
+    }
+    midi_devices.at(device_index)->send_message(message);
+    record_to_daw(device_index, message, received);
     break;
   }
+  case tcp::Body::Type::InitialResponse:
   case tcp::Body::Type::Unkown:
   default: {
+    metrics->count(Metrics::Event::UnknownBody);
     spdlog::warn("Ignored unkown package");
   }
   }
 }
 
-void Bridge::handle_midi_read(int device_index,
-                              const libremidi::message &message) {
-  std::stringstream substring;
-  substring << "type: " << std::hex << std::setw(2) << std::setfill('0')
-            << static_cast<int>(message.get_message_type());
+void Bridge::queue_to_daw(size_t device_index,
+                          std::span<const std::byte> message,
+                          std::chrono::steady_clock::time_point received) {
+  auto &queue = daw_queues.at(device_index);
+  if (queue.pending.empty()) {
+    queue.received = received;
+  }
+  queue.pending.emplace_back(message);
 
-  for (const auto &iter : message) {
-    substring << " " << std::setw(2) << std::setfill('0')
-              << static_cast<int>(iter);
+  if (!daw_flush_scheduled) {
+    // Runs after the remaining packages of the current read are handled.
+    daw_flush_scheduled = true;
+    asio::post(executor, [self = shared_from_this()]() {
+      self->daw_flush_scheduled = false;
+      for (size_t i = 0; i < self->daw_queues.size(); i++) {
+        self->flush_to_daw(i);
+      }
+    });
   }
+}
 
-  spdlog::debug("midi handler. message.size: " +
-                std::to_string(message.size()) + ", " + ": " + substring.str());
+void Bridge::flush_to_daw(size_t device_index) {
+  auto &queue = daw_queues.at(device_index);
+  queue.filter.collapse(queue.pending);
+  for (const auto &message : queue.pending) {
+    midi_devices.at(device_index)->send_message(message.as_bytes());
+    record_to_daw(device_index, message.as_bytes(), queue.received);
+  }
+  queue.pending.clear();
+}
+
+void Bridge::record_to_daw(size_t device_index,
+                           std::span<const std::byte> message,
+                           std::chrono::steady_clock::time_point received) {
+  trace(TraceStage::MidiToDaw, static_cast<uint8_t>(device_index),
+        TRACE_NONE, message);
+  metrics->count_midi(Metrics::Direction::MixerToDaw, device_index,
+                      message.size());
+  latency->record(LatencyMonitor::Direction::MixerToDaw, device_index,
+                  std::chrono::steady_clock::now() - received);
+}
+
+void Bridge::handle_midi_read(int device_index,
+                              const libremidi::message &message) {
+  auto index = static_cast<size_t>(device_index);
+  forward_midi_read(index, *coalescers.at(index),
+                    meters.empty() ? nullptr : meters.at(index).get(),
+                    message);
+}
+
+void Bridge::forward_midi_read(size_t device_index, MidiCoalescer &coalescer,
+                               MeterDecimator *meter,
+                               const libremidi::message &message) {
+  trace(TraceStage::MidiFromDaw, static_cast<uint8_t>(device_index),
+        TRACE_NONE, std::as_bytes(std::span(message.bytes)));
 
-  auto device_byte = tcp::Package::index_to_midi_device_byte(device_index);
-  std::shared_ptr<tcp::Body> body;
   switch (message.get_message_type()) {
+  case libremidi::message_type::AFTERTOUCH:
+    // Channel pressure carries the meters.
+    if (meter != nullptr &&
+        meter->push(ShortMessage(std::span(message.bytes)))) {
+      metrics->count_midi(Metrics::Direction::DawToMixer, device_index,
+                          message.size());
+      break;
+    }
+    [[fallthrough]];
   case libremidi::message_type::NOTE_OFF:
   case libremidi::message_type::NOTE_ON:
   case libremidi::message_type::POLY_PRESSURE:
   case libremidi::message_type::PROGRAM_CHANGE:
   case libremidi::message_type::CONTROL_CHANGE:
-  case libremidi::message_type::AFTERTOUCH:
-  case libremidi::message_type::PITCH_BEND: {
-    auto tmp_list = {message};
-    body = std::make_shared<tcp::OutgoingMidiBody>(device_byte, tmp_list);
+  case libremidi::message_type::PITCH_BEND:
+    metrics->count_midi(Metrics::Direction::DawToMixer, device_index,
+                        message.size());
+    // Channel messages are queued inline, without an allocation.
+    coalescer.push(ShortMessage(std::span(message.bytes)));
     break;
-  }
   case libremidi::message_type::SYSTEM_EXCLUSIVE:
-    body = std::make_shared<tcp::SysExMidiBody>(device_byte, message);
+    metrics->count_midi(Metrics::Direction::DawToMixer, device_index,
+                        message.size());
+    coalescer.push_sysex(std::span(message.bytes));
     break;
 
   case libremidi::message_type::TIME_CODE:
@@ -183,13 +617,10 @@ void Bridge::handle_midi_read(int device_index,
   case libremidi::message_type::SYSTEM_RESET:
   case libremidi::message_type::INVALID:
   default:
+    metrics->count(Metrics::Event::UnsupportedMidi);
     spdlog::warn("Recieved unsuported midi message");
     break;
   }
-
-  tcp::Package tcp_message(body);
-  auto bytes = tcp_message.serialize();
-  tcp_client->write(asio::buffer(bytes));
 }
 
 } // namespace sls3mcubridge
\ No newline at end of file
@@ -1,30 +1,182 @@
 #pragma once
 
-#include "asio/io_context.hpp"
+#include "lastvalue.hpp"
+#include "lowlatency.hpp"
+#include "midimessage.hpp"
+#include "realtime.hpp"
+#include "sysex.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/awaitable.hpp"
+#include "asio/steady_timer.hpp"
 #include "libremidi/message.hpp"
 
+#include <chrono>
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
 namespace sls3mcubridge {
 class MidiDevice;
+class MidiCoalescer;
+class MeterDecimator;
 class Client;
+class CaptureWriter;
+class LatencyMonitor;
+class Metrics;
+class MetricsServer;
+class MidiPortWatcher;
+class SurfaceState;
 namespace tcp {
-class Package;
+class PackageView;
 } // namespace tcp
 
+struct BridgeConfig {
+  // Time DAW to mixer messages may be held back to share a package with
+  // following messages. Zero only coalesces within one executor turn.
+  std::chrono::microseconds coalesce_window{0};
+  // Only forward the newest pending value of faders and other continuous
+  // controls, in both directions.
+  bool collapse_continuous = false;
+  // Sends the highest meter level of every strip at most this often, zero
+  // forwards every meter message.
+  std::chrono::milliseconds meter_interval{0};
+  // Only send the characters of LCD messages that differ from what the
+  // surface shows.
+  bool compress_lcd = false;
+  // Records all traffic to this file when not empty.
+  std::string capture_file;
+  // Logs the latency histograms this often, zero only logs on request.
+  std::chrono::seconds latency_report_interval{0};
+  // export_metrics() writes a snapshot to this file when not empty.
+  std::string metrics_file;
+  // Serves a snapshot to every connection on this Unix socket when not empty.
+  std::string metrics_socket;
+  // Holds DAW to mixer messages while reconnecting to the mixer and sends them
+  // once connected, up to MAX_QUEUED_WRITE_SIZE. Dropped otherwise.
+  bool buffer_while_disconnected = false;
+  // Prepended to the virtual midi port names, keeps the ports of several
+  // mixers apart.
+  std::string midi_port_prefix = "StudioLive_";
+  // Scheduling of the midi input threads when set.
+  std::optional<RealtimeConfig> realtime;
+  // Socket options of the mixer connection when set.
+  std::optional<LowLatencyConfig> low_latency;
+};
+
 class Bridge : public std::enable_shared_from_this<Bridge> {
 public:
-  Bridge(asio::io_context &io_context, const std::string &ip_address, int port);
-  void start();
+  // All work of the bridge runs on `executor`, a strand when the io_context
+  // is run by several threads.
+  Bridge(const asio::any_io_executor &executor, std::string ip_address,
+         int port, const BridgeConfig &config);
+  // Connects to the mixer, does the handshake, creates the midi devices the
+  // mixer asks for and starts forwarding. Throws when the mixer can not be
+  // reached or does not answer the handshake in time. A connection lost
+  // afterwards is reconnected, keeping the midi devices. The surfaces are
+  // resynced after reconnecting and when the ports of a restarted DAW come
+  // back.
+  asio::awaitable<void> start();
+  // Disconnects from the mixer and stops the timers of the bridge.
+  void stop();
+  [[nodiscard]] const asio::any_io_executor &get_executor() const {
+    return executor;
+  }
 
-private:
-  void init();
-  void handle_tcp_read(tcp::Package &package);
+  // Translate a package from the mixer to the DAW and a midi message from the
+  // DAW to the mixer. Called by the readers set up in start().
+  void handle_tcp_read(tcp::PackageView &package);
+  // `received` is when the bytes of the package came in, the start of the
+  // measured mixer to DAW latency.
+  void handle_tcp_read(tcp::PackageView &package,
+                       std::chrono::steady_clock::time_point received);
+  // Looks up the device in the device vectors, only call it on the executor.
   void handle_midi_read(int device_index, const libremidi::message &message);
+  // What the midi input thread of device `device_index` runs for every
+  // message. It holds the coalescer and meter decimator of the device itself,
+  // as the device vectors grow on the executor when the mixer asks for more
+  // devices after a reconnect.
+  std::function<void(const libremidi::message &)>
+  midi_reader(size_t device_index);
+  [[nodiscard]] size_t get_nr_midi_devices() const {
+    return midi_devices.size();
+  }
+
+  // Logs the latency histograms of both directions.
+  void report_latency();
+  // Writes the metrics to the configured metrics file.
+  void export_metrics();
+
+private:
+  asio::awaitable<void> handshake();
+  asio::awaitable<void> create_midi_devices(uint8_t nr_devices);
+  void start_forwarding();
+  void start_reading_mixer();
+  void start_reading_midi_device(size_t device_index);
+  void forward_midi_read(size_t device_index, MidiCoalescer &coalescer,
+                         MeterDecimator *meter,
+                         const libremidi::message &message);
+  void handle_disconnect(const asio::error_code &error);
+  // Retries connecting and the handshake with an exponential backoff until
+  // connected or stopped.
+  asio::awaitable<void> reconnect();
+  // Sends the mirrored surface state of every device to the mixer.
+  void resync_surfaces();
+  // Resyncs the surfaces shortly after the ports of a DAW came back, once the
+  // DAW opened all of them.
+  void schedule_daw_resync(const std::string &port_name);
+  [[nodiscard]] bool is_own_port(const std::string &port_name) const;
+  void queue_to_daw(size_t device_index, std::span<const std::byte> message,
+                    std::chrono::steady_clock::time_point received);
+  void flush_to_daw(size_t device_index);
+  // Accounts and traces a message sent to the DAW.
+  void record_to_daw(size_t device_index, std::span<const std::byte> message,
+                     std::chrono::steady_clock::time_point received);
+  void schedule_latency_report();
+  // Metrics of the connection, registered once.
+  void register_metrics();
+  // Metrics of a device, registered when the device is created.
+  void register_device_metrics(size_t device_index);
+
+  // Mixer to DAW messages waiting for the end of the current read, only used
+  // with collapse_continuous.
+  struct DawQueue {
+    std::vector<ShortMessage> pending;
+    LastValueFilter filter{true};
+    // Receive time of the oldest pending message.
+    std::chrono::steady_clock::time_point received;
+    SysExAssembler sysex;
+  };
+
+  asio::any_io_executor executor;
+  std::string ip_address;
+  int port;
+  BridgeConfig config;
+  std::shared_ptr<CaptureWriter> capture;
+  std::shared_ptr<LatencyMonitor> latency;
+  std::shared_ptr<Metrics> metrics;
+  std::shared_ptr<MetricsServer> metrics_server;
+  asio::steady_timer latency_timer;
+  asio::steady_timer reconnect_timer;
+  asio::steady_timer daw_resync_timer;
+  bool stopped = false;
+  // Time from losing the connection to the end of the handshake, of the last
+  // reconnect.
+  std::chrono::milliseconds last_recovery{0};
   std::shared_ptr<Client> tcp_client;
+  // Follows the midi ports from start() until stop().
+  std::shared_ptr<MidiPortWatcher> port_watcher;
   std::vector<std::shared_ptr<MidiDevice>> midi_devices;
+  std::vector<std::shared_ptr<MidiCoalescer>> coalescers;
+  // Empty without a meter interval.
+  std::vector<std::shared_ptr<MeterDecimator>> meters;
+  std::vector<std::shared_ptr<SurfaceState>> surfaces;
+  std::vector<DawQueue> daw_queues;
+  bool daw_flush_scheduled = false;
 }; // namespace sls3mcubridge
 
 } // namespace sls3mcubridge
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include "capture.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <ios>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sls3mcubridge {
+
+namespace {
+const std::array<std::byte, 8> CAPTURE_MAGIC = {
+    std::byte('S'), std::byte('L'), std::byte('S'), std::byte('3'),
+    std::byte('C'), std::byte('A'), std::byte('P'), std::byte(0x01)};
+
+// timestamp (8 bytes), source, device, size (4 bytes), all little endian
+const size_t RECORD_HEADER_SIZE = 14;
+const size_t TIMESTAMP_SIZE = 8;
+const size_t DATA_SIZE_SIZE = 4;
+const unsigned int BITS_PER_BYTE = 8;
+
+const size_t WORD_SIZE = sizeof(uint64_t);
+// 1 MiB, a power of two.
+const uint64_t RING_WORDS = 128 * 1024;
+// The lowest bit of a header marks the padding up to the end of the ring,
+// the other bits are the size of the entry in bytes, without its header.
+const uint64_t PADDING = 1;
+// How often the writer thread drains the ring. It is not woken up by the
+// producers, so they never make a syscall. The traffic of a mixer stays far
+// below a full ring per interval.
+const std::chrono::milliseconds CAPTURE_DRAIN_INTERVAL(10);
+
+uint64_t words_for(size_t size) { return (size + WORD_SIZE - 1) / WORD_SIZE; }
+
+std::byte *put_le(std::byte *pos, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    *pos++ = std::byte(value >> (i * BITS_PER_BYTE));
+  }
+  return pos;
+}
+
+uint64_t get_le(const std::byte *pos, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= std::to_integer<uint64_t>(pos[i]) << (i * BITS_PER_BYTE);
+  }
+  return value;
+}
+
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+const char *as_chars(const std::byte *data) {
+  return reinterpret_cast<const char *>(data);
+}
+
+char *as_chars(std::byte *data) { return reinterpret_cast<char *>(data); }
+
+std::byte *as_bytes(uint64_t *data) {
+  return reinterpret_cast<std::byte *>(data);
+}
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+} // namespace
+
+CaptureWriter::CaptureWriter(const std::string &path)
+    : m_file(path, std::ios::binary | std::ios::trunc),
+      m_start(std::chrono::steady_clock::now()),
+      m_ring(std::make_unique<uint64_t[]>(RING_WORDS)) { // NOLINT
+  if (!m_file) {
+    throw std::runtime_error("Could not open capture file " + path);
+  }
+  m_file.write(as_chars(CAPTURE_MAGIC.data()), CAPTURE_MAGIC.size());
+  m_writing.reserve(RING_WORDS * WORD_SIZE);
+  m_thread = std::thread([this]() { run(); });
+  spdlog::info("Capturing traffic to " + path);
+}
+
+CaptureWriter::~CaptureWriter() {
+  m_stop.store(true, std::memory_order_release);
+  m_thread.join();
+  if (m_dropped > 0) {
+    spdlog::warn("Capture dropped " + std::to_string(m_dropped) + " records");
+  }
+}
+
+void CaptureWriter::record(CaptureSource source, uint8_t device,
+                           std::span<const std::byte> data) {
+  auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - m_start);
+  auto record_size = RECORD_HEADER_SIZE + data.size();
+  auto words = 1 + words_for(record_size);
+
+  // Reserves the words of the entry, and of a padding entry when the entry
+  // does not fit before the end of the ring.
+  auto reserved = m_reserved.load(std::memory_order_relaxed);
+  uint64_t needed = 0;
+  do {
+    auto until_end = RING_WORDS - (reserved & (RING_WORDS - 1));
+    needed = words <= until_end ? words : until_end + words;
+    if (reserved + needed - m_drained.load(std::memory_order_acquire) >
+        RING_WORDS) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  } while (!m_reserved.compare_exchange_weak(reserved, reserved + needed,
+                                             std::memory_order_relaxed));
+
+  auto offset = reserved & (RING_WORDS - 1);
+  if (needed != words) {
+    std::atomic_ref<uint64_t>(m_ring[offset])
+        .store(((RING_WORDS - offset - 1) * WORD_SIZE) << 1 | PADDING,
+               std::memory_order_release);
+    offset = 0;
+  }
+  auto *out = put_le(as_bytes(&m_ring[offset + 1]),
+                     static_cast<uint64_t>(timestamp.count()), TIMESTAMP_SIZE);
+  *out++ = std::byte(source);
+  *out++ = std::byte(device);
+  out = put_le(out, data.size(), DATA_SIZE_SIZE);
+  std::copy(data.begin(), data.end(), out);
+  // Commits the entry.
+  std::atomic_ref<uint64_t>(m_ring[offset])
+      .store(record_size << 1, std::memory_order_release);
+}
+
+void CaptureWriter::drain() {
+  auto drained = m_drained.load(std::memory_order_relaxed);
+  auto reserved = m_reserved.load(std::memory_order_acquire);
+  while (drained < reserved) {
+    auto offset = drained & (RING_WORDS - 1);
+    std::atomic_ref<uint64_t> header(m_ring[offset]);
+    auto value = header.load(std::memory_order_acquire);
+    if (value == 0) {
+      // Reserved, but the producer is still copying.
+      break;
+    }
+    auto size = value >> 1;
+    if ((value & PADDING) == 0) {
+      const auto *record = as_bytes(&m_ring[offset + 1]);
+      m_writing.insert(m_writing.end(), record, record + size);
+    }
+    header.store(0, std::memory_order_relaxed);
+    drained += 1 + words_for(size);
+  }
+  // Hands the drained words back to the producers.
+  m_drained.store(drained, std::memory_order_release);
+}
+
+void CaptureWriter::run() {
+  bool stop = false;
+  while (!stop) {
+    std::this_thread::sleep_for(CAPTURE_DRAIN_INTERVAL);
+    // Records before the stop are drained once more.
+    stop = m_stop.load(std::memory_order_acquire);
+    drain();
+    m_file.write(as_chars(m_writing.data()),
+                 static_cast<std::streamsize>(m_writing.size()));
+    m_writing.clear();
+  }
+  m_file.flush();
+}
+
+CaptureReader::CaptureReader(const std::string &path)
+    : m_file(path, std::ios::binary) {
+  std::array<std::byte, CAPTURE_MAGIC.size()> magic{};
+  m_file.read(as_chars(magic.data()), magic.size());
+  if (!m_file || magic != CAPTURE_MAGIC) {
+    throw std::runtime_error(path + " is not a capture file");
+  }
+}
+
+bool CaptureReader::next(CaptureRecord &record) {
+  std::array<std::byte, RECORD_HEADER_SIZE> header{};
+  m_file.read(as_chars(header.data()), header.size());
+  if (!m_file) {
+    return false;
+  }
+  const auto *pos = header.data();
+  record.timestamp = std::chrono::nanoseconds(get_le(pos, TIMESTAMP_SIZE));
+  pos += TIMESTAMP_SIZE;
+  record.source = static_cast<CaptureSource>(*pos++);
+  record.device = std::to_integer<uint8_t>(*pos++);
+  record.data.resize(get_le(pos, DATA_SIZE_SIZE));
+  m_file.read(as_chars(record.data.data()),
+              static_cast<std::streamsize>(record.data.size()));
+  if (!m_file) {
+    spdlog::warn("Capture file ends in the middle of a record");
+    return false;
+  }
+  return true;
+}
+
+} // namespace sls3mcubridge
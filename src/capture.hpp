@@ -0,0 +1,85 @@
+#pragma once
+
+#include "mpscqueue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sls3mcubridge {
+
+enum class CaptureSource : uint8_t {
+  TcpRead,     // bytes received from the mixer
+  TcpWrite,    // bytes sent to the mixer
+  MidiFromDaw, // midi message received from the DAW
+  MidiToDaw,   // midi message sent to the DAW
+};
+
+struct CaptureRecord {
+  // Time since the capture started.
+  std::chrono::nanoseconds timestamp{0};
+  CaptureSource source = CaptureSource::TcpRead;
+  uint8_t device = 0;
+  std::vector<std::byte> data;
+};
+
+// Writes timestamped traffic to a binary capture file. record() only copies
+// the bytes into a lock-free ring buffer, a background thread drains the ring
+// to the file. Records that do not fit in the ring are dropped and counted, so
+// recording never blocks the io and midi threads.
+class CaptureWriter {
+public:
+  explicit CaptureWriter(const std::string &path);
+  CaptureWriter(const CaptureWriter &obj) = delete;
+  CaptureWriter(CaptureWriter &&obj) = delete;
+  CaptureWriter &operator=(const CaptureWriter &obj) = delete;
+  CaptureWriter &operator=(CaptureWriter &&obj) = delete;
+  // Writes the remaining records.
+  ~CaptureWriter();
+
+  // May be called from any thread, never blocks.
+  void record(CaptureSource source, uint8_t device,
+              std::span<const std::byte> data);
+  [[nodiscard]] uint64_t get_dropped() const { return m_dropped.load(); }
+
+private:
+  void run();
+  // Copies the committed records from the ring to m_writing.
+  void drain();
+
+  std::ofstream m_file;
+  std::chrono::steady_clock::time_point m_start;
+  // Entries of 8 byte words: a header word, zero until the entry is
+  // committed, followed by the record as it is written to the file.
+  std::unique_ptr<uint64_t[]> m_ring; // NOLINT
+  // Words reserved by the producers and words drained by the writer thread,
+  // both counted since the start of the capture.
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_reserved{0};
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_drained{0};
+  std::atomic<bool> m_stop{false};
+  std::atomic<uint64_t> m_dropped{0};
+  // Only used by the writer thread.
+  std::vector<std::byte> m_writing;
+  std::thread m_thread;
+};
+
+// Reads a file written by CaptureWriter.
+class CaptureReader {
+public:
+  // Throws std::runtime_error when the file is not a capture.
+  explicit CaptureReader(const std::string &path);
+  // Reads the next record into `record`, returns false at the end of the file.
+  bool next(CaptureRecord &record);
+
+private:
+  std::ifstream m_file;
+};
+
+} // namespace sls3mcubridge
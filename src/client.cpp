@@ -1,71 +1,364 @@
 
 #include "client.hpp"
 
+#include "capture.hpp"
+#include "latency.hpp"
+#include "lowlatency.hpp"
+#include "metrics.hpp"
 #include "package.hpp"
+#include "trace.hpp"
+#include "writebatch.hpp"
 
+#include "asio/awaitable.hpp"
 #include "asio/buffer.hpp"
+#include "asio/buffer_registration.hpp"
 #include "asio/connect.hpp"
+#include "asio/error.hpp"
+#include "asio/post.hpp"
 #include "asio/ip/tcp.hpp"
 #include "asio/placeholders.hpp"
+#include "asio/steady_timer.hpp"
+#include "asio/system_error.hpp"
+#include "asio/use_awaitable.hpp"
+#include "asio/write.hpp"
 #include "spdlog/spdlog.h"
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <functional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <sys/types.h>
+#include <utility>
 
 namespace sls3mcubridge {
-void Client::connect(const std::string &host, int const &port) {
+namespace {
+// Cancels the socket operations when the deadline passes before the timer is
+// cancelled. Cancelled operations throw operation_aborted.
+void cancel_at(asio::steady_timer &timer, asio::ip::tcp::socket &socket,
+               asio::ip::tcp::resolver *resolver) {
+  timer.async_wait([&socket, resolver](const asio::error_code &error) {
+    if (!error) {
+      socket.cancel();
+      if (resolver != nullptr) {
+        resolver->cancel();
+      }
+    }
+  });
+}
+
+bool is_timeout(const asio::system_error &exc,
+                const asio::steady_timer &timer) {
+  return exc.code() == asio::error::operation_aborted &&
+         timer.expiry() <= std::chrono::steady_clock::now();
+}
+} // namespace
+
+std::string_view io_backend() {
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+  return "io_uring";
+#else
+  return "epoll";
+#endif
+}
+
+asio::awaitable<void>
+Client::async_connect(std::string host, int port,
+                      std::chrono::milliseconds timeout) {
   spdlog::info("Connecting to " + host + ":" + std::to_string(port));
   asio::ip::tcp::resolver resolver(m_socket.get_executor());
-  asio::ip::tcp::resolver::iterator endpoint = resolver.resolve(
-      asio::ip::tcp::resolver::query(host, std::to_string(port)));
-  asio::connect(this->m_socket, endpoint);
+  asio::steady_timer timer(m_socket.get_executor(), timeout);
+  cancel_at(timer, m_socket, &resolver);
+  try {
+    auto endpoints = co_await resolver.async_resolve(
+        host, std::to_string(port), asio::use_awaitable);
+    co_await asio::async_connect(m_socket, endpoints, asio::use_awaitable);
+  } catch (const asio::system_error &exc) {
+    if (is_timeout(exc, timer)) {
+      throw std::runtime_error("Timed out connecting to " + host);
+    }
+    throw;
+  }
+  timer.cancel();
+  if (m_low_latency) {
+    apply_low_latency(m_socket.native_handle(), *m_low_latency);
+    // Lets spin_read() return instead of blocking, asynchronous operations
+    // are not affected.
+    m_socket.non_blocking(m_low_latency->spin_read.count() > 0);
+  }
   spdlog::info("Connected succesfully");
 }
 
-void Client::write(const asio::const_buffer &message) {
-  try {
-    m_socket.send(asio::buffer(message));
-  } catch (const std::exception &exc) {
-    spdlog::warn("Failed to send tcp message: " + std::string(exc.what()));
+asio::awaitable<void> Client::async_write(asio::const_buffer message) {
+  capture(CaptureSource::TcpWrite, message.data(), message.size());
+  co_await asio::async_write(m_socket, message, asio::use_awaitable);
+}
+
+asio::awaitable<std::shared_ptr<tcp::Body>>
+Client::async_read_package(std::chrono::milliseconds timeout) {
+  asio::steady_timer timer(m_socket.get_executor(), timeout);
+  cancel_at(timer, m_socket, nullptr);
+  while (true) {
+    if (auto frame = m_framer.next_frame()) {
+      timer.cancel();
+      auto package = tcp::Package(*frame);
+      m_framer.compact();
+      co_return package.get_body();
+    }
+    m_framer.compact();
+    auto free_space = m_framer.prepare();
+    size_t bytes_read = 0;
+    try {
+      bytes_read = co_await m_socket.async_read_some(
+          asio::buffer(free_space.begin(), free_space.distance()),
+          asio::use_awaitable);
+    } catch (const asio::system_error &exc) {
+      if (is_timeout(exc, timer)) {
+        throw std::runtime_error("Timed out waiting for the mixer");
+      }
+      throw;
+    }
+    capture(CaptureSource::TcpRead, free_space.begin(), bytes_read);
+    m_framer.commit(bytes_read);
   }
 }
 
+void Client::write(const WriteBatch &batch) {
+  if (!m_connected && !m_buffer_while_disconnected) {
+    if (m_metrics) {
+      m_metrics->count(Metrics::Event::DroppedDisconnected);
+    }
+    return;
+  }
+  if (batch.size() > m_queued.remaining()) {
+    spdlog::warn("TCP write queue full, dropped " +
+                 std::to_string(batch.size()) + " bytes");
+    if (m_metrics) {
+      m_metrics->count(Metrics::Event::DroppedTcpWrite);
+    }
+    return;
+  }
+  for (const auto &buffer : batch.buffers()) {
+    m_queued.add_copy(buffer);
+  }
+  m_queued.add_marks(batch.marks());
+  start_writing();
+}
+
+void Client::start_writing() {
+  if (!m_connected || m_write_in_flight || m_queued.empty()) {
+    return;
+  }
+  std::swap(m_queued, m_in_flight);
+  m_write_in_flight = true;
+  trace(TraceStage::TcpWrite, TRACE_NONE, m_in_flight.size());
+  for (const auto &buffer : m_in_flight.buffers()) {
+    capture(CaptureSource::TcpWrite, buffer.data(), buffer.size());
+  }
+  asio::async_write(m_socket, m_in_flight.buffers(),
+                    std::bind(&Client::write_handler, shared_from_this(),
+                              asio::placeholders::error,
+                              asio::placeholders::bytes_transferred));
+}
+
+void Client::write_handler(const asio::error_code &error,
+                           size_t bytes_transferred) {
+  trace(TraceStage::TcpWritten, TRACE_NONE, bytes_transferred);
+  if (m_metrics) {
+    m_metrics->count_tcp(Metrics::Direction::DawToMixer, bytes_transferred);
+  }
+  if (error == asio::error::operation_aborted) {
+    // Stopped by close(), the batch is lost.
+  } else if (error) {
+    spdlog::warn("Failed to send tcp message: " + error.message());
+    disconnected(error);
+  } else if (m_latency) {
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &mark : m_in_flight.marks()) {
+      m_latency->record(LatencyMonitor::Direction::DawToMixer, mark.device,
+                        now - mark.received);
+    }
+  }
+  m_in_flight.clear();
+  m_write_in_flight = false;
+  start_writing();
+}
+
 void Client::start_reading(
-    const std::function<void(tcp::Package &)> &callback) {
+    const std::function<void(tcp::PackageView &)> &callback) {
   m_read_callback = callback;
-  m_socket.async_read_some(asio::buffer(m_buffer2),
-                           std::bind(&Client::read_handler, shared_from_this(),
-                                     asio::placeholders::error,
-                                     asio::placeholders::bytes_transferred));
+  m_connected = true;
+  register_buffer();
+  read_next();
+  start_writing();
+}
+
+void Client::register_buffer() {
+  if (m_registration_tried) {
+    return;
+  }
+  m_registration_tried = true;
+  try {
+    auto storage = m_framer.storage();
+    m_registration.emplace(m_socket.get_executor(),
+                           asio::buffer(storage.data(), storage.size()));
+  } catch (const asio::system_error &exc) {
+    spdlog::debug("Receive buffer not registered: " + std::string(exc.what()));
+  }
+}
+
+void Client::read_next() {
+  if (m_low_latency && m_low_latency->spin_read.count() > 0) {
+    spin_read(std::chrono::steady_clock::now() + m_low_latency->spin_read);
+    return;
+  }
+  wait_read();
+}
+
+void Client::wait_read() {
+  auto free_space = m_framer.prepare();
+  auto handler = std::bind(&Client::read_handler, shared_from_this(),
+                           asio::placeholders::error,
+                           asio::placeholders::bytes_transferred);
+  if (m_registration) {
+    // A single registered buffer is read with IORING_OP_READ_FIXED.
+    auto offset = static_cast<size_t>(free_space.begin() -
+                                      m_framer.storage().data());
+    m_socket.async_read_some(asio::buffer(*m_registration->begin() + offset,
+                                          free_space.distance()),
+                             handler);
+    return;
+  }
+  m_socket.async_read_some(
+      asio::buffer(free_space.begin(), free_space.distance()), handler);
+}
+
+void Client::spin_read(std::chrono::steady_clock::time_point deadline) {
+  if (!m_connected) {
+    // Stopped by close() while a poll was posted.
+    return;
+  }
+  auto free_space = m_framer.prepare();
+  asio::error_code error;
+  auto bytes = m_socket.read_some(
+      asio::buffer(free_space.begin(), free_space.distance()), error);
+  if (!error) {
+    // Posted, handling it right away would recurse into read_next().
+    asio::post(m_socket.get_executor(),
+               std::bind(&Client::read_handler, shared_from_this(),
+                         asio::error_code(), bytes));
+    return;
+  }
+  if (error != asio::error::would_block ||
+      std::chrono::steady_clock::now() >= deadline) {
+    // Errors are left to the asynchronous read, which reports them.
+    wait_read();
+    return;
+  }
+  // Every poll is a handler of its own, the handlers of other connections on
+  // this thread run in between.
+  asio::post(m_socket.get_executor(),
+             [self = shared_from_this(), deadline]() {
+               self->spin_read(deadline);
+             });
 }
 
 void Client::read_handler(const asio::error_code &error,
                           size_t bytes_transferred) {
+  if (!m_connected || error == asio::error::operation_aborted) {
+    // Stopped by close(), bytes that completed in the meantime are stale.
+    return;
+  }
   if (!error) {
+    m_receive_time = std::chrono::steady_clock::now();
+    if (m_low_latency) {
+      rearm_quickack(m_socket.native_handle());
+    }
     spdlog::debug("handle message");
+    capture(CaptureSource::TcpRead, m_framer.prepare().begin(),
+            bytes_transferred);
+    m_framer.commit(bytes_transferred);
+    if (m_metrics) {
+      m_metrics->count_tcp(Metrics::Direction::MixerToDaw, bytes_transferred);
+    }
+    auto resyncs = m_framer.get_resyncs();
+    auto skipped_bytes = m_framer.get_skipped_bytes();
     try {
-      size_t bytes_read = 0;
-      while (bytes_read < bytes_transferred) {
-        auto package = tcp::Package(tcp::BufferView(
-            m_buffer2.begin(), (m_buffer2.begin() + bytes_transferred)));
-
+      while (auto frame = m_framer.next_frame()) {
         try {
+          auto package = tcp::PackageView(*frame);
+          if (m_metrics) {
+            m_metrics->count_frame(Metrics::Direction::MixerToDaw,
+                                   package.get_type(), frame->distance());
+          }
           m_read_callback(package);
         } catch (const std::exception &exc) {
+          count_parse_failure();
           spdlog::warn("TCP callback failure: " + std::string(exc.what()));
         }
-        bytes_read += package.get_size();
       }
     } catch (const std::exception &exc) {
+      count_parse_failure();
       spdlog::warn("TCP read parse failure: " + std::string(exc.what()));
+      m_framer.reset();
     }
+    count_resyncs(resyncs, skipped_bytes);
+    m_framer.compact();
 
   } else {
-    spdlog::error("failed to read incomming TCP message: ");
+    // Includes eof, reading again would return immediately with it again.
+    spdlog::error("Failed to read incomming TCP message: " + error.message());
+    disconnected(error);
+    return;
+  }
+  read_next();
+}
+
+void Client::disconnected(const asio::error_code &error) {
+  if (!m_connected) {
+    return;
+  }
+  close();
+  if (m_disconnect_handler) {
+    m_disconnect_handler(error);
+  }
+}
+
+void Client::close() {
+  m_connected = false;
+  asio::error_code error;
+  m_socket.close(error);
+  // A partial package of the lost connection would corrupt the next one.
+  m_framer.reset();
+}
+
+void Client::count_parse_failure() {
+  if (m_metrics) {
+    m_metrics->count(Metrics::Event::ParseFailure);
+  }
+}
+
+void Client::count_resyncs(uint64_t resyncs, uint64_t skipped_bytes) {
+  auto skipped = m_framer.get_skipped_bytes() - skipped_bytes;
+  if (skipped == 0) {
+    return;
+  }
+  spdlog::warn("Skipped " + std::to_string(skipped) +
+               " corrupt bytes from the mixer");
+  if (m_metrics) {
+    for (auto i = resyncs; i < m_framer.get_resyncs(); i++) {
+      m_metrics->count(Metrics::Event::Resync);
+    }
+    m_metrics->count_skipped(skipped);
+  }
+}
+
+void Client::capture(CaptureSource source, const void *data, size_t size) {
+  if (m_capture) {
+    m_capture->record(source, 0, {static_cast<const std::byte *>(data), size});
   }
-  start_reading(m_read_callback);
 }
 } // namespace sls3mcubridge
@@ -1,35 +1,146 @@
 #pragma once
 
-#include <array>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 
+#include "capture.hpp"
+#include "framer.hpp"
+#include "latency.hpp"
+#include "lowlatency.hpp"
+#include "metrics.hpp"
+#include "writebatch.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/awaitable.hpp"
 #include "asio/buffer.hpp"
-#include "asio/io_context.hpp"
+#include "asio/buffer_registration.hpp"
+#include "asio/error_code.hpp"
 #include "asio/ip/tcp.hpp"
 
 namespace sls3mcubridge {
 namespace tcp {
-class Package;
+class Body;
+class PackageView;
 } // namespace tcp
 
-const size_t MAX_BUFFER_SIZE = 1500;
+// Room for the largest frame the header can announce.
+const size_t MAX_BUFFER_SIZE = tcp::MAX_PACKAGE_SIZE;
+// Upper bound of bytes waiting for the socket, further writes are dropped.
+// Holds the largest SysEx package next to other traffic.
+const size_t MAX_QUEUED_WRITE_SIZE = 2 * tcp::MAX_PACKAGE_SIZE;
+
+// Backend asio runs the socket operations on, "io_uring" when built with the
+// IO_URING cmake option, "epoll" otherwise.
+std::string_view io_backend();
+
 class Client : public std::enable_shared_from_this<Client> {
 public:
-  explicit Client(asio::io_context &io_context) : m_socket(io_context) {}
-  void connect(std::string const &host, int const &port);
-  void write(const asio::const_buffer &message);
-  size_t read_some(const asio::mutable_buffers_1 &buffer) {
-    return m_socket.read_some(buffer);
+  explicit Client(const asio::any_io_executor &executor)
+      : m_socket(executor) {}
+  // Resolves `host` and connects, throws when not connected within `timeout`.
+  asio::awaitable<void> async_connect(std::string host, int port,
+                                      std::chrono::milliseconds timeout);
+  // Writes `message` directly, only used before reading starts.
+  asio::awaitable<void> async_write(asio::const_buffer message);
+  // Reads until a complete package arrived and returns its body, only used
+  // before reading starts. Throws when no package arrived within `timeout`.
+  // Bytes following the package are kept for start_reading().
+  asio::awaitable<std::shared_ptr<tcp::Body>>
+  async_read_package(std::chrono::milliseconds timeout);
+  // Queues the batch for an asynchronous write. Has to be called from the
+  // executor of the client. At most one write is in flight, batches queued in
+  // the meantime go out together in the next write. While disconnected batches
+  // are dropped, or held until reading starts again when buffering. The
+  // buffers of the batch are copied, a batch that does not fit in the queue is
+  // dropped as a whole.
+  void write(const WriteBatch &batch);
+  // Starts forwarding packages to `callback` and writing queued batches, until
+  // the connection is lost or closed.
+  void start_reading(const std::function<void(tcp::PackageView &)> &callback);
+  // Closes the connection, reading stops.
+  void close();
+  // Called once when the connection started by start_reading() is lost, not
+  // when it is closed by close(). The client can be connected again.
+  void set_disconnect_handler(
+      std::function<void(const asio::error_code &)> handler) {
+    m_disconnect_handler = std::move(handler);
+  }
+  // Holds batches written while disconnected instead of dropping them.
+  void set_buffer_while_disconnected(bool buffer) {
+    m_buffer_while_disconnected = buffer;
+  }
+  [[nodiscard]] bool is_connected() const { return m_connected; }
+  // Records all bytes read and written from now on.
+  void set_capture(std::shared_ptr<CaptureWriter> capture) {
+    m_capture = std::move(capture);
+  }
+  // Records the DAW to mixer latency of marked batches once they are written.
+  void set_latency(std::shared_ptr<LatencyMonitor> latency) {
+    m_latency = std::move(latency);
+  }
+  // Applies the low latency socket options on every connect from now on.
+  void set_low_latency(std::optional<LowLatencyConfig> config) {
+    m_low_latency = config;
+  }
+  // Counts the traffic on the socket from now on.
+  void set_metrics(std::shared_ptr<Metrics> metrics) {
+    m_metrics = std::move(metrics);
+  }
+  // Bytes waiting for the socket, not counting the write in flight.
+  [[nodiscard]] size_t get_queued_size() const { return m_queued.size(); }
+  // When the bytes of the packages handed to the read callback were received.
+  [[nodiscard]] std::chrono::steady_clock::time_point
+  get_receive_time() const {
+    return m_receive_time;
   }
-  void start_reading(const std::function<void(tcp::Package &)> &callback);
 
 private:
+  // Registers the framer buffer for the reads, once.
+  void register_buffer();
+  void read_next();
+  // Hands the next read to the reactor.
+  void wait_read();
+  // Polls the socket until `deadline`, once per posted handler so it never
+  // holds the thread, and waits for the reactor when nothing arrived.
+  void spin_read(std::chrono::steady_clock::time_point deadline);
   void read_handler(const asio::error_code &error,
                     std::size_t bytes_transferred);
+  void disconnected(const asio::error_code &error);
+  void start_writing();
+  void write_handler(const asio::error_code &error,
+                     std::size_t bytes_transferred);
+  void capture(CaptureSource source, const void *data, size_t size);
+  void count_parse_failure();
+  // Accounts the bytes the framer skipped since it counted `resyncs` and
+  // `skipped_bytes`.
+  void count_resyncs(uint64_t resyncs, uint64_t skipped_bytes);
   asio::ip::tcp::socket m_socket;
-  std::function<void(tcp::Package &)> m_read_callback;
-  std::array<std::byte, MAX_BUFFER_SIZE> m_buffer2{};
+  std::function<void(tcp::PackageView &)> m_read_callback;
+  std::function<void(const asio::error_code &)> m_disconnect_handler;
+  // Set by start_reading(), cleared when the connection is lost or closed.
+  bool m_connected = false;
+  bool m_buffer_while_disconnected = false;
+  std::optional<LowLatencyConfig> m_low_latency;
+  tcp::StreamFramer m_framer{MAX_BUFFER_SIZE, true};
+  // The framer buffer registered with io_uring, reads into it skip mapping
+  // the pages on every receive. Empty when registering failed, io_uring
+  // allows one registration per ring and several clients may share one.
+  std::optional<asio::buffer_registration<asio::mutable_buffer>>
+      m_registration;
+  bool m_registration_tried = false;
+  WriteBatch m_queued{MAX_QUEUED_WRITE_SIZE};
+  WriteBatch m_in_flight{MAX_QUEUED_WRITE_SIZE};
+  bool m_write_in_flight = false;
+  std::shared_ptr<CaptureWriter> m_capture;
+  std::shared_ptr<LatencyMonitor> m_latency;
+  std::shared_ptr<Metrics> m_metrics;
+  std::chrono::steady_clock::time_point m_receive_time;
 };
 } // namespace sls3mcubridge
\ No newline at end of file
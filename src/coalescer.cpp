@@ -0,0 +1,321 @@
+#include "coalescer.hpp"
+
+#include "lastvalue.hpp"
+#include "metrics.hpp"
+#include "midimessage.hpp"
+#include "package.hpp"
+#include "surfacestate.hpp"
+#include "trace.hpp"
+#include "writebatch.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/post.hpp"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sls3mcubridge {
+
+const size_t OUTGOING_MIDI_PREFIX_SIZE = 3;
+// As many channel messages as the one byte count field of a body counts and
+// its size field holds.
+const size_t MAX_MESSAGES_PER_BODY =
+    std::min<size_t>(UINT8_MAX, (tcp::MAX_BODY_SIZE -
+                                 tcp::Body::BODY_HEADER_SIZE -
+                                 OUTGOING_MIDI_PREFIX_SIZE) /
+                                    CHANNEL_MESSAGE_SIZE);
+static_assert(tcp::HEADER_SIZE + tcp::Body::BODY_HEADER_SIZE +
+                      OUTGOING_MIDI_PREFIX_SIZE +
+                      (MAX_MESSAGES_PER_BODY * CHANNEL_MESSAGE_SIZE) <=
+                  MAX_SEGMENT_SIZE,
+              "A full body has to fit in one segment");
+
+namespace {
+// Bytes a SysEx message of `size` bytes costs once sent as a package.
+size_t sysex_package_size(size_t size) {
+  return static_cast<size_t>(tcp::HEADER_SIZE) +
+         tcp::Body::fixed_size(tcp::Body::Type::SysEx) + size;
+}
+
+// Serializes `item` into the batch, handing the batch to `sink` first when it
+// is full.
+void add_serialized(const tcp::ISerialize &item, WriteBatch &batch,
+                    const MidiCoalescer::Sink &sink) {
+  if (batch.add(item)) {
+    return;
+  }
+  sink(batch);
+  batch.clear();
+  if (!batch.add(item)) {
+    throw std::length_error("Package does not fit in an empty write batch");
+  }
+}
+
+// A package around a body that lives on the stack, where tcp::Package shares
+// a body on the heap.
+class BodyPackage : public tcp::ISerialize {
+public:
+  explicit BodyPackage(const tcp::Body &body) : m_body(body) {
+    m_header.set_body_size(body.get_size());
+  }
+
+  [[nodiscard]] size_t serialized_size() const override {
+    return tcp::HEADER_SIZE + m_body.get_size();
+  }
+  size_t serialize_into(std::span<std::byte> buffer) const override {
+    auto pos = m_header.serialize_into(buffer);
+    return pos + m_body.serialize_into(buffer.subspan(pos));
+  }
+
+private:
+  tcp::Header m_header;
+  const tcp::Body &m_body;
+};
+
+// Serializes the package of `body` into the batch without allocating.
+void add_package(const tcp::Body &body, WriteBatch &batch,
+                 const MidiCoalescer::Sink &sink, Metrics *metrics) {
+  auto package = BodyPackage(body);
+  if (metrics != nullptr) {
+    metrics->count_frame(Metrics::Direction::DawToMixer, body.get_type(),
+                         package.serialized_size());
+  }
+  add_serialized(package, batch, sink);
+}
+
+// A SysEx message that fits in a segment is serialized into the batch. A
+// longer one is serialized with all its fragments into a batch of its own and
+// handed to `sink` at once, so the client queues the whole message or drops
+// it, the mixer never joins a truncated message.
+void add_sysex(std::byte device, std::span<const unsigned char> message,
+               WriteBatch &batch, const MidiCoalescer::Sink &sink,
+               Metrics *metrics) {
+  auto remaining = std::as_bytes(message);
+  if (sysex_package_size(remaining.size()) <= MAX_SEGMENT_SIZE) {
+    add_package(tcp::SysExMidiBody(device, remaining), batch, sink, metrics);
+    return;
+  }
+  if (remaining.size() > MAX_SYSEX_SIZE) {
+    spdlog::warn("Dropped SysEx message of " +
+                 std::to_string(remaining.size()) + " bytes, at most " +
+                 std::to_string(MAX_SYSEX_SIZE) + " bytes are sent");
+    if (metrics != nullptr) {
+      metrics->count(Metrics::Event::DroppedMidi);
+    }
+    return;
+  }
+  auto nr_fragments =
+      (remaining.size() + tcp::MAX_SYSEX_FRAGMENT_SIZE - 1) /
+      tcp::MAX_SYSEX_FRAGMENT_SIZE;
+  WriteBatch fragments(nr_fragments * sysex_package_size(0) +
+                       remaining.size());
+  while (!remaining.empty()) {
+    auto fragment = remaining.first(
+        std::min(remaining.size(), tcp::MAX_SYSEX_FRAGMENT_SIZE));
+    add_package(tcp::SysExMidiBody(device, fragment), fragments, sink,
+                metrics);
+    remaining = remaining.subspan(fragment.size());
+  }
+  if (!batch.empty()) {
+    sink(batch);
+    batch.clear();
+  }
+  sink(fragments);
+  if (nr_fragments > 1 && metrics != nullptr) {
+    metrics->count(Metrics::Event::FragmentedSysEx);
+  }
+}
+} // namespace
+
+MidiCoalescer::MidiCoalescer(const asio::any_io_executor &executor,
+                             std::byte device, std::chrono::microseconds window,
+                             bool collapse, Sink sink)
+    : m_executor(executor), m_timer(executor), m_device(device),
+      m_device_index(
+          static_cast<size_t>(tcp::MidiDeviceIndicator(device).get_index())),
+      m_window(window), m_sink(std::move(sink)) {
+  if (collapse) {
+    m_filter.emplace(false);
+  }
+}
+
+void MidiCoalescer::push(const ShortMessage &message) {
+  enqueue({message, {}, std::chrono::steady_clock::now()});
+}
+
+void MidiCoalescer::push_sysex(std::span<const unsigned char> message) {
+  enqueue({{},
+           std::vector<unsigned char>(message.begin(), message.end()),
+           std::chrono::steady_clock::now()});
+}
+
+void MidiCoalescer::enqueue(QueuedMessage &&queued) {
+  if (!m_queue.try_push(std::move(queued))) {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    if (m_metrics) {
+      m_metrics->count(Metrics::Event::DroppedMidi);
+    }
+    return;
+  }
+  // Pairs with the fence in flush(): either flush() sees the message or this
+  // sees the cleared flag and schedules the next flush.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_flush_scheduled.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  asio::post(m_executor,
+             [self = shared_from_this()]() { self->schedule_flush(); });
+}
+
+void MidiCoalescer::schedule_flush() {
+  auto due = m_last_flush + m_window;
+  if (std::chrono::steady_clock::now() >= due) {
+    // Line is idle, send right away.
+    flush();
+    return;
+  }
+  m_timer.expires_at(due);
+  m_timer.async_wait(
+      [self = shared_from_this()](const asio::error_code &error) {
+        if (!error) {
+          self->flush();
+        }
+      });
+}
+
+void MidiCoalescer::flush() {
+  // Cleared before draining, a message pushed during the drain either is
+  // drained now or schedules the next flush. The fence keeps the drain from
+  // being reordered before the store, see enqueue().
+  m_flush_scheduled.store(false, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  m_last_flush = std::chrono::steady_clock::now();
+
+  QueuedMessage queued;
+  std::chrono::steady_clock::time_point oldest;
+  while (m_queue.try_pop(queued)) {
+    if (m_flushing.empty()) {
+      oldest = queued.received;
+    }
+    if (queued.sysex.empty()) {
+      m_flushing.push_back(queued.message);
+    } else {
+      m_flushing.push_back(std::span(queued.sysex));
+    }
+  }
+  if (m_filter) {
+    m_filter->collapse(m_flushing.short_messages());
+  }
+  if (m_surface) {
+    update_surface();
+  }
+
+  if (auto dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+      dropped > 0) {
+    spdlog::warn("Midi queue full, dropped " + std::to_string(dropped) +
+                 " messages");
+  }
+
+  try {
+    m_batch.clear();
+    encode(m_device, m_flushing, m_batch, m_sink, m_metrics.get());
+    if (!m_batch.empty()) {
+      m_batch.mark(m_device_index, oldest);
+      trace(TraceStage::CoalescerFlush, static_cast<uint8_t>(m_device_index),
+            m_batch.size());
+      m_sink(m_batch);
+    }
+  } catch (const std::exception &exc) {
+    spdlog::warn("Failed to send coalesced midi messages: " +
+                 std::string(exc.what()));
+  }
+  m_flushing.clear();
+}
+
+void MidiCoalescer::update_surface() {
+  // Midi devices call push() on their own thread, the surface state is only
+  // updated here on the executor.
+  if (!m_compress_lcd) {
+    m_flushing.for_each([this](std::span<const unsigned char> message) {
+      m_surface->update_from_daw(message);
+    });
+    return;
+  }
+  size_t saved = 0;
+  m_rewritten.clear();
+  m_flushing.for_each([this, &saved](std::span<const unsigned char> message) {
+    auto nr_sysex = m_rewritten.nr_sysex();
+    auto sysex_size = m_rewritten.sysex_size();
+    if (!m_surface->diff_lcd(message, m_rewritten)) {
+      m_surface->update_from_daw(message);
+      m_rewritten.push_back(message);
+      return;
+    }
+    // The updates are SysEx messages as well.
+    auto updates_size =
+        (m_rewritten.nr_sysex() - nr_sysex) * sysex_package_size(0) +
+        m_rewritten.sysex_size() - sysex_size;
+    saved += sysex_package_size(message.size()) - updates_size;
+  });
+  std::swap(m_flushing, m_rewritten);
+  if (m_metrics && saved > 0) {
+    m_metrics->count_lcd_saved(m_device_index, saved);
+  }
+}
+
+void MidiCoalescer::encode(std::byte device, const MessageRun &messages,
+                           WriteBatch &batch, const Sink &sink) {
+  encode(device, messages, batch, sink, nullptr);
+}
+
+void MidiCoalescer::encode(std::byte device, const MessageRun &messages,
+                           WriteBatch &batch, const Sink &sink,
+                           Metrics *metrics) {
+  // Channel messages are packed inline and their bodies serialized from the
+  // stack, encoding them does not allocate.
+  std::array<ShortMessage, MAX_MESSAGES_PER_BODY> channel_messages;
+  size_t nr_channel_messages = 0;
+  auto add_channel_messages = [&]() {
+    if (nr_channel_messages == 0) {
+      return;
+    }
+    add_package(tcp::OutgoingMidiBody(device,
+                                      std::span(channel_messages.data(),
+                                                nr_channel_messages)),
+                batch, sink, metrics);
+    nr_channel_messages = 0;
+  };
+
+  messages.for_each([&](std::span<const unsigned char> message) {
+    if (!message.empty() && message[0] == SYSEX_START) {
+      add_channel_messages();
+      add_sysex(device, message, batch, sink, metrics);
+    } else if (message.size() != CHANNEL_MESSAGE_SIZE) {
+      // The mixer splits multi message bodies in three byte messages, shorter
+      // messages are sent on their own.
+      add_channel_messages();
+      ShortMessage short_message(message);
+      add_package(tcp::OutgoingMidiBody(device, std::span(&short_message, 1)),
+                  batch, sink, metrics);
+    } else {
+      channel_messages.at(nr_channel_messages++) = ShortMessage(message);
+      if (nr_channel_messages == MAX_MESSAGES_PER_BODY) {
+        add_channel_messages();
+      }
+    }
+  });
+  add_channel_messages();
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "lastvalue.hpp"
+#include "metrics.hpp"
+#include "midimessage.hpp"
+#include "mpscqueue.hpp"
+#include "package.hpp"
+#include "surfacestate.hpp"
+#include "writebatch.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/steady_timer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Typical TCP payload size of one ethernet segment.
+const size_t MAX_SEGMENT_SIZE = 1460;
+// Messages a device may have waiting for the executor.
+const size_t MIDI_QUEUE_CAPACITY = 1024;
+// Longest SysEx message sent to the mixer. All its fragments go to the client
+// in one write and the client queues at most MAX_QUEUED_WRITE_SIZE bytes, so
+// longer messages are dropped.
+const size_t MAX_SYSEX_FRAGMENTS = 2;
+const size_t MAX_SYSEX_SIZE =
+    MAX_SYSEX_FRAGMENTS * tcp::MAX_SYSEX_FRAGMENT_SIZE;
+
+// Collects the DAW to mixer messages of one midi device and sends them as few
+// packages as possible. Channel messages that arrive before the next flush are
+// packed into a shared OutgoingMidiBody, packages are gathered into writes of
+// at most one segment. A flush happens on the next executor turn when the
+// previous flush is at least `window` ago, otherwise when the window expires.
+// With `collapse` set, only the newest pending value of a continuous control
+// is sent, see LastValueFilter. The last batch of a flush carries the receive
+// time of the oldest message flushed, see WriteBatch::mark().
+class MidiCoalescer : public std::enable_shared_from_this<MidiCoalescer> {
+public:
+  using Sink = std::function<void(const WriteBatch &)>;
+
+  MidiCoalescer(const asio::any_io_executor &executor, std::byte device,
+                std::chrono::microseconds window, bool collapse, Sink sink);
+
+  // Queues a message for the next flush. May be called from any thread and
+  // never blocks, the message is dropped when the queue is full.
+  void push(const ShortMessage &message);
+  // Like push(), for a SysEx message. Its bytes are copied to storage of their
+  // own, the queue holds channel messages without allocating.
+  void push_sysex(std::span<const unsigned char> message);
+
+  // Encodes `messages` for `device` and hands every full segment to `sink`.
+  // A SysEx message longer than a segment is handed to `sink` in a batch of
+  // its own, with all its fragments.
+  static void encode(std::byte device, const MessageRun &messages,
+                     WriteBatch &batch, const Sink &sink);
+  // Also counts the encoded packages in `metrics` when not null.
+  static void encode(std::byte device, const MessageRun &messages,
+                     WriteBatch &batch, const Sink &sink, Metrics *metrics);
+
+  // Counts dropped messages and sent packages from now on.
+  void set_metrics(std::shared_ptr<Metrics> metrics) {
+    m_metrics = std::move(metrics);
+  }
+  // Updates `surface` with the flushed messages from now on.
+  void set_surface_state(std::shared_ptr<SurfaceState> surface) {
+    m_surface = std::move(surface);
+  }
+  // Rewrites LCD messages to only the characters that changed on the surface,
+  // see SurfaceState::diff_lcd(). Needs a surface state.
+  void set_compress_lcd(bool compress) { m_compress_lcd = compress; }
+  // Only to be used on the executor.
+  [[nodiscard]] size_t get_queue_depth() const { return m_queue.size(); }
+
+  // Only to be used on the executor.
+  [[nodiscard]] const std::optional<LastValueFilter> &get_filter() const {
+    return m_filter;
+  }
+
+private:
+  struct QueuedMessage {
+    ShortMessage message;
+    // The bytes of a SysEx message, `message` is empty then.
+    std::vector<unsigned char> sysex;
+    std::chrono::steady_clock::time_point received;
+  };
+
+  void enqueue(QueuedMessage &&queued);
+
+  void schedule_flush();
+  void flush();
+  void update_surface();
+
+  asio::any_io_executor m_executor;
+  asio::steady_timer m_timer;
+  std::byte m_device;
+  size_t m_device_index;
+  std::chrono::microseconds m_window;
+  Sink m_sink;
+  std::shared_ptr<Metrics> m_metrics;
+  std::shared_ptr<SurfaceState> m_surface;
+  bool m_compress_lcd = false;
+  std::optional<LastValueFilter> m_filter;
+
+  MpscQueue<QueuedMessage> m_queue{MIDI_QUEUE_CAPACITY};
+  std::atomic<bool> m_flush_scheduled = false;
+  std::atomic<size_t> m_dropped = 0;
+
+  // Only used on the executor.
+  std::chrono::steady_clock::time_point m_last_flush;
+  MessageRun m_flushing;
+  MessageRun m_rewritten;
+  WriteBatch m_batch{MAX_SEGMENT_SIZE};
+};
+
+} // namespace sls3mcubridge
@@ -0,0 +1,155 @@
+#include "framer.hpp"
+
+#include "package.hpp"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace sls3mcubridge::tcp {
+
+namespace {
+const std::array<std::byte, 4> HEADER_MAGIC = {
+    HEADER_FIRST_BYTE, HEADER_SECOND_BYTE, std::byte(0x00), HEADER_UNKOWN_BYTE};
+// The body starts with its two byte type code.
+const size_t BODY_TYPE_SIZE = 2;
+
+bool starts_with_header(const std::byte *begin) {
+  return std::memcmp(begin, HEADER_MAGIC.data(), HEADER_MAGIC.size()) == 0;
+}
+
+bool has_known_body_type(const std::byte *body) {
+  auto code =
+      static_cast<uint16_t>((std::to_integer<uint16_t>(body[0]) << CHAR_BIT) |
+                            std::to_integer<uint16_t>(body[1]));
+  return Body::type_from_int(code) != Body::Type::Unkown;
+}
+
+// First position in [begin, end) where a header starts, or where the range
+// ends with the start of one, otherwise end. memchr is vectorized by the C
+// library, so runs of corrupt bytes are scanned many bytes at a time.
+std::byte *find_header(std::byte *begin, std::byte *end) {
+  while (begin < end) {
+    auto *candidate = static_cast<std::byte *>(
+        std::memchr(begin, std::to_integer<int>(HEADER_FIRST_BYTE),
+                    static_cast<size_t>(end - begin)));
+    if (candidate == nullptr) {
+      return end;
+    }
+    auto size =
+        std::min(static_cast<size_t>(end - candidate), HEADER_MAGIC.size());
+    if (std::memcmp(candidate, HEADER_MAGIC.data(), size) == 0) {
+      return candidate;
+    }
+    begin = candidate + 1;
+  }
+  return end;
+}
+} // namespace
+
+StreamFramer::StreamFramer(size_t capacity, bool resync)
+    : m_buffer(capacity), m_resync(resync) {
+  if (capacity < HEADER_SIZE) {
+    throw std::invalid_argument("Framer capacity smaller than a header");
+  }
+}
+
+BufferView<std::byte *> StreamFramer::prepare() {
+  return {m_buffer.data() + m_write_pos, m_buffer.data() + m_buffer.size()};
+}
+
+void StreamFramer::commit(size_t bytes) {
+  if (bytes > m_buffer.size() - m_write_pos) {
+    throw std::out_of_range("Committed more bytes than prepared");
+  }
+  m_write_pos += bytes;
+}
+
+std::optional<BufferView<std::byte *>> StreamFramer::next_frame() {
+  size_t frame_size = 0;
+  if (m_resync) {
+    while (buffered() >= HEADER_SIZE) {
+      frame_size = valid_frame_size();
+      if (frame_size != 0) {
+        break;
+      }
+      skip_to_header();
+    }
+    if (frame_size == 0) {
+      return std::nullopt;
+    }
+  } else {
+    if (buffered() < HEADER_SIZE) {
+      return std::nullopt;
+    }
+    auto *frame_begin = m_buffer.data() + m_read_pos;
+    auto header = Header(BufferView(frame_begin, frame_begin + HEADER_SIZE));
+    frame_size = HEADER_SIZE + header.get_body_size();
+    if (frame_size > m_buffer.size()) {
+      throw std::length_error("Frame of " + std::to_string(frame_size) +
+                              " bytes does not fit in receive buffer");
+    }
+  }
+  if (buffered() < frame_size) {
+    return std::nullopt;
+  }
+
+  auto *frame_begin = m_buffer.data() + m_read_pos;
+  m_read_pos += frame_size;
+  m_resyncing = false;
+  return BufferView(frame_begin, frame_begin + frame_size);
+}
+
+size_t StreamFramer::valid_frame_size() {
+  auto *frame_begin = m_buffer.data() + m_read_pos;
+  if (!starts_with_header(frame_begin)) {
+    return 0;
+  }
+  auto header = Header(BufferView(frame_begin, frame_begin + HEADER_SIZE));
+  auto body_size = header.get_body_size();
+  auto frame_size = HEADER_SIZE + body_size;
+  if (body_size < static_cast<size_t>(Body::BODY_HEADER_SIZE) ||
+      frame_size > m_buffer.size()) {
+    return 0;
+  }
+  // A header found by scanning may be part of the corrupt bytes, its body type
+  // has to be known. Until the type code arrived the frame is incomplete as
+  // well, so next_frame() waits and checks it again.
+  if (m_resyncing && buffered() >= HEADER_SIZE + BODY_TYPE_SIZE &&
+      !has_known_body_type(frame_begin + HEADER_SIZE)) {
+    return 0;
+  }
+  return frame_size;
+}
+
+void StreamFramer::skip_to_header() {
+  if (!m_resyncing) {
+    m_resyncing = true;
+    m_resyncs++;
+  }
+  auto *begin = m_buffer.data() + m_read_pos;
+  auto *header = find_header(begin + 1, m_buffer.data() + m_write_pos);
+  auto skipped = static_cast<size_t>(header - begin);
+  m_read_pos += skipped;
+  m_skipped_bytes += skipped;
+}
+
+void StreamFramer::compact() {
+  if (m_read_pos == 0) {
+    return;
+  }
+  auto remaining = buffered();
+  if (remaining > 0) {
+    std::memmove(m_buffer.data(), m_buffer.data() + m_read_pos, remaining);
+  }
+  m_read_pos = 0;
+  m_write_pos = remaining;
+}
+
+} // namespace sls3mcubridge::tcp
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "package.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace sls3mcubridge::tcp {
+
+// Splits a TCP byte stream into complete UCNet frames. Bytes are read directly
+// into the framer's own buffer, complete frames are handed out as views into
+// that buffer and a trailing partial frame is kept for the next read.
+//
+// With `resync` set, corrupt bytes do not throw: they are skipped up to the
+// next 'U', 'C', 0x00, 0x01 header announcing a body that fits the buffer.
+// While resynchronizing, a header is only accepted when its body type is known.
+class StreamFramer {
+public:
+  explicit StreamFramer(size_t capacity) : StreamFramer(capacity, false) {}
+  StreamFramer(size_t capacity, bool resync);
+
+  // Free space behind the buffered bytes, to be filled by the next read.
+  BufferView<std::byte *> prepare();
+  // Marks `bytes` of the prepared space as received.
+  void commit(size_t bytes);
+  // The whole buffer, prepare() returns a part of it. It never moves, so it
+  // can be registered with the kernel once.
+  [[nodiscard]] std::span<std::byte> storage() { return m_buffer; }
+
+  // Returns the next complete frame or std::nullopt when the buffered bytes do
+  // not contain a complete frame. The view is valid until compact() or reset()
+  // is called. Without resync, throws when the buffered bytes do not start
+  // with a valid header or when the announced frame can never fit in the
+  // buffer.
+  std::optional<BufferView<std::byte *>> next_frame();
+
+  // Moves a trailing partial frame to the start of the buffer.
+  void compact();
+  // Drops all buffered bytes.
+  void reset() {
+    m_read_pos = m_write_pos = 0;
+    m_resyncing = false;
+  }
+
+  [[nodiscard]] size_t buffered() const { return m_write_pos - m_read_pos; }
+  [[nodiscard]] size_t capacity() const { return m_buffer.size(); }
+  // Times corrupt bytes were found, and the number of bytes skipped over.
+  [[nodiscard]] uint64_t get_resyncs() const { return m_resyncs; }
+  [[nodiscard]] uint64_t get_skipped_bytes() const { return m_skipped_bytes; }
+
+private:
+  // Size of the frame starting at the read position, 0 when it does not start
+  // with a valid header.
+  size_t valid_frame_size();
+  // Skips the read position to the next candidate header.
+  void skip_to_header();
+
+  std::vector<std::byte> m_buffer;
+  size_t m_read_pos = 0;
+  size_t m_write_pos = 0;
+  bool m_resync;
+  bool m_resyncing = false;
+  uint64_t m_resyncs = 0;
+  uint64_t m_skipped_bytes = 0;
+};
+
+} // namespace sls3mcubridge::tcp
@@ -0,0 +1,99 @@
+#include "lastvalue.hpp"
+#include "midimessage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Mackie relative encoders: bit 6 is the direction, bits 0-5 the ticks.
+const uint8_t VPOT_FIRST_CONTROLLER = 0x10;
+const uint8_t VPOT_LAST_CONTROLLER = 0x17;
+const uint8_t JOG_WHEEL_CONTROLLER = 0x3c;
+const uint8_t RELATIVE_DIRECTION_BIT = 0x40;
+const uint8_t RELATIVE_TICKS_MASK = 0x3f;
+
+LastValueFilter::LastValueFilter(bool relative_encoders)
+    : m_relative_encoders(relative_encoders) {
+  m_slots.fill(NO_SLOT);
+}
+
+LastValueFilter::Kind LastValueFilter::classify(const ShortMessage &message,
+                                                size_t &key) const {
+  if (message.size() != CHANNEL_MESSAGE_SIZE) {
+    return Kind::Barrier;
+  }
+  auto channel = static_cast<size_t>(message[0] & CHANNEL_MASK);
+
+  switch (message[0] & STATUS_MASK) {
+  case PITCH_BEND:
+    key = channel;
+    return Kind::Absolute;
+  case CONTROL_CHANGE: {
+    auto controller = static_cast<uint8_t>(message[1] & DATA_MASK);
+    key = NR_OF_CHANNELS + channel * NR_OF_CONTROLLERS + controller;
+    if (m_relative_encoders &&
+        ((controller >= VPOT_FIRST_CONTROLLER &&
+          controller <= VPOT_LAST_CONTROLLER) ||
+         controller == JOG_WHEEL_CONTROLLER)) {
+      return Kind::Relative;
+    }
+    return Kind::Absolute;
+  }
+  default:
+    return Kind::Barrier;
+  }
+}
+
+void LastValueFilter::clear_slots() {
+  for (auto key : m_used_keys) {
+    m_slots.at(key) = NO_SLOT;
+  }
+  m_used_keys.clear();
+}
+
+size_t LastValueFilter::collapse(std::vector<ShortMessage> &messages) {
+  size_t out = 0;
+  for (size_t i = 0; i < messages.size(); i++) {
+    size_t key = 0;
+    auto kind = classify(messages[i], key);
+
+    if (kind == Kind::Barrier) {
+      clear_slots();
+    } else if (auto slot = m_slots.at(key); slot != NO_SLOT) {
+      auto &pending = messages[static_cast<size_t>(slot)];
+      if (kind == Kind::Absolute) {
+        pending = std::move(messages[i]);
+        continue;
+      }
+      auto pending_direction = pending[2] & RELATIVE_DIRECTION_BIT;
+      auto ticks = (pending[2] & RELATIVE_TICKS_MASK) +
+                   (messages[i][2] & RELATIVE_TICKS_MASK);
+      if ((messages[i][2] & RELATIVE_DIRECTION_BIT) == pending_direction &&
+          ticks <= RELATIVE_TICKS_MASK) {
+        pending[2] = static_cast<unsigned char>(pending_direction | ticks);
+        continue;
+      }
+      m_slots.at(key) = static_cast<int32_t>(out);
+    } else {
+      m_slots.at(key) = static_cast<int32_t>(out);
+      m_used_keys.push_back(key);
+    }
+
+    if (out != i) {
+      messages[out] = std::move(messages[i]);
+    }
+    out++;
+  }
+  clear_slots();
+
+  auto collapsed = messages.size() - out;
+  messages.resize(out);
+  m_forwarded += out;
+  m_collapsed += collapsed;
+  return collapsed;
+}
+
+} // namespace sls3mcubridge
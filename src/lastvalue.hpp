@@ -0,0 +1,50 @@
+#pragma once
+
+#include "midimessage.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Drops intermediate values of continuous controls from a queue of pending
+// messages. Pitch bend (faders) and control change messages are keyed by
+// status byte and controller, only the newest pending value of a key is kept.
+// Every other message is a barrier: it is never dropped and a value is only
+// replaced by a newer one when no barrier was queued in between, so notes
+// (buttons, fader touch) keep their order relative to the control values.
+class LastValueFilter {
+public:
+  // With `relative_encoders` set, the Mackie V-pot and jog wheel controllers
+  // are treated as relative: pending ticks in the same direction are summed
+  // instead of replaced. Use it for mixer to DAW traffic.
+  explicit LastValueFilter(bool relative_encoders);
+
+  // Collapses `messages` in place and returns the number of dropped messages.
+  size_t collapse(std::vector<ShortMessage> &messages);
+
+  [[nodiscard]] uint64_t get_forwarded() const { return m_forwarded; }
+  [[nodiscard]] uint64_t get_collapsed() const { return m_collapsed; }
+
+private:
+  static const size_t NR_OF_CHANNELS = 16;
+  static const size_t NR_OF_CONTROLLERS = 128;
+  static const size_t NR_OF_KEYS =
+      NR_OF_CHANNELS + NR_OF_CHANNELS * NR_OF_CONTROLLERS;
+  static constexpr int32_t NO_SLOT = -1;
+
+  enum class Kind : uint8_t { Barrier, Absolute, Relative };
+  Kind classify(const ShortMessage &message, size_t &key) const;
+  void clear_slots();
+
+  bool m_relative_encoders;
+  // Position in the output of the pending value for every key.
+  std::array<int32_t, NR_OF_KEYS> m_slots{};
+  std::vector<size_t> m_used_keys;
+  uint64_t m_forwarded = 0;
+  uint64_t m_collapsed = 0;
+};
+
+} // namespace sls3mcubridge
@@ -0,0 +1,130 @@
+#include "latency.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sls3mcubridge {
+
+namespace {
+const double P50 = 0.5;
+const double P99 = 0.99;
+const double P999 = 0.999;
+
+const char *direction_name(LatencyMonitor::Direction direction) {
+  switch (direction) {
+  case LatencyMonitor::Direction::MixerToDaw:
+    return "mixer to DAW";
+  case LatencyMonitor::Direction::DawToMixer:
+  default:
+    return "DAW to mixer";
+  }
+}
+
+std::string to_microseconds(std::chrono::nanoseconds value) {
+  return std::to_string(
+             std::chrono::duration_cast<std::chrono::microseconds>(value)
+                 .count()) +
+         "us";
+}
+} // namespace
+
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+  // Values below two sub bucket ranges get a bucket each.
+  if (value < 2 * SUB_BUCKETS) {
+    return value;
+  }
+  auto shift = static_cast<unsigned int>(std::bit_width(value)) - 1 -
+               SUB_BUCKET_BITS;
+  return (shift * SUB_BUCKETS) + (value >> shift);
+}
+
+uint64_t LatencyHistogram::bucket_end(size_t index) {
+  if (index < 2 * SUB_BUCKETS) {
+    return index + 1;
+  }
+  auto shift = (index / SUB_BUCKETS) - 1;
+  auto mantissa = (index % SUB_BUCKETS) + SUB_BUCKETS;
+  return (mantissa + 1) << shift;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+  auto value = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+  m_buckets.at(bucket_index(value)).fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+
+  auto max = m_max.load(std::memory_order_relaxed);
+  while (value > max &&
+         !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(uint64_t count,
+                                                      double fraction) const {
+  auto target = static_cast<uint64_t>(
+      std::ceil(static_cast<double>(count) * fraction));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NR_OF_BUCKETS; i++) {
+    seen += m_buckets.at(i).load(std::memory_order_relaxed);
+    if (seen >= target) {
+      // Report the bucket's upper bound, but never more than the maximum.
+      auto value = std::min(bucket_end(i) - 1,
+                            m_max.load(std::memory_order_relaxed));
+      return std::chrono::nanoseconds(value);
+    }
+  }
+  return std::chrono::nanoseconds(m_max.load(std::memory_order_relaxed));
+}
+
+LatencyHistogram::Summary LatencyHistogram::summarize() const {
+  Summary summary;
+  summary.count = m_count.load(std::memory_order_relaxed);
+  if (summary.count == 0) {
+    return summary;
+  }
+  summary.p50 = percentile(summary.count, P50);
+  summary.p99 = percentile(summary.count, P99);
+  summary.p999 = percentile(summary.count, P999);
+  summary.max = std::chrono::nanoseconds(m_max.load(std::memory_order_relaxed));
+  return summary;
+}
+
+void LatencyMonitor::record(Direction direction, size_t device,
+                            std::chrono::nanoseconds latency) {
+  if (device >= NR_OF_DEVICES) {
+    return;
+  }
+  m_histograms.at(static_cast<size_t>(direction)).at(device).record(latency);
+}
+
+const LatencyHistogram &LatencyMonitor::get(Direction direction,
+                                            size_t device) const {
+  return m_histograms.at(static_cast<size_t>(direction)).at(device);
+}
+
+void LatencyMonitor::report() const {
+  for (auto direction : {Direction::MixerToDaw, Direction::DawToMixer}) {
+    for (size_t device = 0; device < NR_OF_DEVICES; device++) {
+      auto summary = get(direction, device).summarize();
+      if (summary.count == 0) {
+        continue;
+      }
+      spdlog::info("Latency " + std::string(direction_name(direction)) +
+                   " device " + std::to_string(device) + ": " +
+                   std::to_string(summary.count) + " samples, p50 " +
+                   to_microseconds(summary.p50) + ", p99 " +
+                   to_microseconds(summary.p99) + ", p99.9 " +
+                   to_microseconds(summary.p999) + ", max " +
+                   to_microseconds(summary.max));
+    }
+  }
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace sls3mcubridge {
+
+// Lock-free histogram of latencies in nanoseconds. Buckets are a power of two
+// wide split in 8 sub buckets, so a reported percentile is at most 12.5%
+// above the real value. record() may be called from any thread.
+class LatencyHistogram {
+public:
+  static const unsigned int SUB_BUCKET_BITS = 3;
+  static const size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+  // Enough buckets to hold any 64 bit value.
+  static const size_t NR_OF_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  struct Summary {
+    uint64_t count = 0;
+    std::chrono::nanoseconds p50{0};
+    std::chrono::nanoseconds p99{0};
+    std::chrono::nanoseconds p999{0};
+    std::chrono::nanoseconds max{0};
+  };
+
+  void record(std::chrono::nanoseconds latency);
+  [[nodiscard]] Summary summarize() const;
+
+  static size_t bucket_index(uint64_t value);
+  // Smallest value that no longer fits in the bucket.
+  static uint64_t bucket_end(size_t index);
+
+private:
+  [[nodiscard]] std::chrono::nanoseconds percentile(uint64_t count,
+                                                    double fraction) const;
+
+  std::array<std::atomic<uint64_t>, NR_OF_BUCKETS> m_buckets{};
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_max{0};
+};
+
+// Latency histograms of the bridge, per direction and per midi device.
+class LatencyMonitor {
+public:
+  enum class Direction : uint8_t {
+    // Socket receive until the midi message is sent to the DAW.
+    MixerToDaw,
+    // Midi message received until the socket write completed.
+    DawToMixer,
+  };
+  static const size_t NR_OF_DEVICES = 5;
+
+  // Samples of an unknown device are ignored.
+  void record(Direction direction, size_t device,
+              std::chrono::nanoseconds latency);
+  [[nodiscard]] const LatencyHistogram &get(Direction direction,
+                                            size_t device) const;
+  // Logs a summary of every histogram that has samples.
+  void report() const;
+
+private:
+  std::array<std::array<LatencyHistogram, NR_OF_DEVICES>, 2> m_histograms;
+};
+
+} // namespace sls3mcubridge
@@ -0,0 +1,58 @@
+#include "lowlatency.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+
+namespace sls3mcubridge {
+
+namespace {
+const int ENABLED = 1;
+
+bool set_option(int fd, int level, int option, int value,
+                const std::string &name) {
+  if (setsockopt(fd, level, option, &value, sizeof(value)) != 0) {
+    spdlog::warn("Low latency: failed to set " + name + ": " +
+                 std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+bool apply_low_latency(int fd, const LowLatencyConfig &config) {
+  bool succeeded = set_option(fd, IPPROTO_TCP, TCP_NODELAY, ENABLED,
+                              "TCP_NODELAY");
+  succeeded &= set_option(fd, IPPROTO_TCP, TCP_QUICKACK, ENABLED,
+                          "TCP_QUICKACK");
+  if (config.busy_poll.count() > 0) {
+    succeeded &=
+        set_option(fd, SOL_SOCKET, SO_BUSY_POLL,
+                   static_cast<int>(config.busy_poll.count()), "SO_BUSY_POLL");
+  }
+  if (config.send_buffer > 0) {
+    succeeded &=
+        set_option(fd, SOL_SOCKET, SO_SNDBUF, config.send_buffer, "SO_SNDBUF");
+  }
+  if (config.receive_buffer > 0) {
+    succeeded &= set_option(fd, SOL_SOCKET, SO_RCVBUF, config.receive_buffer,
+                            "SO_RCVBUF");
+  }
+  if (succeeded) {
+    spdlog::info("Low latency: socket options set");
+  }
+  return succeeded;
+}
+
+void rearm_quickack(int fd) {
+  int value = ENABLED;
+  // Only fails for a closed socket, whose read fails as well.
+  setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value));
+}
+
+} // namespace sls3mcubridge
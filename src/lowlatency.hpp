@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+
+namespace sls3mcubridge {
+
+// Socket options of the mixer connection that trade CPU time for latency.
+struct LowLatencyConfig {
+  // SO_BUSY_POLL, how long a read polls the device queue of the network card
+  // before sleeping. Zero leaves it off.
+  std::chrono::microseconds busy_poll{50};
+  // SO_SNDBUF and SO_RCVBUF in bytes, zero keeps the kernel autotuning. The
+  // mixer traffic never comes near 64 KiB in flight.
+  int send_buffer = 64 * 1024;
+  int receive_buffer = 64 * 1024;
+  // How long the client keeps polling the socket after each read before it
+  // hands the read to the reactor. Every poll is posted to the executor, so
+  // other work on the thread runs in between. Zero always waits.
+  std::chrono::microseconds spin_read{0};
+};
+
+// Sets TCP_NODELAY, TCP_QUICKACK, SO_BUSY_POLL and the buffer sizes of the
+// connected TCP socket `fd`. Every option that can not be set is logged and
+// makes it return false, the connection works without it. SO_BUSY_POLL above
+// net.core.busy_read needs CAP_NET_ADMIN.
+bool apply_low_latency(int fd, const LowLatencyConfig &config);
+// The kernel drops TCP_QUICKACK again when it sees fit, so it is set after
+// every read.
+void rearm_quickack(int fd);
+
+} // namespace sls3mcubridge
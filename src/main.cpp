@@ -1,15 +1,105 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
 #include <cstdlib>
 #include <exception>
+#include <filesystem>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "asio/awaitable.hpp"
+#include "asio/co_spawn.hpp"
 #include "asio/io_context.hpp"
+#include "asio/post.hpp"
+#include "asio/signal_set.hpp"
+#include "asio/strand.hpp"
 #include "cxxopts.hpp"
+#include "libremidi/message.hpp"
 #include "spdlog/spdlog.h"
 
 #include "bridge.hpp"
+#include "client.hpp"
+#include "realtime.hpp"
+#include "replay.hpp"
+#include "trace.hpp"
 
 const int PORT = 53000;
+// Heap kept resident in realtime mode.
+const size_t PREFAULT_HEAP_SIZE = 16 * 1024 * 1024;
+
+namespace {
+using Bridges = std::vector<std::shared_ptr<sls3mcubridge::Bridge>>;
+
+// SIGUSR1 logs the latency histograms, SIGUSR2 exports the metrics, of every
+// bridge on its own executor. SIGUSR1 also dumps the trace.
+void report_on_signal(asio::signal_set &signals, const Bridges &bridges) {
+  signals.async_wait([&signals, &bridges](const asio::error_code &error,
+                                          int signal_number) {
+    if (!error) {
+      if (signal_number == SIGUSR1) {
+        sls3mcubridge::dump_trace();
+      }
+      for (const auto &bridge : bridges) {
+        asio::post(bridge->get_executor(), [bridge, signal_number]() {
+          if (signal_number == SIGUSR2) {
+            bridge->export_metrics();
+          } else {
+            bridge->report_latency();
+          }
+        });
+      }
+      report_on_signal(signals, bridges);
+    }
+  });
+}
+
+// Inserts `name` before the extension, "metrics.prom" becomes
+// "metrics_<name>.prom".
+std::string namespaced(const std::string &path, const std::string &name) {
+  if (path.empty()) {
+    return path;
+  }
+  std::filesystem::path file(path);
+  return (file.parent_path() /
+          (file.stem().string() + "_" + name + file.extension().string()))
+      .string();
+}
+
+// An exception escaping a handler only ends that handler, the bridges of the
+// other mixers keep running.
+void run(asio::io_context &io_context,
+         const std::optional<sls3mcubridge::RealtimeConfig> &realtime,
+         const std::string &thread) {
+  if (realtime) {
+    sls3mcubridge::make_thread_realtime(*realtime, thread);
+    sls3mcubridge::prefault_stack();
+  }
+  while (true) {
+    try {
+      io_context.run();
+      return;
+    } catch (std::exception &exc) {
+      spdlog::error("Issue occured with async runner: " +
+                    std::string(exc.what()));
+    }
+  }
+}
+
+// The replay starts once the bridge created its midi devices.
+asio::awaitable<void>
+start_bridge(std::shared_ptr<sls3mcubridge::Bridge> bridge,
+             std::shared_ptr<sls3mcubridge::Replay> replay) {
+  co_await bridge->start();
+  if (replay) {
+    replay->start();
+  }
+}
+} // namespace
 
 int main(int argc, char **argv) {
 
@@ -20,12 +110,84 @@ int main(int argc, char **argv) {
   cxxopts::ParseResult parse_result;
 
   try {
-    options.add_options()("host",
-                          "hostname or ip-address of the mixer to connect to.",
-                          cxxopts::value<std::string>())(
-        "v,verbose", "info level logging.", cxxopts::value<bool>());
+    options.add_options()(
+        "host",
+        "hostname or ip-address of the mixer to connect to, several mixers "
+        "are bridged by one process.",
+        cxxopts::value<std::vector<std::string>>())(
+        "v,verbose", "info level logging.", cxxopts::value<bool>())(
+        "coalesce-window",
+        "microseconds DAW messages may be held back to be sent together with "
+        "following messages.",
+        cxxopts::value<int>()->default_value("0"))(
+        "collapse-continuous",
+        "only forward the newest pending value of faders and other "
+        "continuous controls.",
+        cxxopts::value<bool>())(
+        "meter-interval",
+        "milliseconds between meter updates sent to the mixer, only the "
+        "highest level of each strip is sent. 0 sends every update.",
+        cxxopts::value<int>()->default_value("0"))(
+        "compress-lcd",
+        "only send the LCD characters that differ from what the mixer "
+        "shows.",
+        cxxopts::value<bool>())(
+        "capture", "record all mixer and DAW traffic to this file.",
+        cxxopts::value<std::string>())(
+        "replay",
+        "feed the traffic recorded in this file through the bridge.",
+        cxxopts::value<std::string>())(
+        "replay-speed",
+        "replay speed relative to the recording, 0 replays as fast as "
+        "possible.",
+        cxxopts::value<double>()->default_value("1"))(
+        "latency-report",
+        "log latency percentiles every this many seconds, 0 only logs them "
+        "on SIGUSR1.",
+        cxxopts::value<int>()->default_value("0"))(
+        "trace",
+        "record the recent messages of every stage in memory and write them "
+        "to this file on SIGUSR1 or a crash.",
+        cxxopts::value<std::string>())(
+        "metrics-file",
+        "write a Prometheus text snapshot of the metrics to this file on "
+        "SIGUSR2.",
+        cxxopts::value<std::string>())(
+        "metrics-socket",
+        "serve a Prometheus text snapshot of the metrics to every connection "
+        "on this Unix socket.",
+        cxxopts::value<std::string>())(
+        "buffer-while-disconnected",
+        "hold DAW messages while reconnecting to the mixer and send them once "
+        "connected, instead of dropping them.",
+        cxxopts::value<bool>())(
+        "threads", "threads handling the traffic of all mixers.",
+        cxxopts::value<int>()->default_value("1"))(
+        "realtime",
+        "run the traffic handling and midi input threads with SCHED_FIFO, "
+        "lock the memory of the process and prefault it.",
+        cxxopts::value<bool>())(
+        "realtime-priority", "SCHED_FIFO priority of the realtime threads.",
+        cxxopts::value<int>()->default_value("70"))(
+        "cpus", "comma separated CPUs the realtime threads are pinned to.",
+        cxxopts::value<std::vector<int>>())(
+        "low-latency",
+        "set TCP_NODELAY, TCP_QUICKACK, SO_BUSY_POLL and fixed buffer sizes "
+        "on the mixer connection.",
+        cxxopts::value<bool>())(
+        "busy-poll",
+        "microseconds of SO_BUSY_POLL in low latency mode, 0 for off.",
+        cxxopts::value<int>()->default_value("50"))(
+        "socket-buffer",
+        "send and receive buffer bytes in low latency mode, 0 keeps the "
+        "kernel autotuning.",
+        cxxopts::value<int>()->default_value("65536"))(
+        "spin-read",
+        "microseconds to keep reading without waiting after each read in low "
+        "latency mode, 0 for off.",
+        cxxopts::value<int>()->default_value("0"));
     options.parse_positional({"host"});
-    options.positional_help("host");
+    options.positional_help("host...");
     parse_result = options.parse(argc, argv);
   } catch (const std::exception &exc) {
     std::cout << exc.what() << "\n" << "\n";
@@ -38,6 +200,18 @@ int main(int argc, char **argv) {
     std::cout << options.help() << "\n";
     return -1;
   }
+  auto hosts = parse_result["host"].as<std::vector<std::string>>();
+  if (hosts.size() > 1 && parse_result["replay"].count() > 0) {
+    std::cout << "replay needs a single host." << "\n" << "\n";
+    std::cout << options.help() << "\n";
+    return -1;
+  }
+  auto nr_threads = parse_result["threads"].as<int>();
+  if (nr_threads < 1) {
+    std::cout << "threads has to be at least 1." << "\n" << "\n";
+    std::cout << options.help() << "\n";
+    return -1;
+  }
 
   spdlog::set_level(spdlog::level::info);
   if (parse_result["verbose"].count() > 0) {
@@ -46,24 +220,137 @@ int main(int argc, char **argv) {
     }
   }
 
+  sls3mcubridge::BridgeConfig config;
+  config.coalesce_window =
+      std::chrono::microseconds(parse_result["coalesce-window"].as<int>());
+  config.collapse_continuous =
+      parse_result["collapse-continuous"].count() > 0 &&
+      parse_result["collapse-continuous"].as<bool>();
+  config.meter_interval =
+      std::chrono::milliseconds(parse_result["meter-interval"].as<int>());
+  config.compress_lcd = parse_result["compress-lcd"].count() > 0 &&
+                        parse_result["compress-lcd"].as<bool>();
+  if (parse_result["capture"].count() > 0) {
+    config.capture_file = parse_result["capture"].as<std::string>();
+  }
+  config.latency_report_interval =
+      std::chrono::seconds(parse_result["latency-report"].as<int>());
+  if (parse_result["metrics-file"].count() > 0) {
+    config.metrics_file = parse_result["metrics-file"].as<std::string>();
+  }
+  if (parse_result["metrics-socket"].count() > 0) {
+    config.metrics_socket = parse_result["metrics-socket"].as<std::string>();
+  }
+  config.buffer_while_disconnected =
+      parse_result["buffer-while-disconnected"].count() > 0 &&
+      parse_result["buffer-while-disconnected"].as<bool>();
+  if (parse_result["realtime"].count() > 0 &&
+      parse_result["realtime"].as<bool>()) {
+    config.realtime.emplace();
+    config.realtime->priority = parse_result["realtime-priority"].as<int>();
+    if (parse_result["cpus"].count() > 0) {
+      config.realtime->cpus = parse_result["cpus"].as<std::vector<int>>();
+    }
+  }
+  if (parse_result["low-latency"].count() > 0 &&
+      parse_result["low-latency"].as<bool>()) {
+    config.low_latency.emplace();
+    config.low_latency->busy_poll =
+        std::chrono::microseconds(parse_result["busy-poll"].as<int>());
+    config.low_latency->send_buffer = parse_result["socket-buffer"].as<int>();
+    config.low_latency->receive_buffer =
+        parse_result["socket-buffer"].as<int>();
+    config.low_latency->spin_read =
+        std::chrono::microseconds(parse_result["spin-read"].as<int>());
+  }
+
+  spdlog::info("Socket backend: " + std::string(sls3mcubridge::io_backend()));
   asio::io_context io_context;
+  Bridges bridges;
+  asio::signal_set report_signals(io_context, SIGUSR1, SIGUSR2);
+
+  // The process only fails when no mixer could be bridged.
+  std::atomic<size_t> nr_failed = 0;
 
   try {
-    // TODO(ruud): remove the use of shared pointer if possible. Currently it is
-    // needed to support shared_from_this inside the Bridge class
-    auto bridge = std::make_shared<sls3mcubridge::Bridge>(
-        io_context, parse_result["host"].as<std::string>(), PORT);
-    bridge->start();
+    if (parse_result["trace"].count() > 0) {
+      sls3mcubridge::enable_tracing(parse_result["trace"].as<std::string>());
+      sls3mcubridge::dump_trace_on_crash();
+    }
+    for (const auto &host : hosts) {
+      auto bridge_config = config;
+      if (hosts.size() > 1) {
+        bridge_config.midi_port_prefix += host + "_";
+        bridge_config.capture_file = namespaced(config.capture_file, host);
+        bridge_config.metrics_file = namespaced(config.metrics_file, host);
+        bridge_config.metrics_socket = namespaced(config.metrics_socket, host);
+      }
+      // TODO(ruud): remove the use of shared pointer if possible. Currently it
+      // is needed to support shared_from_this inside the Bridge class
+      bridges.push_back(std::make_shared<sls3mcubridge::Bridge>(
+          asio::make_strand(io_context), host, PORT, bridge_config));
+    }
+    report_on_signal(report_signals, bridges);
+
+    std::shared_ptr<sls3mcubridge::Replay> replay;
+    if (parse_result["replay"].count() > 0) {
+      auto bridge = bridges.front();
+      replay = std::make_shared<sls3mcubridge::Replay>(
+          bridge->get_executor(), parse_result["replay"].as<std::string>(),
+          parse_result["replay-speed"].as<double>(),
+          [bridge](sls3mcubridge::tcp::PackageView &package) {
+            bridge->handle_tcp_read(package);
+          },
+          [bridge](int device_index, const libremidi::message &message) {
+            bridge->handle_midi_read(device_index, message);
+          });
+    }
+
+    for (size_t i = 0; i < bridges.size(); i++) {
+      auto on_started = [&io_context, &nr_failed, bridge = bridges.at(i),
+                         host = hosts.at(i),
+                         nr_bridges = bridges.size()](
+                            const std::exception_ptr &error) {
+        if (!error) {
+          return;
+        }
+        try {
+          std::rethrow_exception(error);
+        } catch (std::exception &exc) {
+          spdlog::error("Failed to start bridge to " + host + ": " +
+                        std::string(exc.what()));
+        }
+        bridge->stop();
+        if (nr_failed.fetch_add(1) + 1 == nr_bridges) {
+          spdlog::error("No mixer bridged, exiting");
+          io_context.stop();
+        }
+      };
+      asio::co_spawn(bridges.at(i)->get_executor(),
+                     start_bridge(bridges.at(i), replay), on_started);
+    }
   } catch (std::exception &exc) {
     spdlog::error("Failed to start bridge, exiting: " +
                   std::string(exc.what()));
     return -1;
   }
 
-  try {
-    io_context.run();
-  } catch (std::exception &exc) {
-    spdlog::error("Issue occured with async runner: " +
-                  std::string(exc.what()));
+  // Pages mapped later on, like those of the midi devices created during the
+  // handshake, are locked as they are mapped.
+  if (config.realtime) {
+    sls3mcubridge::lock_memory();
+    sls3mcubridge::prefault_heap(PREFAULT_HEAP_SIZE);
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < nr_threads; i++) {
+    threads.emplace_back([&io_context, &config, i]() {
+      run(io_context, config.realtime, "io thread " + std::to_string(i));
+    });
+  }
+  run(io_context, config.realtime, "io thread 0");
+  for (auto &thread : threads) {
+    thread.join();
   }
-}
\ No newline at end of file
+  return nr_failed == bridges.size() ? -1 : 0;
+}
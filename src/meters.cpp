@@ -0,0 +1,125 @@
+#include "meters.hpp"
+
+#include "coalescer.hpp"
+#include "metrics.hpp"
+#include "midimessage.hpp"
+#include "writebatch.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/post.hpp"
+#include "spdlog/spdlog.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <utility>
+
+namespace sls3mcubridge {
+
+const size_t METER_MESSAGE_SIZE = 2;
+// Channel pressure on the first channel.
+const uint8_t METER_STATUS = CHANNEL_PRESSURE;
+const uint8_t STRIP_SHIFT = 4;
+const uint8_t STRIP_MASK = 0x07;
+const uint8_t LEVEL_MASK = 0x0f;
+// Levels 0x0 to 0xc are meter levels, 0xe sets and 0xf clears the overload
+// indicator.
+const uint8_t MAX_LEVEL = 0x0c;
+
+MeterDecimator::MeterDecimator(const asio::any_io_executor &executor,
+                               std::byte device,
+                               std::chrono::milliseconds interval,
+                               MidiCoalescer::Sink sink)
+    : m_executor(executor), m_timer(executor), m_device(device),
+      m_interval(interval), m_sink(std::move(sink)) {
+  for (size_t i = 0; i < NR_OF_STRIPS; i++) {
+    m_levels.at(i).store(NONE, std::memory_order_relaxed);
+    m_overloads.at(i).store(NONE, std::memory_order_relaxed);
+  }
+}
+
+bool MeterDecimator::push(const ShortMessage &message) {
+  if (message.size() != METER_MESSAGE_SIZE || message[0] != METER_STATUS) {
+    return false;
+  }
+  auto strip = static_cast<size_t>((message[1] >> STRIP_SHIFT) & STRIP_MASK);
+  auto level = static_cast<uint8_t>(message[1] & LEVEL_MASK);
+  if (level <= MAX_LEVEL) {
+    keep(m_levels.at(strip), level, true);
+  } else {
+    keep(m_overloads.at(strip), level, false);
+  }
+
+  // Pairs with the fence in refresh(), see MidiCoalescer::enqueue().
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_refresh_scheduled.exchange(true, std::memory_order_acq_rel)) {
+    return true;
+  }
+  asio::post(m_executor,
+             [self = shared_from_this()]() { self->schedule_refresh(); });
+  return true;
+}
+
+void MeterDecimator::keep(std::atomic<uint8_t> &pending, uint8_t value,
+                          bool highest) {
+  auto previous = pending.load(std::memory_order_relaxed);
+  do {
+    if (highest && previous != NONE && previous >= value) {
+      break;
+    }
+  } while (!pending.compare_exchange_weak(previous, value,
+                                          std::memory_order_relaxed));
+  if (previous != NONE && m_metrics) {
+    m_metrics->count(Metrics::Event::DecimatedMeter);
+  }
+}
+
+void MeterDecimator::schedule_refresh() {
+  auto due = m_last_refresh + m_interval;
+  if (std::chrono::steady_clock::now() >= due) {
+    refresh();
+    return;
+  }
+  m_timer.expires_at(due);
+  m_timer.async_wait(
+      [self = shared_from_this()](const asio::error_code &error) {
+        if (!error) {
+          self->refresh();
+        }
+      });
+}
+
+void MeterDecimator::refresh() {
+  // Cleared before taking the levels, a level pushed in the meantime either
+  // is taken now or schedules the next refresh.
+  m_refresh_scheduled.store(false, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  m_last_refresh = std::chrono::steady_clock::now();
+
+  for (size_t strip = 0; strip < NR_OF_STRIPS; strip++) {
+    for (auto *pending : {&m_levels.at(strip), &m_overloads.at(strip)}) {
+      auto value = pending->exchange(NONE, std::memory_order_relaxed);
+      if (value != NONE) {
+        auto data = static_cast<uint8_t>((strip << STRIP_SHIFT) | value);
+        m_refreshing.push_back(ShortMessage({METER_STATUS, data}));
+      }
+    }
+  }
+
+  try {
+    m_batch.clear();
+    MidiCoalescer::encode(m_device, m_refreshing, m_batch, m_sink,
+                          m_metrics.get());
+    if (!m_batch.empty()) {
+      m_sink(m_batch);
+    }
+  } catch (const std::exception &exc) {
+    spdlog::warn("Failed to send meters: " + std::string(exc.what()));
+  }
+  m_refreshing.clear();
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "coalescer.hpp"
+#include "metrics.hpp"
+#include "midimessage.hpp"
+#include "writebatch.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/steady_timer.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace sls3mcubridge {
+
+// Thins out the Mackie meter messages (channel pressure, strip in the high
+// nibble, level in the low nibble) the DAW sends to one midi device. Only the
+// highest level of a strip since the last refresh is sent, at most once per
+// `interval`, the surface lets its meters fall on its own. Overload set and
+// clear are kept as well, the newest one wins. All strips of a refresh go out
+// in one write, each meter in a body of its own as the mixer reads multi
+// message bodies in three byte slots.
+class MeterDecimator : public std::enable_shared_from_this<MeterDecimator> {
+public:
+  static constexpr size_t NR_OF_STRIPS = 8;
+
+  MeterDecimator(const asio::any_io_executor &executor, std::byte device,
+                 std::chrono::milliseconds interval, MidiCoalescer::Sink sink);
+
+  // Takes a meter message for the next refresh and returns true, returns false
+  // for every other message. May be called from any thread and never blocks.
+  bool push(const ShortMessage &message);
+
+  // Counts the meter messages left out from now on.
+  void set_metrics(std::shared_ptr<Metrics> metrics) {
+    m_metrics = std::move(metrics);
+  }
+
+private:
+  // No pending level or overload command of a strip.
+  static constexpr uint8_t NONE = 0xff;
+
+  void schedule_refresh();
+  void refresh();
+  void keep(std::atomic<uint8_t> &pending, uint8_t value, bool highest);
+
+  asio::any_io_executor m_executor;
+  asio::steady_timer m_timer;
+  std::byte m_device;
+  std::chrono::milliseconds m_interval;
+  MidiCoalescer::Sink m_sink;
+  std::shared_ptr<Metrics> m_metrics;
+
+  std::array<std::atomic<uint8_t>, NR_OF_STRIPS> m_levels;
+  std::array<std::atomic<uint8_t>, NR_OF_STRIPS> m_overloads;
+  std::atomic<bool> m_refresh_scheduled = false;
+
+  // Only used on the executor.
+  std::chrono::steady_clock::time_point m_last_refresh;
+  MessageRun m_refreshing;
+  WriteBatch m_batch{MAX_SEGMENT_SIZE};
+};
+
+} // namespace sls3mcubridge
@@ -0,0 +1,291 @@
+#include "metrics.hpp"
+
+#include "package.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/buffer.hpp"
+#include "asio/error.hpp"
+#include "asio/local/stream_protocol.hpp"
+#include "asio/write.hpp"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace sls3mcubridge {
+
+namespace {
+// Wait before accepting again after a failed accept, e.g. when the process is
+// out of file descriptors.
+const std::chrono::milliseconds ACCEPT_RETRY_DELAY(100);
+
+const std::array<std::string_view, Metrics::NR_OF_DIRECTIONS>
+    DIRECTION_LABELS = {"mixer_to_daw", "daw_to_mixer"};
+
+// Ordered like tcp::Body::Type.
+const std::array<std::string_view, Metrics::NR_OF_BODY_TYPES> BODY_TYPE_LABELS =
+    {"unknown", "initial_response", "incomming_midi", "outgoing_midi",
+     "sysex"};
+
+struct EventInfo {
+  std::string_view name;
+  std::string_view help;
+};
+
+// Ordered like Metrics::Event.
+const std::array<EventInfo, Metrics::NR_OF_EVENTS> EVENTS = {{
+    {"sls3_parse_failures_total",
+     "Packages from the mixer that could not be parsed or handled."},
+    {"sls3_unknown_bodies_total", "Packages with an unknown body type."},
+    {"sls3_unsupported_midi_total",
+     "Midi messages from the DAW of an unsupported type."},
+    {"sls3_dropped_midi_total",
+     "Midi messages from the DAW dropped on a full queue."},
+    {"sls3_dropped_tcp_writes_total",
+     "Writes to the mixer dropped on a full write queue."},
+    {"sls3_dropped_disconnected_total",
+     "Writes to the mixer dropped while disconnected from the mixer."},
+    {"sls3_reconnects_total", "Successful reconnects to the mixer."},
+    {"sls3_decimated_meters_total",
+     "Meter messages from the DAW replaced by a higher or newer one before "
+     "being sent."},
+    {"sls3_fragmented_sysex_total",
+     "SysEx messages from the DAW split over several packages."},
+    {"sls3_assembled_sysex_total",
+     "SysEx messages from the mixer joined from several packages."},
+    {"sls3_resyncs_total",
+     "Times the stream from the mixer was corrupt and scanned for the next "
+     "header."},
+}};
+
+void write_header(std::ostream &output, std::string_view name,
+                  std::string_view help, std::string_view type) {
+  output << "# HELP " << name << " " << help << "\n";
+  output << "# TYPE " << name << " " << type << "\n";
+}
+
+template <size_t N>
+void write_by_direction(
+    std::ostream &output, std::string_view name, std::string_view help,
+    std::string_view label,
+    const std::array<std::array<MetricCounter, N>, Metrics::NR_OF_DIRECTIONS>
+        &counters,
+    const std::function<std::string(size_t)> &label_value) {
+  write_header(output, name, help, "counter");
+  for (size_t direction = 0; direction < counters.size(); direction++) {
+    for (size_t i = 0; i < N; i++) {
+      output << name << "{direction=\"" << DIRECTION_LABELS.at(direction)
+             << "\"," << label << "=\"" << label_value(i) << "\"} "
+             << counters.at(direction).at(i).get() << "\n";
+    }
+  }
+}
+} // namespace
+
+void Metrics::count_tcp(Direction direction, size_t bytes) {
+  m_tcp_bytes.at(static_cast<size_t>(direction)).add(bytes);
+}
+
+void Metrics::count_frame(Direction direction, tcp::Body::Type type,
+                          size_t bytes) {
+  auto index = static_cast<size_t>(type);
+  if (index >= NR_OF_BODY_TYPES) {
+    index = tcp::Body::Type::Unkown;
+  }
+  m_frames.at(static_cast<size_t>(direction)).at(index).add(1);
+  m_frame_bytes.at(static_cast<size_t>(direction)).at(index).add(bytes);
+}
+
+void Metrics::count_midi(Direction direction, size_t device, size_t bytes) {
+  if (device >= NR_OF_DEVICES) {
+    return;
+  }
+  m_midi_messages.at(static_cast<size_t>(direction)).at(device).add(1);
+  m_midi_bytes.at(static_cast<size_t>(direction)).at(device).add(bytes);
+}
+
+void Metrics::count_lcd_saved(size_t device, size_t bytes) {
+  if (device >= NR_OF_DEVICES) {
+    return;
+  }
+  m_lcd_bytes_saved.at(device).add(bytes);
+}
+
+void Metrics::count_skipped(size_t bytes) { m_skipped_bytes.add(bytes); }
+
+void Metrics::count(Event event) {
+  m_events.at(static_cast<size_t>(event)).add(1);
+}
+
+void Metrics::add_callback(Callback callback) {
+  // Keeps the callbacks of one metric next to each other, devices created
+  // later add to metrics registered before.
+  auto last = std::find_if(
+      m_callbacks.rbegin(), m_callbacks.rend(),
+      [&callback](const Callback &iter) { return iter.name == callback.name; });
+  m_callbacks.insert(last == m_callbacks.rend() ? m_callbacks.end()
+                                                : last.base(),
+                     std::move(callback));
+}
+
+void Metrics::write_prometheus(std::ostream &output) const {
+  write_header(output, "sls3_tcp_bytes_total",
+               "Bytes read from and written to the mixer.", "counter");
+  for (size_t direction = 0; direction < NR_OF_DIRECTIONS; direction++) {
+    output << "sls3_tcp_bytes_total{direction=\""
+           << DIRECTION_LABELS.at(direction) << "\"} "
+           << m_tcp_bytes.at(direction).get() << "\n";
+  }
+
+  auto body_type = [](size_t index) {
+    return std::string(BODY_TYPE_LABELS.at(index));
+  };
+  write_by_direction(output, "sls3_frames_total",
+                     "Packages exchanged with the mixer.", "type", m_frames,
+                     body_type);
+  write_by_direction(output, "sls3_frame_bytes_total",
+                     "Bytes of the packages exchanged with the mixer.", "type",
+                     m_frame_bytes, body_type);
+
+  auto device = [](size_t index) { return std::to_string(index); };
+  write_by_direction(output, "sls3_midi_messages_total",
+                     "Midi messages per device.", "device", m_midi_messages,
+                     device);
+  write_by_direction(output, "sls3_midi_bytes_total",
+                     "Bytes of the midi messages per device.", "device",
+                     m_midi_bytes, device);
+
+  write_header(output, "sls3_lcd_bytes_saved_total",
+               "Bytes of LCD updates to the mixer left out because the "
+               "characters were already shown.",
+               "counter");
+  for (size_t i = 0; i < NR_OF_DEVICES; i++) {
+    output << "sls3_lcd_bytes_saved_total{device=\"" << i << "\"} "
+           << m_lcd_bytes_saved.at(i).get() << "\n";
+  }
+
+  write_header(output, "sls3_skipped_bytes_total",
+               "Corrupt bytes from the mixer skipped to find the next header.",
+               "counter");
+  output << "sls3_skipped_bytes_total " << m_skipped_bytes.get() << "\n";
+
+  for (size_t i = 0; i < NR_OF_EVENTS; i++) {
+    write_header(output, EVENTS.at(i).name, EVENTS.at(i).help, "counter");
+    output << EVENTS.at(i).name << " " << m_events.at(i).get() << "\n";
+  }
+
+  std::string_view previous_name;
+  for (const auto &callback : m_callbacks) {
+    // Callbacks of one metric are registered after each other.
+    if (callback.name != previous_name) {
+      write_header(output, callback.name, callback.help, callback.type);
+      previous_name = callback.name;
+    }
+    output << callback.name;
+    if (!callback.labels.empty()) {
+      output << "{" << callback.labels << "}";
+    }
+    output << " " << callback.read() << "\n";
+  }
+}
+
+void Metrics::write_file(const std::string &path) const {
+  auto temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("Could not open metrics file " + temporary);
+    }
+    write_prometheus(file);
+  }
+  std::filesystem::rename(temporary, path);
+}
+
+MetricsServer::MetricsServer(const asio::any_io_executor &executor,
+                             const std::string &path,
+                             std::shared_ptr<const Metrics> metrics)
+    : m_path(path), m_acceptor(executor), m_retry_timer(executor),
+      m_metrics(std::move(metrics)) {
+  // A socket file left behind by a previous run blocks the bind.
+  std::filesystem::remove(path);
+  auto endpoint = asio::local::stream_protocol::endpoint(path);
+  m_acceptor.open(endpoint.protocol());
+  m_acceptor.bind(endpoint);
+  m_acceptor.listen();
+  spdlog::info("Serving metrics on " + path);
+}
+
+void MetricsServer::start() { accept(); }
+
+void MetricsServer::stop() {
+  asio::error_code error;
+  m_acceptor.close(error);
+  m_retry_timer.cancel();
+}
+
+void MetricsServer::accept() {
+  m_acceptor.async_accept([self = shared_from_this()](
+                              const asio::error_code &error,
+                              asio::local::stream_protocol::socket socket) {
+    if (error) {
+      self->handle_accept_error(error);
+      return;
+    }
+    if (self->m_failing) {
+      spdlog::info("Accepting metrics connections again");
+      self->m_failing = false;
+    }
+    {
+      std::ostringstream snapshot;
+      self->m_metrics->write_prometheus(snapshot);
+      auto connection = std::make_shared<asio::local::stream_protocol::socket>(
+          std::move(socket));
+      auto text = std::make_shared<std::string>(snapshot.str());
+      asio::async_write(
+          *connection, asio::buffer(*text),
+          [connection, text](const asio::error_code &write_error,
+                             size_t /*bytes_transferred*/) {
+            if (write_error) {
+              spdlog::warn("Failed to send metrics: " + write_error.message());
+            }
+          });
+    }
+    self->accept();
+  });
+}
+
+void MetricsServer::handle_accept_error(const asio::error_code &error) {
+  if (error == asio::error::operation_aborted) {
+    return;
+  }
+  if (!m_failing) {
+    spdlog::warn("Failed to accept a metrics connection: " + error.message() +
+                 ", retrying every " +
+                 std::to_string(ACCEPT_RETRY_DELAY.count()) + " ms");
+    m_failing = true;
+  }
+  // Accepting right away fails again as long as the cause lasts, e.g.
+  // EMFILE, and would spin the executor.
+  m_retry_timer.expires_after(ACCEPT_RETRY_DELAY);
+  m_retry_timer.async_wait(
+      [self = shared_from_this()](const asio::error_code &timer_error) {
+        if (!timer_error) {
+          self->accept();
+        }
+      });
+}
+
+} // namespace sls3mcubridge
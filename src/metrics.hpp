@@ -0,0 +1,128 @@
+#pragma once
+
+#include "mpscqueue.hpp"
+#include "package.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/local/stream_protocol.hpp"
+#include "asio/steady_timer.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Counter on its own cache line, so threads counting different things never
+// share a line.
+class alignas(CACHE_LINE_SIZE) MetricCounter {
+public:
+  void add(uint64_t value) {
+    m_value.fetch_add(value, std::memory_order_relaxed);
+  }
+  [[nodiscard]] uint64_t get() const {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint64_t> m_value{0};
+};
+
+// Runtime counters of the bridge. Counting is lock-free and may happen on any
+// thread, a snapshot is written in the Prometheus text format.
+class Metrics {
+public:
+  enum class Direction : uint8_t { MixerToDaw, DawToMixer };
+  enum class Event : uint8_t {
+    ParseFailure,
+    UnknownBody,
+    UnsupportedMidi,
+    DroppedMidi,
+    DroppedTcpWrite,
+    DroppedDisconnected,
+    Reconnect,
+    DecimatedMeter,
+    FragmentedSysEx,
+    AssembledSysEx,
+    Resync,
+  };
+  static const size_t NR_OF_DIRECTIONS = 2;
+  static const size_t NR_OF_DEVICES = 5;
+  static const size_t NR_OF_BODY_TYPES = 5;
+  static const size_t NR_OF_EVENTS = 11;
+
+  // Value read when a snapshot is written. Registered and called on the
+  // thread writing the snapshots.
+  struct Callback {
+    std::string name;
+    std::string help;
+    // "counter" or "gauge".
+    std::string type;
+    // Prometheus labels without braces, e.g. device="0".
+    std::string labels;
+    std::function<uint64_t()> read;
+  };
+
+  // Bytes read from or written to the mixer connection.
+  void count_tcp(Direction direction, size_t bytes);
+  // A package of the given body type and size.
+  void count_frame(Direction direction, tcp::Body::Type type, size_t bytes);
+  // A midi message of a device, unknown devices are ignored.
+  void count_midi(Direction direction, size_t device, size_t bytes);
+  // Package bytes of LCD updates to the mixer left out by comparing them with
+  // the characters already shown, unknown devices are ignored.
+  void count_lcd_saved(size_t device, size_t bytes);
+  // Corrupt bytes from the mixer skipped to find the next header.
+  void count_skipped(size_t bytes);
+  void count(Event event);
+
+  void add_callback(Callback callback);
+
+  void write_prometheus(std::ostream &output) const;
+  // Writes a snapshot next to `path` and renames it, so readers never see a
+  // partial file.
+  void write_file(const std::string &path) const;
+
+private:
+  template <size_t N> using Counters = std::array<MetricCounter, N>;
+
+  Counters<NR_OF_DIRECTIONS> m_tcp_bytes;
+  std::array<Counters<NR_OF_BODY_TYPES>, NR_OF_DIRECTIONS> m_frames;
+  std::array<Counters<NR_OF_BODY_TYPES>, NR_OF_DIRECTIONS> m_frame_bytes;
+  std::array<Counters<NR_OF_DEVICES>, NR_OF_DIRECTIONS> m_midi_messages;
+  std::array<Counters<NR_OF_DEVICES>, NR_OF_DIRECTIONS> m_midi_bytes;
+  Counters<NR_OF_DEVICES> m_lcd_bytes_saved;
+  MetricCounter m_skipped_bytes;
+  Counters<NR_OF_EVENTS> m_events;
+  std::vector<Callback> m_callbacks;
+};
+
+// Answers every connection on a Unix socket with a snapshot of the metrics
+// and closes it, e.g. `socat - UNIX-CONNECT:<path>`.
+class MetricsServer : public std::enable_shared_from_this<MetricsServer> {
+public:
+  MetricsServer(const asio::any_io_executor &executor, const std::string &path,
+                std::shared_ptr<const Metrics> metrics);
+  void start();
+  // Stops accepting connections.
+  void stop();
+
+private:
+  void accept();
+  void handle_accept_error(const asio::error_code &error);
+
+  std::string m_path;
+  asio::local::stream_protocol::acceptor m_acceptor;
+  asio::steady_timer m_retry_timer;
+  std::shared_ptr<const Metrics> m_metrics;
+  // Set while accepting fails, so a lasting failure is logged once.
+  bool m_failing = false;
+};
+
+} // namespace sls3mcubridge
@@ -1,6 +1,8 @@
 
+#include <cstddef>
 #include <functional>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 
@@ -9,6 +11,7 @@
 #include "libremidi/message.hpp"
 #include "spdlog/spdlog.h"
 
+#include "capture.hpp"
 #include "mididevice.hpp"
 
 namespace sls3mcubridge {
@@ -31,9 +34,13 @@ void MidiDevice::start_reading(
             if (!this->m_received_first_message) {
               spdlog::info(this->m_name + " accepted connection.");
               this->m_received_first_message = true;
+              if (this->m_input_thread_setup) {
+                this->m_input_thread_setup();
+              }
             }
+            this->capture(CaptureSource::MidiFromDaw,
+                          std::as_bytes(std::span(message.bytes)));
             callback(0, message);
-            auto test = message.bytes;
           },
       .on_error =
           [](libremidi::midi_error error, std::string_view str) {
@@ -51,7 +58,22 @@ void MidiDevice::start_reading(
 }
 
 void MidiDevice::send_message(const libremidi::message &message) {
+  capture(CaptureSource::MidiToDaw, std::as_bytes(std::span(message.bytes)));
   m_out.send_message(message);
 }
 
-} // namespace sls3mcubridge
\ No newline at end of file
+void MidiDevice::send_message(std::span<const std::byte> message) {
+  capture(CaptureSource::MidiToDaw, message);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  m_out.send_message(reinterpret_cast<const unsigned char *>(message.data()),
+                     message.size());
+}
+
+void MidiDevice::capture(CaptureSource source,
+                         std::span<const std::byte> message) {
+  if (m_capture) {
+    m_capture->record(source, m_capture_device, message);
+  }
+}
+
+} // namespace sls3mcubridge
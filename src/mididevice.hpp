@@ -1,10 +1,16 @@
 #pragma once
 
+#include "capture.hpp"
+
 #include "libremidi/libremidi.hpp"
 #include "libremidi/message.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <span>
+#include <utility>
 
 namespace sls3mcubridge {
 
@@ -19,12 +25,28 @@ public:
   void start_reading(
       const std::function<void(int, const libremidi::message &)> &callback);
   void send_message(const libremidi::message &message);
+  void send_message(std::span<const std::byte> message);
+  // Records all messages received and sent from now on as `device`.
+  void set_capture(std::shared_ptr<CaptureWriter> capture, uint8_t device) {
+    m_capture = std::move(capture);
+    m_capture_device = device;
+  }
+  // Called on the input thread of the midi backend before it hands over its
+  // first message, to set up the scheduling of that thread.
+  void set_input_thread_setup(std::function<void()> setup) {
+    m_input_thread_setup = std::move(setup);
+  }
 
 private:
+  void capture(CaptureSource source, std::span<const std::byte> message);
+
   std::string m_name;
   libremidi::midi_out m_out;
   std::shared_ptr<libremidi::midi_in> m_in;
   bool m_received_first_message = false;
+  std::function<void()> m_input_thread_setup;
+  std::shared_ptr<CaptureWriter> m_capture;
+  uint8_t m_capture_device = 0;
 };
 
 } // namespace sls3mcubridge
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// A channel message is a status byte, its kind in the high nibble and its
+// channel in the low nibble, and up to two data bytes of 7 bits.
+const size_t CHANNEL_MESSAGE_SIZE = 3;
+const uint8_t STATUS_MASK = 0xf0;
+const uint8_t CHANNEL_MASK = 0x0f;
+const uint8_t DATA_MASK = 0x7f;
+const uint8_t DATA_BITS = 7;
+const uint8_t NOTE_OFF = 0x80;
+const uint8_t NOTE_ON = 0x90;
+const uint8_t CONTROL_CHANGE = 0xb0;
+const uint8_t CHANNEL_PRESSURE = 0xd0;
+const uint8_t PITCH_BEND = 0xe0;
+const uint8_t SYSEX_START = 0xf0;
+const uint8_t SYSEX_END = 0xf7;
+
+// A midi message of at most three bytes, a status byte and its data bytes,
+// held inline. Channel messages are passed around as these, so a run of them
+// is one flat array and copying one never allocates. Only SysEx messages
+// refer to storage of their own. Converted to libremidi::message only where
+// it is handed to the midi backend, see MidiDevice.
+class ShortMessage {
+public:
+  static const size_t MAX_SIZE = 3;
+
+  ShortMessage() = default;
+  // Throw std::length_error when the message is longer than MAX_SIZE.
+  explicit ShortMessage(std::span<const unsigned char> bytes) {
+    assign(bytes.begin(), bytes.end(), bytes.size());
+  }
+  explicit ShortMessage(std::span<const std::byte> bytes) {
+    assign(bytes.begin(), bytes.end(), bytes.size());
+  }
+  ShortMessage(std::initializer_list<unsigned char> bytes) {
+    assign(bytes.begin(), bytes.end(), bytes.size());
+  }
+
+  [[nodiscard]] size_t size() const { return m_size; }
+  [[nodiscard]] bool empty() const { return m_size == 0; }
+  [[nodiscard]] const unsigned char *data() const { return m_bytes.data(); }
+  [[nodiscard]] const unsigned char *begin() const { return m_bytes.data(); }
+  [[nodiscard]] const unsigned char *end() const {
+    return m_bytes.data() + m_size;
+  }
+  unsigned char &operator[](size_t index) { return m_bytes.at(index); }
+  const unsigned char &operator[](size_t index) const {
+    return m_bytes.at(index);
+  }
+  [[nodiscard]] std::span<const std::byte> as_bytes() const {
+    return std::as_bytes(std::span(m_bytes.data(), m_size));
+  }
+
+  bool operator==(const ShortMessage &other) const = default;
+
+private:
+  template <class Iterator>
+  void assign(Iterator begin, Iterator end, size_t size) {
+    if (size > MAX_SIZE) {
+      throw std::length_error("Midi message of " + std::to_string(size) +
+                              " bytes is not a short message");
+    }
+    std::transform(begin, end, m_bytes.begin(), [](auto value) {
+      return static_cast<unsigned char>(value);
+    });
+    m_size = static_cast<uint8_t>(size);
+  }
+
+  // Bytes behind m_size are zero, so equal messages compare equal.
+  std::array<unsigned char, MAX_SIZE> m_bytes{};
+  uint8_t m_size = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<ShortMessage>);
+static_assert(sizeof(ShortMessage) == ShortMessage::MAX_SIZE + 1);
+
+// Midi messages in the order they were added. Channel messages are kept as
+// ShortMessage in one flat vector. A SysEx message stands in that vector as
+// its start byte alone, its bytes go to a byte buffer shared by all SysEx
+// messages of the run. Clearing keeps the capacity, so a run that is reused
+// stops allocating once it held its largest set of messages.
+class MessageRun {
+public:
+  // Throws std::length_error for a message longer than ShortMessage::MAX_SIZE
+  // that is no SysEx message.
+  void push_back(std::span<const unsigned char> message) {
+    if (!message.empty() && message[0] == SYSEX_START) {
+      m_messages.push_back(ShortMessage{SYSEX_START});
+      m_sysex.emplace_back(m_sysex_bytes.size(), message.size());
+      m_sysex_bytes.insert(m_sysex_bytes.end(), message.begin(),
+                           message.end());
+      return;
+    }
+    m_messages.emplace_back(message);
+  }
+  void push_back(const ShortMessage &message) {
+    push_back(std::span(message.begin(), message.size()));
+  }
+
+  [[nodiscard]] size_t size() const { return m_messages.size(); }
+  [[nodiscard]] bool empty() const { return m_messages.empty(); }
+  void clear() {
+    m_messages.clear();
+    m_sysex.clear();
+    m_sysex_bytes.clear();
+  }
+  // The channel messages and the stand-ins of the SysEx messages, e.g. to
+  // collapse them with LastValueFilter. Stand-ins must keep their order.
+  std::vector<ShortMessage> &short_messages() { return m_messages; }
+  [[nodiscard]] size_t nr_sysex() const { return m_sysex.size(); }
+  // Bytes of all SysEx messages together.
+  [[nodiscard]] size_t sysex_size() const { return m_sysex_bytes.size(); }
+
+  // Calls `visitor` with the bytes of every message in order, as a
+  // std::span<const unsigned char>.
+  template <class Visitor> void for_each(Visitor &&visitor) const {
+    size_t next_sysex = 0;
+    for (const auto &message : m_messages) {
+      if (message.size() == 1 && message[0] == SYSEX_START) {
+        const auto &[offset, size] = m_sysex.at(next_sysex++);
+        visitor(std::span(m_sysex_bytes).subspan(offset, size));
+      } else {
+        visitor(std::span(message.begin(), message.size()));
+      }
+    }
+  }
+
+private:
+  std::vector<ShortMessage> m_messages;
+  // Offset and size in m_sysex_bytes of every SysEx message.
+  std::vector<std::pair<size_t, size_t>> m_sysex;
+  std::vector<unsigned char> m_sysex_bytes;
+};
+
+} // namespace sls3mcubridge
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace sls3mcubridge {
+
+const size_t CACHE_LINE_SIZE = 64;
+
+// Bounded lock-free queue for many producers and a single consumer, based on
+// Dmitry Vyukov's bounded MPMC queue. Producers never block, try_push() fails
+// when the queue is full.
+template <class T> class MpscQueue {
+public:
+  // The capacity is rounded up to a power of two.
+  explicit MpscQueue(size_t capacity)
+      : m_capacity(round_up_to_power_of_two(capacity)),
+        m_cells(std::make_unique<Cell[]>(m_capacity)) { // NOLINT
+    for (size_t i = 0; i < m_capacity; i++) {
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // May be called from any thread.
+  bool try_push(const T &value) {
+    auto pos = claim();
+    if (!pos) {
+      return false;
+    }
+    publish(*pos, value);
+    return true;
+  }
+  // Moves `value` in, e.g. to hand over its storage without copying it.
+  bool try_push(T &&value) {
+    auto pos = claim();
+    if (!pos) {
+      return false;
+    }
+    publish(*pos, std::move(value));
+    return true;
+  }
+
+  // Only to be called from the consumer thread.
+  bool try_pop(T &value) {
+    auto &cell = m_cells[m_dequeue_pos & (m_capacity - 1)];
+    auto sequence = cell.sequence.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(sequence) -
+            static_cast<intptr_t>(m_dequeue_pos + 1) <
+        0) {
+      return false;
+    }
+    value = std::move(cell.value);
+    cell.sequence.store(m_dequeue_pos + m_capacity, std::memory_order_release);
+    m_dequeue_pos++;
+    return true;
+  }
+
+  [[nodiscard]] size_t capacity() const { return m_capacity; }
+  // Values pushed and not yet popped, including pushes still in progress.
+  // Only to be called from the consumer thread.
+  [[nodiscard]] size_t size() const {
+    return m_enqueue_pos.load(std::memory_order_relaxed) - m_dequeue_pos;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  // Reserves the next cell for a producer, nothing when the queue is full.
+  std::optional<size_t> claim() {
+    auto pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+      auto &cell = m_cells[pos & (m_capacity - 1)];
+      auto sequence = cell.sequence.load(std::memory_order_acquire);
+      auto diff =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+          return pos;
+        }
+      } else if (diff < 0) {
+        return std::nullopt;
+      } else {
+        pos = m_enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  template <class Value> void publish(size_t pos, Value &&value) {
+    auto &cell = m_cells[pos & (m_capacity - 1)];
+    cell.value = std::forward<Value>(value);
+    cell.sequence.store(pos + 1, std::memory_order_release);
+  }
+
+  static size_t round_up_to_power_of_two(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1U;
+    }
+    return result;
+  }
+
+  size_t m_capacity;
+  std::unique_ptr<Cell[]> m_cells; // NOLINT
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_enqueue_pos{0};
+  alignas(CACHE_LINE_SIZE) size_t m_dequeue_pos = 0;
+};
+
+} // namespace sls3mcubridge
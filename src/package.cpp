@@ -1,16 +1,17 @@
 #include "package.hpp"
-#include "libremidi/config.hpp"
-#include "libremidi/message.hpp"
-#include "spdlog/spdlog.h"
+#include "midimessage.hpp"
 
-#include <climits>
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
-#include <exception>
-#include <map>
+#include <initializer_list>
 #include <memory>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
 namespace sls3mcubridge::tcp {
@@ -27,20 +28,215 @@ const std::byte INITIAL_RESPONSE_THIRD_BYTE = std::byte(0x65);
 
 const std::string_view MIDI_STRING = "midi";
 
-std::map<uint16_t, Body::Type> int16_to_type_map() {
-  try {
-    static const std::map<uint16_t, Body::Type> int16_to_type_map = {
-        {16975, Body::Type::InitialResponse},
-        {19789, Body::Type::IncommingMidi},
-        {19777, Body::Type::OutgoingMidi},
-        {21331, Body::Type::SysEx}};
-    return int16_to_type_map;
-  } catch (std::exception &exc) {
-    spdlog::error("failed to create static int16 to type map.");
-    throw exc;
+namespace {
+void check_buffer_size(std::span<std::byte> buffer, size_t required) {
+  if (buffer.size() < required) {
+    throw std::length_error("Buffer of " + std::to_string(buffer.size()) +
+                            " bytes too small to serialize " +
+                            std::to_string(required) + " bytes");
   }
 }
 
+// Fixed size fields between the body header and the payload of a body.
+// A Length field is followed by the high byte of the length in LengthHigh.
+enum class BodyField : uint8_t { Device, Delimiter, Count, Length, LengthHigh };
+
+const size_t MAX_PREFIX_FIELDS = 4;
+
+struct BodyLayout {
+  std::array<BodyField, MAX_PREFIX_FIELDS> prefix{};
+  size_t prefix_size = 0;
+  // Number of delimiters behind the payload.
+  size_t trailer_size = 0;
+};
+
+constexpr BodyLayout make_layout(std::initializer_list<BodyField> prefix,
+                                 size_t trailer_size) {
+  BodyLayout layout;
+  std::copy(prefix.begin(), prefix.end(), layout.prefix.begin());
+  layout.prefix_size = prefix.size();
+  layout.trailer_size = trailer_size;
+  return layout;
+}
+
+struct BodyFields {
+  MidiDeviceIndicator device;
+  BufferView<std::byte *> payload;
+};
+
+struct BodyTypeInfo {
+  Body::Type type;
+  uint16_t code;
+  std::byte third_byte;
+  BodyLayout layout;
+  std::shared_ptr<Body> (*create)(BufferView<std::byte *>);
+  BodyView (*decode)(BufferView<std::byte *>);
+  size_t view_index;
+};
+
+constexpr uint16_t make_code(char first, char second) {
+  return static_cast<uint16_t>(
+      (static_cast<uint16_t>(first) << SIZE_OF_BYTE) |
+      static_cast<uint16_t>(second));
+}
+
+template <class BodyClass>
+std::shared_ptr<Body> create_body(BufferView<std::byte *> buffer_view) {
+  return std::make_shared<BodyClass>(buffer_view);
+}
+
+// Validates the fixed fields of a body and returns the payload between them.
+BodyFields decode_fields(const BodyLayout &layout,
+                         BufferView<std::byte *> content) {
+  if (content.distance() < layout.prefix_size + layout.trailer_size) {
+    throw std::invalid_argument("Body too small for its fields");
+  }
+  BodyFields fields{MidiDeviceIndicator(DELIMITER),
+                    BufferView(content.begin() + layout.prefix_size,
+                               content.end() - layout.trailer_size)};
+  size_t length = 0;
+  bool has_length = false;
+  const auto *field = content.begin();
+  for (size_t i = 0; i < layout.prefix_size; i++, field++) {
+    switch (layout.prefix.at(i)) {
+    case BodyField::Device:
+      fields.device = MidiDeviceIndicator(*field);
+      break;
+    case BodyField::Delimiter:
+      if (*field != DELIMITER) {
+        throw std::invalid_argument("Delimiter expected");
+      }
+      break;
+    case BodyField::Length:
+      length = std::to_integer<size_t>(*field);
+      has_length = true;
+      break;
+    case BodyField::LengthHigh:
+      length |= std::to_integer<size_t>(*field) << SIZE_OF_BYTE;
+      break;
+    case BodyField::Count:
+    default:
+      break;
+    }
+  }
+  if (has_length && length != fields.payload.distance()) {
+    throw std::invalid_argument("Body has an unexpected length of:" +
+                                std::to_string(fields.payload.distance()));
+  }
+  return fields;
+}
+
+// Decoder for one body type, BODY_TYPES holds a pointer to it. The fields are
+// checked at run time by decode_fields().
+template <class View, BodyLayout Layout>
+BodyView decode_view(BufferView<std::byte *> content) {
+  auto fields = decode_fields(Layout, content);
+  if constexpr (requires { &View::device; }) {
+    return View{fields.device, fields.payload};
+  } else {
+    return View{fields.payload};
+  }
+}
+
+template <class View, size_t Index = 0> constexpr size_t view_index() {
+  if constexpr (std::is_same_v<std::variant_alternative_t<Index, BodyView>,
+                               View>) {
+    return Index;
+  } else {
+    return view_index<View, Index + 1>();
+  }
+}
+
+template <class BodyClass, class View, BodyLayout Layout>
+constexpr BodyTypeInfo make_type(Body::Type type, uint16_t code,
+                                 std::byte third_byte) {
+  return {type,
+          code,
+          third_byte,
+          Layout,
+          &create_body<BodyClass>,
+          &decode_view<View, Layout>,
+          view_index<View>()};
+}
+
+// All known UCNet body types, indexed by Body::Type. Decoding and encoding of
+// every body goes through this table.
+constexpr std::array BODY_TYPES = {
+    make_type<UnkownBody, UnkownBodyView, make_layout({}, 0)>(
+        Body::Type::Unkown, 0, DELIMITER),
+    make_type<InitialResponseBody, InitialResponseBodyView,
+              make_layout({}, 0)>(Body::Type::InitialResponse,
+                                  make_code('B', 'O'),
+                                  INITIAL_RESPONSE_THIRD_BYTE),
+    // device, delimiter, midi message, delimiter
+    make_type<IncommingMidiBody, IncommingMidiBodyView,
+              make_layout({BodyField::Device, BodyField::Delimiter}, 1)>(
+        Body::Type::IncommingMidi, make_code('M', 'M'), DELIMITER),
+    // device, delimiter, message count, midi messages
+    make_type<OutgoingMidiBody, OutgoingMidiBodyView,
+              make_layout({BodyField::Device, BodyField::Delimiter,
+                           BodyField::Count},
+                          0)>(Body::Type::OutgoingMidi, make_code('M', 'A'),
+                              DELIMITER),
+    // device, delimiter, sysex length (16 bit little endian), sysex message
+    make_type<SysExMidiBody, SysExMidiBodyView,
+              make_layout({BodyField::Device, BodyField::Delimiter,
+                           BodyField::Length, BodyField::LengthHigh},
+                          0)>(Body::Type::SysEx, make_code('S', 'S'),
+                              DELIMITER),
+};
+
+constexpr bool body_types_are_ordered() {
+  for (size_t i = 0; i < BODY_TYPES.size(); i++) {
+    if (BODY_TYPES.at(i).type != i || BODY_TYPES.at(i).view_index != i) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(BODY_TYPES.size() == std::variant_size_v<BodyView>);
+static_assert(body_types_are_ordered(),
+              "BODY_TYPES must be ordered like Body::Type and BodyView");
+static_assert(Body::BODY_HEADER_SIZE +
+                      BODY_TYPES.at(Body::Type::SysEx).layout.prefix_size +
+                      BODY_TYPES.at(Body::Type::SysEx).layout.trailer_size ==
+                  SYSEX_BODY_OVERHEAD,
+              "SYSEX_BODY_OVERHEAD must match the SysEx layout");
+
+BodyFields decode_fields(Body::Type type, BufferView<std::byte *> content) {
+  return decode_fields(BODY_TYPES.at(type).layout, content);
+}
+
+struct BodyContent {
+  Body::Type type;
+  BufferView<std::byte *> content;
+};
+
+BodyContent decode_body_header(BufferView<std::byte *> buffer_view) {
+  if (buffer_view.distance() < Body::BODY_HEADER_SIZE) {
+    throw std::invalid_argument("Body smaller than body header");
+  }
+  // The third byte is not validated, the initial response body uses it for a
+  // value of which the meaning is unkown.
+  const auto *header = buffer_view.begin();
+  if (header[3] != DELIMITER) {
+    throw std::invalid_argument("Expected delimiter at step 3");
+  }
+  auto code = static_cast<uint16_t>(
+      (std::to_integer<uint16_t>(header[0]) << SIZE_OF_BYTE) |
+      std::to_integer<uint16_t>(header[1]));
+  return {Body::type_from_int(code),
+          BufferView(buffer_view.begin() + Body::BODY_HEADER_SIZE,
+                     buffer_view.end())};
+}
+} // namespace
+
+std::vector<std::byte> ISerialize::serialize() {
+  std::vector<std::byte> buffer(serialized_size());
+  buffer.resize(serialize_into(buffer));
+  return buffer;
+}
+
 Header::Header(BufferView<std::byte *> buffer_view) {
   int step = 0;
   for (const auto &iter : buffer_view) {
@@ -77,18 +273,14 @@ Header::Header(BufferView<std::byte *> buffer_view) {
       step++;
       break;
 
-    // body size
+    // body size, little endian
     case 4:
-      m_body_size = std::to_integer<uint8_t>(iter);
+      m_body_size = std::to_integer<uint16_t>(iter);
       step++;
       break;
-
-    // delimiter
     case 5: // NOLINT
-      if (iter != DELIMITER) {
-        throw std::invalid_argument("Expected delimiter in step " +
-                                    std::to_string(step));
-      }
+      m_body_size |= static_cast<uint16_t>(std::to_integer<uint16_t>(iter)
+                                           << SIZE_OF_BYTE);
       step++;
       break;
     default:
@@ -97,141 +289,115 @@ Header::Header(BufferView<std::byte *> buffer_view) {
   }
 }
 
-std::vector<std::byte> Header::serialize() {
-  std::vector<std::byte> buffer;
-  buffer.push_back(HEADER_FIRST_BYTE);
-  buffer.push_back(HEADER_SECOND_BYTE);
-  buffer.push_back(DELIMITER);
-  buffer.push_back(HEADER_UNKOWN_BYTE);
-  buffer.push_back(std::byte(m_body_size));
-  buffer.push_back(DELIMITER);
-  return buffer;
+size_t Header::serialize_into(std::span<std::byte> buffer) const {
+  check_buffer_size(buffer, serialized_size());
+  buffer[0] = HEADER_FIRST_BYTE;
+  buffer[1] = HEADER_SECOND_BYTE;
+  buffer[2] = DELIMITER;
+  buffer[3] = HEADER_UNKOWN_BYTE;
+  buffer[4] = std::byte(m_body_size);
+  buffer[5] = std::byte(m_body_size >> SIZE_OF_BYTE); // NOLINT
+  return HEADER_SIZE;
+}
+
+void Header::set_body_size(size_t size) {
+  if (size > MAX_BODY_SIZE) {
+    throw std::length_error("Body of " + std::to_string(size) +
+                            " bytes too large for a package");
+  }
+  m_body_size = static_cast<uint16_t>(size);
 }
 
 std::shared_ptr<Body> Body::create(BufferView<std::byte *> buffer_view) {
-  int step = 0;
-  uint16_t type_int = 0;
-  auto header_view =
-      BufferView(buffer_view.begin(), buffer_view.begin() + BODY_HEADER_SIZE);
-  for (auto &iter : header_view) {
-    switch (step) {
-    case 0:
-      type_int =
-          static_cast<uint16_t>(static_cast<uint16_t>(iter) << SIZE_OF_BYTE);
-      step++;
-      break;
-    case 1:
-      type_int |= static_cast<uint16_t>(iter);
-      step++;
+  auto body = decode_body_header(buffer_view);
+  return BODY_TYPES.at(body.type).create(body.content);
+}
+
+Body::Type Body::type_from_int(uint16_t type_int) {
+  for (const auto &iter : BODY_TYPES) {
+    if (iter.code == type_int) {
+      return iter.type;
+    }
+  }
+  return Type::Unkown;
+}
+
+size_t Body::fixed_size(Type type) {
+  const auto &layout = BODY_TYPES.at(type).layout;
+  return BODY_HEADER_SIZE + layout.prefix_size + layout.trailer_size;
+}
+
+size_t Body::serialize_header_into(std::span<std::byte> buffer,
+                                   std::byte device, size_t value) const {
+  check_buffer_size(buffer, serialized_size());
+  const auto &info = BODY_TYPES.at(m_type);
+  buffer[0] = std::byte(info.code >> SIZE_OF_BYTE);
+  buffer[1] = std::byte(info.code);
+  buffer[2] = info.third_byte;
+  buffer[3] = DELIMITER;
+  size_t pos = BODY_HEADER_SIZE;
+  for (size_t i = 0; i < info.layout.prefix_size; i++) {
+    switch (info.layout.prefix.at(i)) {
+    case BodyField::Device:
+      buffer[pos++] = device;
       break;
-    case 2:
-      // TODO(ruud): This byte is ignored for now, the midi related bodies have
-      // a delimiter here, the initialresponse body has a value for which the
-      // use is currently unkow. A proper solution would to diferenciate "midi
-      // bodies" and "other bodies"
-      step++;
+    case BodyField::Count:
+      if (value > UINT8_MAX) {
+        throw std::length_error("Count of " + std::to_string(value) +
+                                " too large for its field");
+      }
+      buffer[pos++] = std::byte(value);
       break;
-    case 3:
-      if (iter != DELIMITER) {
-        throw std::invalid_argument("Expected delimiter at step " +
-                                    std::to_string(step));
+    case BodyField::Length:
+      if (value > UINT16_MAX) {
+        throw std::length_error("Length of " + std::to_string(value) +
+                                " too large for its field");
       }
-      step++;
+      buffer[pos++] = std::byte(value);
       break;
+    case BodyField::LengthHigh:
+      buffer[pos++] = std::byte(value >> SIZE_OF_BYTE);
+      break;
+    case BodyField::Delimiter:
     default:
-      throw std::out_of_range("Unexpected step handled");
+      buffer[pos++] = DELIMITER;
+      break;
     }
   }
-  Type type = Type::Unkown;
-  try {
-    type = int16_to_type_map().at(type_int);
-  } catch (std::out_of_range &) {
-    type = Type::Unkown;
-  }
-
-  auto sub_body_view = BufferView(header_view.end(), buffer_view.end());
-
-  switch (type) {
-  case Type::InitialResponse:
-    return std::make_shared<InitialResponseBody>(sub_body_view);
-  case Type::IncommingMidi:
-    return std::make_shared<IncommingMidiBody>(sub_body_view);
-  case Type::OutgoingMidi:
-    return std::make_shared<OutgoingMidiBody>(sub_body_view);
-  case Type::SysEx:
-    return std::make_shared<SysExMidiBody>(sub_body_view);
-  case Type::Unkown:
-  default:
-    return std::make_shared<UnkownBody>(sub_body_view);
-  }
+  return pos;
 }
 
-std::vector<std::byte> Body::serialize() {
-  std::vector<std::byte> tmp;
-  uint16_t type_int = find_type_in_map(m_type);
-  tmp.push_back(
-      std::byte(type_int >> (sizeof(decltype(tmp)::value_type) * CHAR_BIT)));
-  tmp.push_back(std::byte(type_int));
-  if (m_type == Type::InitialResponse) {
-    tmp.push_back(std::byte(INITIAL_RESPONSE_THIRD_BYTE));
-  } else {
-    tmp.push_back(DELIMITER);
-  }
-  tmp.push_back(DELIMITER);
-  return tmp;
+size_t Body::serialize_header_into(std::span<std::byte> buffer) const {
+  return serialize_header_into(buffer, DELIMITER, 0);
 }
 
-uint16_t Body::find_type_in_map(Type type) {
-  for (auto const &[key, val] : int16_to_type_map()) {
-    if (val == type) {
-      return key;
-    }
-  }
-  // not found
-  return 0;
+size_t Body::serialize_trailer_into(std::span<std::byte> buffer,
+                                    size_t pos) const {
+  const auto &layout = BODY_TYPES.at(m_type).layout;
+  std::fill_n(buffer.begin() + static_cast<int64_t>(pos), layout.trailer_size,
+              DELIMITER);
+  return pos + layout.trailer_size;
 }
 
 IncommingMidiBody::IncommingMidiBody(BufferView<std::byte *> buffer_view)
     : Body(Body::Type::IncommingMidi,
            BODY_HEADER_SIZE + buffer_view.distance()),
       m_device(std::byte(0x0)) {
-  int step = 0;
-  for (auto iter : buffer_view) {
-    switch (step) {
-    case 0:
-      m_device = MidiDeviceIndicator(iter);
-      step++;
-      break;
-    case 1:
-      if (iter != DELIMITER) {
-        throw std::invalid_argument("Delimiter expected");
-      }
-      step++;
-      break;
-    case 2:
-      m_message.bytes.push_back(static_cast<unsigned char>(iter));
-      break;
-    default:
-      throw std::out_of_range("Unexpected step handled");
-    }
-  }
-  m_message.bytes.pop_back();
+  auto fields = decode_fields(Body::Type::IncommingMidi, buffer_view);
+  m_device = fields.device;
+  m_message = ShortMessage(
+      std::span<const std::byte>(fields.payload.begin(), fields.payload.end()));
 }
 
-std::vector<std::byte> IncommingMidiBody::serialize() {
-  auto tmp = std::vector<std::byte>();
-  auto body_header = Body::serialize();
-  tmp.insert(tmp.end(), body_header.begin(), body_header.end());
-  tmp.push_back(m_device.get_byte());
-  tmp.push_back(DELIMITER);
-  for (auto &iter : m_message) {
-    tmp.push_back(std::byte(iter));
-  }
-  tmp.push_back(DELIMITER);
-  return tmp;
+size_t IncommingMidiBody::serialize_into(std::span<std::byte> buffer) const {
+  auto pos = serialize_header_into(buffer, m_device.get_byte(), 0);
+  auto message = m_message.as_bytes();
+  std::copy(message.begin(), message.end(), buffer.begin() + pos);
+  pos += message.size();
+  return serialize_trailer_into(buffer, pos);
 }
 
-int MidiDeviceIndicator::get_index() {
+int MidiDeviceIndicator::get_index() const {
   if (m_device_byte >= std::byte(INCOMMING_MIDI_DEVICE_BASE)) {
     // incomming device type
     for (int i = 0; i < NR_OF_SUPPORTED_DEVICES; i++) {
@@ -251,13 +417,11 @@ int MidiDeviceIndicator::get_index() {
   throw std::invalid_argument("Could not determine midi device index");
 }
 
-OutgoingMidiBody::OutgoingMidiBody(
-    std::byte device, const std::vector<libremidi::message> &messages)
+OutgoingMidiBody::OutgoingMidiBody(std::byte device,
+                                   std::span<const ShortMessage> messages)
     : Body(Body::Type::OutgoingMidi, 0), m_device(device),
       m_messages(messages) {
-  size_t tmp_size = 0;
-  tmp_size += BODY_HEADER_SIZE;
-  tmp_size += 3;
+  size_t tmp_size = fixed_size(Body::Type::OutgoingMidi);
   for (auto const &iter : m_messages) {
     tmp_size += iter.size();
   }
@@ -267,100 +431,43 @@ OutgoingMidiBody::OutgoingMidiBody(
 OutgoingMidiBody::OutgoingMidiBody(BufferView<std::byte *> buffer_view)
     : Body(Body::Type::OutgoingMidi, BODY_HEADER_SIZE + buffer_view.distance()),
       m_device(std::byte(0x0)) {
-  int step = 0;
-  libremidi::midi_bytes tmp_midi_bytes;
-
-  for (const auto &iter : buffer_view) {
-    switch (step) {
-    case 0:
-      m_device = MidiDeviceIndicator(iter);
-      step++;
-      break;
-    case 1:
-      if (iter != DELIMITER) {
-        throw std::invalid_argument("Delimiter expected");
-      }
-      step++;
-      break;
-    case 2:
-      step++;
-      break;
-    case 3:
-      tmp_midi_bytes.push_back(static_cast<unsigned char>(iter));
-      if (tmp_midi_bytes.size() == 3) {
-        m_messages.emplace_back(tmp_midi_bytes, 0);
-        tmp_midi_bytes.clear();
-      }
-      break;
-    default:
-      throw std::out_of_range("Unexpected step handled");
-    }
+  auto fields = decode_fields(Body::Type::OutgoingMidi, buffer_view);
+  m_device = fields.device;
+  std::span<const std::byte> remaining(fields.payload.begin(),
+                                       fields.payload.end());
+  m_parsed.reserve(remaining.size() / OutgoingMidiBodyView::MESSAGE_SIZE);
+  while (remaining.size() >= OutgoingMidiBodyView::MESSAGE_SIZE) {
+    m_parsed.emplace_back(remaining.first(OutgoingMidiBodyView::MESSAGE_SIZE));
+    remaining = remaining.subspan(OutgoingMidiBodyView::MESSAGE_SIZE);
   }
+  m_messages = m_parsed;
 }
 
-std::vector<std::byte> OutgoingMidiBody::serialize() {
-  auto tmp = std::vector<std::byte>();
-  auto body_header = Body::serialize();
-  tmp.insert(tmp.end(), body_header.begin(), body_header.end());
-  tmp.push_back(m_device.get_byte());
-  tmp.push_back(DELIMITER);
-  tmp.push_back(std::byte(m_messages.size()));
+size_t OutgoingMidiBody::serialize_into(std::span<std::byte> buffer) const {
+  auto pos =
+      serialize_header_into(buffer, m_device.get_byte(), m_messages.size());
   for (const auto &iter : m_messages) {
-    for (const auto &iterr : iter) {
-      tmp.push_back(std::byte(iterr));
-    }
+    auto message = iter.as_bytes();
+    std::copy(message.begin(), message.end(), buffer.begin() + pos);
+    pos += message.size();
   }
-  return tmp;
+  return serialize_trailer_into(buffer, pos);
 }
 
 SysExMidiBody::SysExMidiBody(BufferView<std::byte *> buffer_view)
     : Body(Body::Type::SysEx, BODY_HEADER_SIZE + buffer_view.distance()),
       m_device(std::byte(0x0)) {
-  int step = 0;
-  size_t sysex_length = 0;
-  for (const auto &iter : buffer_view) {
-    switch (step) {
-    case 0:
-      m_device = MidiDeviceIndicator(iter);
-      step++;
-      break;
-    case 1:
-    case 3:
-      if (iter != DELIMITER) {
-        throw std::invalid_argument("Delimiter expected");
-      }
-      step++;
-      break;
-    case 2:
-      sysex_length = static_cast<size_t>(iter);
-      step++;
-      break;
-    case 4: {
-      m_message.bytes.push_back(static_cast<unsigned char>(iter));
-      break;
-    default:
-      throw std::out_of_range("Unexpected step handled");
-    }
-    }
-  }
-  if (m_message.size() != sysex_length) {
-    throw std::invalid_argument("Sysex body has an unexpected length of:" +
-                                std::to_string(m_message.size()));
-  }
+  auto fields = decode_fields(Body::Type::SysEx, buffer_view);
+  m_device = fields.device;
+  m_message = {fields.payload.begin(), fields.payload.end()};
 }
 
-std::vector<std::byte> SysExMidiBody::serialize() {
-  auto tmp = std::vector<std::byte>();
-  auto body_header = Body::serialize();
-  tmp.insert(tmp.end(), body_header.begin(), body_header.end());
-  tmp.push_back(m_device.get_byte());
-  tmp.push_back(DELIMITER);
-  tmp.push_back(std::byte(m_message.size()));
-  tmp.push_back(DELIMITER);
-  for (auto &iter : m_message) {
-    tmp.push_back(std::byte(iter));
-  }
-  return tmp;
+size_t SysExMidiBody::serialize_into(std::span<std::byte> buffer) const {
+  auto pos =
+      serialize_header_into(buffer, m_device.get_byte(), m_message.size());
+  std::copy(m_message.begin(), m_message.end(), buffer.begin() + pos);
+  pos += m_message.size();
+  return serialize_trailer_into(buffer, pos);
 }
 
 Package::Package(BufferView<std::byte *> buffer_view)
@@ -371,23 +478,21 @@ Package::Package(BufferView<std::byte *> buffer_view)
                      buffer_view.begin() + HEADER_SIZE +
                          static_cast<int64_t>(m_header.get_body_size())))) {}
 
-std::vector<std::byte> Package::serialize() {
-  std::vector<std::byte> tmp = m_header.serialize();
-  auto body_vec = m_body->serialize();
-  tmp.insert(tmp.end(), body_vec.begin(), body_vec.end());
-  return tmp;
+size_t Package::serialize_into(std::span<std::byte> buffer) const {
+  check_buffer_size(buffer, serialized_size());
+  auto pos = m_header.serialize_into(buffer);
+  pos += m_body->serialize_into(buffer.subspan(pos));
+  return pos;
 }
 
 std::byte Package::index_to_midi_device_byte(int index) {
   return std::byte(OUTGOING_MIDI_DEVICE_BASE + index);
 }
 
-std::vector<std::byte> InitialResponseBody::serialize() {
-  auto body_header = Body::serialize();
-  std::vector<std::byte> tmp;
-  tmp.insert(tmp.end(), body_header.begin(), body_header.end());
-  tmp.insert(tmp.end(), m_content.begin(), m_content.end());
-  return tmp;
+size_t InitialResponseBody::serialize_into(std::span<std::byte> buffer) const {
+  auto pos = serialize_header_into(buffer);
+  std::copy(m_content.begin(), m_content.end(), buffer.begin() + pos);
+  return pos + m_content.size();
 }
 
 uint8_t InitialResponseBody::get_nr_of_midi_devices() {
@@ -404,11 +509,26 @@ uint8_t InitialResponseBody::get_nr_of_midi_devices() {
   return occurences;
 }
 
-std::vector<std::byte> UnkownBody::serialize() {
-  auto body_header = Body::serialize();
-  std::vector<std::byte> tmp;
-  tmp.insert(tmp.end(), body_header.begin(), body_header.end());
-  tmp.insert(tmp.end(), m_content.begin(), m_content.end());
-  return tmp;
+size_t UnkownBody::serialize_into(std::span<std::byte> buffer) const {
+  auto pos = serialize_header_into(buffer);
+  std::copy(m_content.begin(), m_content.end(), buffer.begin() + pos);
+  return pos + m_content.size();
+}
+
+BodyView decode_body(BufferView<std::byte *> buffer_view) {
+  auto body = decode_body_header(buffer_view);
+  return BODY_TYPES.at(body.type).decode(body.content);
+}
+
+PackageView::PackageView(BufferView<std::byte *> buffer_view)
+    : m_header(
+          BufferView(buffer_view.begin(), buffer_view.begin() + HEADER_SIZE)),
+      m_body(UnkownBodyView{buffer_view}) {
+  if (buffer_view.distance() < get_size()) {
+    throw std::invalid_argument("Package shorter than its header announces");
+  }
+  m_body = decode_body(
+      BufferView(buffer_view.begin() + HEADER_SIZE,
+                 buffer_view.begin() + static_cast<int64_t>(get_size())));
 }
 } // namespace sls3mcubridge::tcp
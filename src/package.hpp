@@ -1,11 +1,13 @@
 #pragma once
 
-#include "libremidi/message.hpp"
+#include "midimessage.hpp"
 
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <memory>
+#include <span>
+#include <variant>
 #include <vector>
 
 namespace sls3mcubridge::tcp {
@@ -14,12 +16,23 @@ const int HEADER_SIZE = 6;
 const std::byte HEADER_FIRST_BYTE = std::byte('U');
 const std::byte HEADER_SECOND_BYTE = std::byte('C');
 const std::byte HEADER_UNKOWN_BYTE = std::byte(0x01);
+// The body size is a 16 bit little endian field of the header.
+const size_t MAX_BODY_SIZE = UINT16_MAX;
+const size_t MAX_PACKAGE_SIZE = HEADER_SIZE + MAX_BODY_SIZE;
+// Body header, device, delimiter and 16 bit length in front of a SysEx
+// message, nothing follows it.
+const size_t SYSEX_BODY_OVERHEAD = 8;
+// Longest SysEx payload sent to the mixer in one body, as much as the body
+// size field allows. Longer messages are sent as consecutive bodies.
+const size_t MAX_SYSEX_FRAGMENT_SIZE = MAX_BODY_SIZE - SYSEX_BODY_OVERHEAD;
 
 template <class Iterator> class BufferView {
 
 public:
   BufferView(Iterator begin, Iterator end) : m_begin(begin), m_end(end) {}
-  size_t distance() { return std::distance(m_begin, m_end); }
+  [[nodiscard]] size_t distance() const {
+    return std::distance(m_begin, m_end);
+  }
   [[nodiscard]] Iterator begin() const { return m_begin; }
   [[nodiscard]] Iterator end() const { return m_end; }
 
@@ -36,7 +49,14 @@ public:
   ISerialize &operator=(const ISerialize &obj) = delete;
   ISerialize &operator=(ISerialize &&obj) = delete;
 
-  virtual std::vector<std::byte> serialize() = 0;
+  virtual std::vector<std::byte> serialize();
+
+  // Exact number of bytes serialize_into() writes.
+  [[nodiscard]] virtual size_t serialized_size() const = 0;
+  // Writes the serialized bytes into a caller supplied buffer and returns the
+  // number of bytes written. Throws std::length_error when the buffer is
+  // smaller than serialized_size().
+  virtual size_t serialize_into(std::span<std::byte> buffer) const = 0;
 
 protected:
   ISerialize() = default;
@@ -46,8 +66,8 @@ class MidiDeviceIndicator {
 public:
   explicit MidiDeviceIndicator(const std::byte device_byte)
       : m_device_byte(device_byte) {}
-  int get_index();
-  std::byte get_byte() { return m_device_byte; }
+  [[nodiscard]] int get_index() const;
+  [[nodiscard]] std::byte get_byte() const { return m_device_byte; }
 
 private:
   std::byte m_device_byte;
@@ -57,15 +77,17 @@ class Header : public ISerialize {
 public:
   explicit Header(BufferView<std::byte *> buffer_view);
   explicit Header() = default;
-  std::vector<std::byte> serialize() override;
+  [[nodiscard]] size_t serialized_size() const override { return HEADER_SIZE; }
+  size_t serialize_into(std::span<std::byte> buffer) const override;
   [[nodiscard]] size_t get_body_size() const { return m_body_size; }
-  void set_body_size(size_t size) { m_body_size = static_cast<uint8_t>(size); }
+  // Throws std::length_error when `size` does not fit in the size field.
+  void set_body_size(size_t size);
 
 private:
-  uint8_t m_body_size = 0;
+  uint16_t m_body_size = 0;
 };
 
-class Body : ISerialize {
+class Body : public ISerialize {
 public:
   enum Type : uint8_t {
     Unkown,
@@ -76,9 +98,12 @@ public:
   };
 
   static const int BODY_HEADER_SIZE = 4;
-  std::vector<std::byte> serialize() override;
+  [[nodiscard]] size_t serialized_size() const override { return m_size; }
 
   static std::shared_ptr<Body> create(BufferView<std::byte *> buffer_view);
+  static Type type_from_int(uint16_t type_int);
+  // Size of a body of the given type without payload.
+  static size_t fixed_size(Type type);
   [[nodiscard]] const Type &get_type() const { return m_type; }
   [[nodiscard]] const size_t &get_size() const { return m_size; }
 
@@ -86,56 +111,69 @@ protected:
   Body(Body::Type type, size_t size) : m_type(type), m_size(size) {}
   // TODO(ruud): find solution to remove set_size
   void set_size(const size_t &size) { m_size = size; }
+  // Writes the body header followed by the fixed fields of the body type,
+  // `value` is used for a message count or length field.
+  size_t serialize_header_into(std::span<std::byte> buffer, std::byte device,
+                               size_t value) const;
+  size_t serialize_header_into(std::span<std::byte> buffer) const;
+  // Writes the fixed fields behind a payload ending at `pos`.
+  size_t serialize_trailer_into(std::span<std::byte> buffer, size_t pos) const;
 
 private:
-  static uint16_t find_type_in_map(Type type);
-
   Type m_type;
   size_t m_size;
 };
 
 class IncommingMidiBody : public Body {
 public:
-  IncommingMidiBody(const std::byte device, const libremidi::message &message)
-      : Body(Body::Type::IncommingMidi, BODY_HEADER_SIZE + 3 + message.size()),
+  IncommingMidiBody(const std::byte device, const ShortMessage &message)
+      : Body(Body::Type::IncommingMidi,
+             fixed_size(Body::Type::IncommingMidi) + message.size()),
         m_device(device), m_message(message) {}
   explicit IncommingMidiBody(BufferView<std::byte *> buffer_view);
-  std::vector<std::byte> serialize() override;
+  size_t serialize_into(std::span<std::byte> buffer) const override;
   int get_device_index() { return m_device.get_index(); }
-  libremidi::message &get_message() { return m_message; }
+  const ShortMessage &get_message() { return m_message; }
 
 private:
   MidiDeviceIndicator m_device;
-  libremidi::message m_message;
+  ShortMessage m_message;
 };
 
+// Channel messages for the mixer. Refers to the messages without copying them,
+// they have to outlive the body. A body parsed from a buffer holds its
+// messages itself.
 class OutgoingMidiBody : public Body {
 public:
-  OutgoingMidiBody(std::byte device,
-                   const std::vector<libremidi::message> &message);
+  OutgoingMidiBody(std::byte device, std::span<const ShortMessage> messages);
   explicit OutgoingMidiBody(BufferView<std::byte *> buffer_view);
-  std::vector<std::byte> serialize() override;
+  size_t serialize_into(std::span<std::byte> buffer) const override;
   int get_device_index() { return m_device.get_index(); }
-  const std::vector<libremidi::message> &get_messages() { return m_messages; }
+  std::span<const ShortMessage> get_messages() { return m_messages; }
 
 private:
   MidiDeviceIndicator m_device;
-  std::vector<libremidi::message> m_messages;
+  std::span<const ShortMessage> m_messages;
+  // Only used by a parsed body.
+  std::vector<ShortMessage> m_parsed;
 };
 
+// A SysEx message, or one fragment of a message too long for one body. Refers
+// to the bytes of the message without copying them, the message, or the
+// buffer it is parsed from, has to outlive the body.
 class SysExMidiBody : public Body {
 public:
-  SysExMidiBody(std::byte device, const libremidi::message &message)
-      : Body(Body::Type::SysEx, BODY_HEADER_SIZE + 4 + message.size()),
+  SysExMidiBody(std::byte device, std::span<const std::byte> message)
+      : Body(Body::Type::SysEx, fixed_size(Body::Type::SysEx) + message.size()),
         m_device(device), m_message(message) {}
   explicit SysExMidiBody(BufferView<std::byte *> buffer_view);
-  std::vector<std::byte> serialize() override;
+  size_t serialize_into(std::span<std::byte> buffer) const override;
   int get_device_index() { return m_device.get_index(); }
-  const libremidi::message &get_message() { return m_message; }
+  std::span<const std::byte> get_message() { return m_message; }
 
 private:
   MidiDeviceIndicator m_device;
-  libremidi::message m_message;
+  std::span<const std::byte> m_message;
 };
 
 class InitialResponseBody : public Body {
@@ -144,7 +182,7 @@ public:
       : Body(Body::Type::InitialResponse,
              BODY_HEADER_SIZE + buffer_view.distance()),
         m_content(buffer_view.begin(), buffer_view.end()) {}
-  std::vector<std::byte> serialize() override;
+  size_t serialize_into(std::span<std::byte> buffer) const override;
   std::vector<std::byte> get_content() { return m_content; }
   uint8_t get_nr_of_midi_devices();
 
@@ -157,21 +195,22 @@ public:
   explicit UnkownBody(BufferView<std::byte *> buffer_view)
       : Body(Body::Type::Unkown, BODY_HEADER_SIZE + buffer_view.distance()),
         m_content(buffer_view.begin(), buffer_view.end()) {}
-  std::vector<std::byte> serialize() override;
+  size_t serialize_into(std::span<std::byte> buffer) const override;
   std::vector<std::byte> get_content() { return m_content; }
 
 private:
   std::vector<std::byte> m_content;
 };
 
-class Package : ISerialize {
+class Package : public ISerialize {
 public:
   explicit Package(BufferView<std::byte *> buffer_view);
   explicit Package(std::shared_ptr<Body> &body) : m_body(body) {
     m_header.set_body_size(body->get_size());
   }
   static std::byte index_to_midi_device_byte(int index);
-  std::vector<std::byte> serialize() override;
+  [[nodiscard]] size_t serialized_size() const override { return get_size(); }
+  size_t serialize_into(std::span<std::byte> buffer) const override;
   std::shared_ptr<Body> get_body() { return m_body; }
   [[nodiscard]] size_t get_size() const {
     return HEADER_SIZE + m_body->get_size();
@@ -181,4 +220,59 @@ private:
   Header m_header;
   std::shared_ptr<Body> m_body;
 };
+
+// Non-owning views over a received body. Decoding a view only validates the
+// buffer, nothing is copied and nothing is allocated. A view is valid as long
+// as the buffer it was decoded from.
+struct UnkownBodyView {
+  BufferView<std::byte *> content;
+};
+
+struct InitialResponseBodyView {
+  BufferView<std::byte *> content;
+};
+
+struct IncommingMidiBodyView {
+  MidiDeviceIndicator device;
+  BufferView<std::byte *> message;
+};
+
+struct OutgoingMidiBodyView {
+  static const int MESSAGE_SIZE = 3;
+  MidiDeviceIndicator device;
+  BufferView<std::byte *> messages;
+  [[nodiscard]] size_t get_nr_of_messages() const {
+    return messages.distance() / MESSAGE_SIZE;
+  }
+};
+
+struct SysExMidiBodyView {
+  MidiDeviceIndicator device;
+  BufferView<std::byte *> message;
+};
+
+// Alternatives are ordered like Body::Type, so index() is the body type.
+using BodyView =
+    std::variant<UnkownBodyView, InitialResponseBodyView, IncommingMidiBodyView,
+                 OutgoingMidiBodyView, SysExMidiBodyView>;
+
+BodyView decode_body(BufferView<std::byte *> buffer_view);
+
+class PackageView {
+public:
+  explicit PackageView(BufferView<std::byte *> buffer_view);
+  [[nodiscard]] Body::Type get_type() const {
+    return static_cast<Body::Type>(m_body.index());
+  }
+  template <class T> [[nodiscard]] const T &get_body() const {
+    return std::get<T>(m_body);
+  }
+  [[nodiscard]] size_t get_size() const {
+    return HEADER_SIZE + m_header.get_body_size();
+  }
+
+private:
+  Header m_header;
+  BodyView m_body;
+};
 } // namespace sls3mcubridge::tcp
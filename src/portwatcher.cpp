@@ -0,0 +1,118 @@
+#include "portwatcher.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/awaitable.hpp"
+#include "asio/post.hpp"
+#include "asio/redirect_error.hpp"
+#include "asio/use_awaitable.hpp"
+#include "libremidi/libremidi.hpp"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace sls3mcubridge {
+
+MidiPortWatcher::MidiPortWatcher(const asio::any_io_executor &executor)
+    : m_executor(executor), m_changed(executor) {}
+
+void MidiPortWatcher::start() {
+  // Called on a thread of the midi backend.
+  auto on_port = [self = weak_from_this(),
+                  executor = m_executor](const std::string &name) {
+    asio::post(executor, [self, name]() {
+      if (auto watcher = self.lock()) {
+        watcher->announced(name);
+      }
+    });
+  };
+  auto on_removed = [self = weak_from_this(),
+                     executor = m_executor](const std::string &name) {
+    asio::post(executor, [self, name]() {
+      if (auto watcher = self.lock()) {
+        watcher->removed(name);
+      }
+    });
+  };
+  libremidi::observer_configuration config;
+  config.on_error = [](libremidi::midi_error error, std::string_view str) {
+    spdlog::warn("Midi port observer error: " + std::to_string(error) + ": " +
+                 std::string(str));
+  };
+  config.input_added = [on_port](const libremidi::input_port &port) {
+    on_port(port.port_name);
+  };
+  config.output_added = [on_port](const libremidi::output_port &port) {
+    on_port(port.port_name);
+  };
+  config.input_removed = [on_removed](const libremidi::input_port &port) {
+    on_removed(port.port_name);
+  };
+  config.output_removed = [on_removed](const libremidi::output_port &port) {
+    on_removed(port.port_name);
+  };
+  // The ports of the bridge and of the DAW are virtual ports.
+  config.track_hardware = 0;
+  config.track_virtual = 1;
+  config.notify_in_constructor = 0;
+  m_observer.emplace(config);
+}
+
+void MidiPortWatcher::stop() {
+  m_observer.reset();
+  m_changed.cancel();
+}
+
+asio::awaitable<bool>
+MidiPortWatcher::wait_for(std::string name,
+                          std::chrono::milliseconds timeout) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!is_announced(name)) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      co_return false;
+    }
+    m_changed.expires_at(deadline);
+    asio::error_code error;
+    co_await m_changed.async_wait(
+        asio::redirect_error(asio::use_awaitable, error));
+  }
+  co_return true;
+}
+
+void MidiPortWatcher::announced(const std::string &name) {
+  spdlog::debug("Midi port announced: " + name);
+  m_announced.push_back(name);
+  m_changed.cancel();
+  auto removed = std::find(m_removed.begin(), m_removed.end(), name);
+  if (removed == m_removed.end()) {
+    return;
+  }
+  m_removed.erase(removed);
+  if (m_reappear_handler) {
+    m_reappear_handler(name);
+  }
+}
+
+void MidiPortWatcher::removed(const std::string &name) {
+  spdlog::debug("Midi port removed: " + name);
+  auto announced = std::find(m_announced.begin(), m_announced.end(), name);
+  if (announced != m_announced.end()) {
+    m_announced.erase(announced);
+  }
+  // An input and an output port of the same name are removed together.
+  if (std::find(m_removed.begin(), m_removed.end(), name) == m_removed.end()) {
+    m_removed.push_back(name);
+  }
+}
+
+bool MidiPortWatcher::is_announced(const std::string &name) const {
+  return std::any_of(m_announced.begin(), m_announced.end(),
+                     [&name](const std::string &announced) {
+                       return announced.find(name) != std::string::npos;
+                     });
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "asio/any_io_executor.hpp"
+#include "asio/awaitable.hpp"
+#include "asio/steady_timer.hpp"
+#include "libremidi/libremidi.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Follows the midi ports announced by the midi backend, to know when a virtual
+// port opened by the bridge is visible to the DAW and when the ports of a DAW
+// come back after it restarted.
+class MidiPortWatcher : public std::enable_shared_from_this<MidiPortWatcher> {
+public:
+  explicit MidiPortWatcher(const asio::any_io_executor &executor);
+  // Starts following the backend, announcements before start() are missed.
+  void start();
+  // Stops following the backend.
+  void stop();
+
+  // Waits until a port with `name` in its name was announced. Returns false
+  // when that did not happen within `timeout`, e.g. on backends that do not
+  // announce virtual ports. Only one wait at a time.
+  asio::awaitable<bool> wait_for(std::string name,
+                                 std::chrono::milliseconds timeout);
+  // Called on the executor with the name of a port that is announced again
+  // after it was removed.
+  void set_reappear_handler(std::function<void(const std::string &)> handler) {
+    m_reappear_handler = std::move(handler);
+  }
+
+private:
+  void announced(const std::string &name);
+  void removed(const std::string &name);
+  [[nodiscard]] bool is_announced(const std::string &name) const;
+
+  asio::any_io_executor m_executor;
+  // Cancelled on every announcement to wake up wait_for().
+  asio::steady_timer m_changed;
+  std::vector<std::string> m_announced;
+  // Ports removed and not announced again since.
+  std::vector<std::string> m_removed;
+  std::function<void(const std::string &)> m_reappear_handler;
+  std::optional<libremidi::observer> m_observer;
+};
+
+} // namespace sls3mcubridge
@@ -0,0 +1,104 @@
+#include "realtime.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace sls3mcubridge {
+
+namespace {
+size_t page_size() { return static_cast<size_t>(sysconf(_SC_PAGESIZE)); }
+
+// Writes one byte per page, through a volatile pointer so the writes are kept.
+void touch(unsigned char *begin, size_t size) {
+  volatile unsigned char *page = begin;
+  for (size_t i = 0; i < size; i += page_size()) {
+    page[i] = 0; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  }
+}
+
+bool report(int error, const std::string &step) {
+  if (error != 0) {
+    spdlog::warn("Realtime: failed to " + step + ": " + std::strerror(error));
+    return false;
+  }
+  spdlog::info("Realtime: " + step);
+  return true;
+}
+
+std::string to_string(const std::vector<int> &cpus) {
+  std::string output;
+  for (auto cpu : cpus) {
+    output += (output.empty() ? "" : ",") + std::to_string(cpu);
+  }
+  return output;
+}
+} // namespace
+
+bool make_thread_realtime(const RealtimeConfig &config,
+                          const std::string &thread) {
+  bool succeeded = true;
+  if (!config.cpus.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    int error = 0;
+    for (auto cpu : config.cpus) {
+      if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        error = EINVAL;
+        break;
+      }
+      CPU_SET(cpu, &cpus);
+    }
+    if (error == 0) {
+      error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    succeeded &= report(error, "pin " + thread + " to cpus " +
+                                   to_string(config.cpus));
+  }
+
+  sched_param param{};
+  param.sched_priority = config.priority;
+  succeeded &=
+      report(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param),
+             "run " + thread + " with SCHED_FIFO priority " +
+                 std::to_string(config.priority));
+  return succeeded;
+}
+
+bool lock_memory() {
+  return report(mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? 0 : errno,
+                "lock memory");
+}
+
+bool prefault_heap(size_t size) {
+  // Freed memory stays in the heap instead of going back to the system, and
+  // large allocations come from the heap instead of their own mapping.
+  if (mallopt(M_TRIM_THRESHOLD, -1) == 0 || mallopt(M_MMAP_MAX, 0) == 0) {
+    return report(EINVAL, "keep the heap mapped");
+  }
+  auto *heap = static_cast<unsigned char *>(std::malloc(size)); // NOLINT
+  if (heap == nullptr) {
+    return report(ENOMEM, "prefault " + std::to_string(size) + " heap bytes");
+  }
+  touch(heap, size);
+  std::free(heap); // NOLINT
+  return report(0, "prefault " + std::to_string(size) + " heap bytes");
+}
+
+void prefault_stack() {
+  std::array<unsigned char, PREFAULT_STACK_SIZE> stack;
+  touch(stack.data(), stack.size());
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Bytes of its stack a realtime thread touches up front.
+const size_t PREFAULT_STACK_SIZE = 256 * 1024;
+
+// Scheduling of the threads moving the traffic, the io_context threads and
+// the midi input threads of the backend.
+struct RealtimeConfig {
+  // SCHED_FIFO priority, from 1 to 99.
+  int priority = 70;
+  // CPUs the threads may run on, empty keeps the inherited affinity.
+  std::vector<int> cpus;
+};
+
+// Every step logs whether it succeeded and returns false when it did not,
+// most steps need CAP_SYS_NICE / CAP_IPC_LOCK or matching rlimits. A failed
+// step leaves the process as it was, the bridge keeps working without it.
+
+// Pins the calling thread to the configured CPUs and runs it with SCHED_FIFO
+// at the configured priority. `thread` names it in the log.
+bool make_thread_realtime(const RealtimeConfig &config,
+                          const std::string &thread);
+// Locks all current and future pages of the process in memory, so buffers
+// allocated and zeroed up front, like those of Client and MidiCoalescer, never
+// fault again.
+bool lock_memory();
+// Grows the heap by `size` bytes, touches it and keeps it mapped after
+// freeing, so later allocations are served from resident pages.
+bool prefault_heap(size_t size);
+// Touches PREFAULT_STACK_SIZE bytes of the stack of the calling thread.
+void prefault_stack();
+
+} // namespace sls3mcubridge
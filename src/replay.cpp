@@ -0,0 +1,122 @@
+#include "replay.hpp"
+
+#include "capture.hpp"
+#include "client.hpp"
+#include "package.hpp"
+
+#include "asio/post.hpp"
+#include "libremidi/message.hpp"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace sls3mcubridge {
+
+Replay::Replay(const asio::any_io_executor &executor, const std::string &path,
+               double speed, PackageCallback on_package, MidiCallback on_midi)
+    : m_executor(executor), m_reader(path), m_timer(executor),
+      m_speed(speed), m_on_package(std::move(on_package)),
+      m_on_midi(std::move(on_midi)), m_framer(MAX_BUFFER_SIZE, true) {}
+
+void Replay::start() {
+  spdlog::info("Replaying capture");
+  m_start = std::chrono::steady_clock::now();
+  schedule_next();
+}
+
+void Replay::schedule_next() {
+  if (!m_reader.next(m_record)) {
+    spdlog::info("Replay finished after " + std::to_string(m_replayed) +
+                 " records");
+    return;
+  }
+
+  if (m_speed <= 0) {
+    // Posted so traffic of the bridge itself is handled in between.
+    asio::post(m_executor, [self = shared_from_this()]() {
+      self->replay_record();
+      self->schedule_next();
+    });
+    return;
+  }
+
+  auto offset =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double, std::nano>(
+              static_cast<double>(m_record.timestamp.count()) / m_speed));
+  m_timer.expires_at(m_start + offset);
+  m_timer.async_wait(
+      [self = shared_from_this()](const asio::error_code &error) {
+        if (!error) {
+          self->replay_record();
+          self->schedule_next();
+        }
+      });
+}
+
+void Replay::replay_record() {
+  m_replayed++;
+  switch (m_record.source) {
+  case CaptureSource::TcpRead:
+    replay_tcp_read();
+    break;
+  case CaptureSource::MidiFromDaw: {
+    libremidi::message message;
+    for (const auto &iter : m_record.data) {
+      message.bytes.push_back(std::to_integer<unsigned char>(iter));
+    }
+    try {
+      m_on_midi(m_record.device, message);
+    } catch (const std::exception &exc) {
+      spdlog::warn("Replay midi callback failure: " + std::string(exc.what()));
+    }
+    break;
+  }
+  case CaptureSource::TcpWrite:
+  case CaptureSource::MidiToDaw:
+  default:
+    break;
+  }
+}
+
+void Replay::replay_tcp_read() {
+  const auto *source = m_record.data.data();
+  auto remaining = m_record.data.size();
+  auto skipped_bytes = m_framer.get_skipped_bytes();
+  while (remaining > 0) {
+    auto free_space = m_framer.prepare();
+    auto size = std::min(remaining, free_space.distance());
+    std::copy(source, source + size, free_space.begin());
+    source += size;
+    remaining -= size;
+    m_framer.commit(size);
+    try {
+      while (auto frame = m_framer.next_frame()) {
+        try {
+          auto package = tcp::PackageView(*frame);
+          m_on_package(package);
+        } catch (const std::exception &exc) {
+          spdlog::warn("Replay package callback failure: " +
+                       std::string(exc.what()));
+        }
+      }
+    } catch (const std::exception &exc) {
+      spdlog::warn("Replay parse failure: " + std::string(exc.what()));
+      m_framer.reset();
+    }
+    m_framer.compact();
+  }
+  if (m_framer.get_skipped_bytes() != skipped_bytes) {
+    spdlog::warn("Replay skipped " +
+                 std::to_string(m_framer.get_skipped_bytes() - skipped_bytes) +
+                 " corrupt bytes");
+  }
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "capture.hpp"
+#include "framer.hpp"
+
+#include "asio/any_io_executor.hpp"
+#include "asio/steady_timer.hpp"
+#include "libremidi/message.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace sls3mcubridge {
+namespace tcp {
+class PackageView;
+} // namespace tcp
+
+// Feeds a capture back through the package parser and the bridge. Bytes read
+// from the mixer are framed and parsed like Client does and handed to the
+// package callback, midi messages from the DAW go to the midi callback. The
+// traffic the bridge sent is not replayed.
+class Replay : public std::enable_shared_from_this<Replay> {
+public:
+  using PackageCallback = std::function<void(tcp::PackageView &)>;
+  using MidiCallback = std::function<void(int, const libremidi::message &)>;
+
+  // Records are replayed at their captured time divided by `speed`, a speed
+  // of 0 replays them as fast as possible.
+  Replay(const asio::any_io_executor &executor, const std::string &path,
+         double speed, PackageCallback on_package, MidiCallback on_midi);
+  void start();
+  [[nodiscard]] size_t get_replayed() const { return m_replayed; }
+
+private:
+  void schedule_next();
+  void replay_record();
+  void replay_tcp_read();
+
+  asio::any_io_executor m_executor;
+  CaptureReader m_reader;
+  asio::steady_timer m_timer;
+  double m_speed;
+  PackageCallback m_on_package;
+  MidiCallback m_on_midi;
+  tcp::StreamFramer m_framer;
+  CaptureRecord m_record;
+  std::chrono::steady_clock::time_point m_start;
+  size_t m_replayed = 0;
+};
+
+} // namespace sls3mcubridge
@@ -0,0 +1,205 @@
+#include "surfacestate.hpp"
+
+#include "midimessage.hpp"
+#include "package.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace sls3mcubridge {
+
+const uint8_t VPOT_RING_FIRST_CONTROLLER = 0x30;
+const uint8_t DIGIT_FIRST_CONTROLLER = 0x40;
+// Displays and rings power up blank, 7-segment digits and the LCD show spaces.
+const uint8_t BLANK = 0x20;
+
+// F0 00 00 66 <model> 12 <offset> <characters> F7
+const std::array<uint8_t, 3> MACKIE_MANUFACTURER = {0x00, 0x00, 0x66};
+const uint8_t MACKIE_CONTROL_MODEL = 0x14;
+const uint8_t LCD_COMMAND = 0x12;
+const size_t LCD_HEADER_SIZE = 7;
+const size_t MODEL_POSITION = 4;
+const size_t COMMAND_POSITION = 5;
+const size_t OFFSET_POSITION = 6;
+// Bytes an LCD message costs on top of its characters once sent as a package.
+const size_t LCD_MESSAGE_OVERHEAD =
+    LCD_HEADER_SIZE + 1 + tcp::HEADER_SIZE +
+    tcp::Body::fixed_size(tcp::Body::Type::SysEx);
+
+SurfaceState::SurfaceState() : m_lcd_model(MACKIE_CONTROL_MODEL) {
+  m_digits.fill(BLANK);
+  m_lcd.fill(BLANK);
+}
+
+void SurfaceState::update_from_daw(std::span<const unsigned char> message) {
+  if (message.empty()) {
+    return;
+  }
+  if (message[0] == SYSEX_START) {
+    write_lcd(message, nullptr);
+    return;
+  }
+  if (message.size() != CHANNEL_MESSAGE_SIZE) {
+    return;
+  }
+  auto status = static_cast<uint8_t>(message[0] & STATUS_MASK);
+  auto channel = static_cast<size_t>(message[0] & CHANNEL_MASK);
+  switch (status) {
+  case PITCH_BEND:
+    if (channel < NR_OF_FADERS) {
+      m_faders.at(channel) =
+          static_cast<uint16_t>(message[1] | (message[2] << DATA_BITS));
+    }
+    break;
+  case NOTE_ON:
+    m_leds.at(message[1] & DATA_MASK) = message[2];
+    break;
+  case NOTE_OFF:
+    m_leds.at(message[1] & DATA_MASK) = 0;
+    break;
+  case CONTROL_CHANGE: {
+    auto controller = static_cast<size_t>(message[1]);
+    if (controller >= VPOT_RING_FIRST_CONTROLLER &&
+        controller < VPOT_RING_FIRST_CONTROLLER + NR_OF_VPOT_RINGS) {
+      m_vpot_rings.at(controller - VPOT_RING_FIRST_CONTROLLER) = message[2];
+    } else if (controller >= DIGIT_FIRST_CONTROLLER &&
+               controller < DIGIT_FIRST_CONTROLLER + NR_OF_DIGITS) {
+      m_digits.at(controller - DIGIT_FIRST_CONTROLLER) = message[2];
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+bool SurfaceState::is_lcd_message(std::span<const unsigned char> message) {
+  return message.size() > LCD_HEADER_SIZE && message[0] == SYSEX_START &&
+         message[message.size() - 1] == SYSEX_END &&
+         message[1] == MACKIE_MANUFACTURER[0] &&
+         message[2] == MACKIE_MANUFACTURER[1] &&
+         message[3] == MACKIE_MANUFACTURER[2] &&
+         message[COMMAND_POSITION] == LCD_COMMAND;
+}
+
+bool SurfaceState::diff_lcd(std::span<const unsigned char> message,
+                            MessageRun &updates) {
+  return write_lcd(message, &updates);
+}
+
+bool SurfaceState::write_lcd(std::span<const unsigned char> message,
+                             MessageRun *updates) {
+  if (!is_lcd_message(message)) {
+    return false;
+  }
+  m_lcd_model = message[MODEL_POSITION];
+  // Changed characters not written yet.
+  size_t begin = 0;
+  size_t end = 0;
+  auto position = static_cast<size_t>(message[OFFSET_POSITION]);
+  for (size_t i = LCD_HEADER_SIZE; i < message.size() - 1; i++, position++) {
+    if (position >= LCD_SIZE) {
+      break;
+    }
+    if (m_lcd_known.test(position) && m_lcd.at(position) == message[i]) {
+      continue;
+    }
+    m_lcd.at(position) = message[i];
+    m_lcd_known.set(position);
+    if (updates == nullptr) {
+      continue;
+    }
+    if (begin == end) {
+      begin = position;
+    } else if (position - end > LCD_MESSAGE_OVERHEAD) {
+      append_lcd_message(begin, end, *updates);
+      begin = position;
+    }
+    end = position + 1;
+  }
+  if (begin != end) {
+    append_lcd_message(begin, end, *updates);
+  }
+  return true;
+}
+
+void SurfaceState::append_lcd_message(size_t begin, size_t end,
+                                      MessageRun &messages) const {
+  // Built on the stack, the run copies it into its SysEx buffer.
+  std::array<uint8_t, LCD_HEADER_SIZE + LCD_SIZE + 1> lcd = {
+      SYSEX_START,
+      MACKIE_MANUFACTURER[0],
+      MACKIE_MANUFACTURER[1],
+      MACKIE_MANUFACTURER[2],
+      m_lcd_model,
+      LCD_COMMAND,
+      static_cast<uint8_t>(begin)};
+  auto last = std::copy(m_lcd.begin() + begin, m_lcd.begin() + end,
+                        lcd.begin() + LCD_HEADER_SIZE);
+  *last = SYSEX_END;
+  messages.push_back(std::span(lcd).first(LCD_HEADER_SIZE + end - begin + 1));
+}
+
+void SurfaceState::update_from_surface(std::span<const std::byte> message) {
+  if (message.size() != CHANNEL_MESSAGE_SIZE) {
+    return;
+  }
+  auto status = std::to_integer<uint8_t>(message[0]);
+  auto channel = static_cast<size_t>(status & CHANNEL_MASK);
+  if ((status & STATUS_MASK) == PITCH_BEND && channel < NR_OF_FADERS) {
+    m_faders.at(channel) =
+        static_cast<uint16_t>(std::to_integer<uint16_t>(message[1]) |
+                              (std::to_integer<uint16_t>(message[2])
+                               << DATA_BITS));
+  }
+}
+
+void SurfaceState::replay(MessageRun &messages) const {
+  size_t first = 0;
+  size_t last = LCD_SIZE;
+  while (first < LCD_SIZE && m_lcd.at(first) == BLANK) {
+    first++;
+  }
+  while (last > first && m_lcd.at(last - 1) == BLANK) {
+    last--;
+  }
+  if (first < last) {
+    // One message for the whole changed range, instead of one per update.
+    append_lcd_message(first, last, messages);
+  }
+
+  for (size_t i = 0; i < NR_OF_DIGITS; i++) {
+    if (m_digits.at(i) != BLANK) {
+      messages.push_back(ShortMessage(
+          {CONTROL_CHANGE, static_cast<uint8_t>(DIGIT_FIRST_CONTROLLER + i),
+           m_digits.at(i)}));
+    }
+  }
+  for (size_t i = 0; i < NR_OF_VPOT_RINGS; i++) {
+    if (m_vpot_rings.at(i) != 0) {
+      messages.push_back(ShortMessage(
+          {CONTROL_CHANGE, static_cast<uint8_t>(VPOT_RING_FIRST_CONTROLLER + i),
+           m_vpot_rings.at(i)}));
+    }
+  }
+  for (size_t note = 0; note < NR_OF_LEDS; note++) {
+    if (m_leds.at(note) != 0) {
+      messages.push_back(ShortMessage(
+          {NOTE_ON, static_cast<uint8_t>(note), m_leds.at(note)}));
+    }
+  }
+  for (size_t i = 0; i < NR_OF_FADERS; i++) {
+    if (m_faders.at(i) != 0) {
+      messages.push_back(ShortMessage(
+          {static_cast<uint8_t>(PITCH_BEND | i),
+           static_cast<uint8_t>(m_faders.at(i) & DATA_MASK),
+           static_cast<uint8_t>(m_faders.at(i) >> DATA_BITS)}));
+    }
+  }
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "midimessage.hpp"
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Mirror of the Mackie Control surface of one midi device: fader positions,
+// button LEDs, V-pot rings, the timecode and assignment digits and the LCD.
+// Updated from the messages the DAW sends to the surface and the fader moves
+// of the surface, so the surface can be brought back to the state the DAW
+// expects without waiting for the DAW to resend it. Meters and button presses
+// are transient and not mirrored. Only to be used on the executor of the
+// bridge, a strand when the io_context is run by several threads.
+class SurfaceState {
+public:
+  // 8 channel strips and the master fader.
+  static const size_t NR_OF_FADERS = 9;
+  static const size_t NR_OF_LEDS = 128;
+  static const size_t NR_OF_VPOT_RINGS = 8;
+  // 10 timecode digits followed by the 2 assignment digits.
+  static const size_t NR_OF_DIGITS = 12;
+  // Two lines of 56 characters.
+  static const size_t LCD_SIZE = 112;
+
+  SurfaceState();
+
+  // Updates the mirror from a message of the DAW to the surface.
+  void update_from_daw(std::span<const unsigned char> message);
+  // Updates the fader positions from a message of the surface to the DAW.
+  void update_from_surface(std::span<const std::byte> message);
+
+  // Updates the LCD from an LCD message of the DAW and appends messages that
+  // only write the characters that changed, nothing when none did. Changed
+  // characters close to each other share a message when that is shorter than
+  // a message per run. Returns false without appending when `message` is no
+  // LCD message.
+  bool diff_lcd(std::span<const unsigned char> message, MessageRun &updates);
+  // Treats the characters the surface shows as unknown, e.g. after the mixer
+  // rebooted. diff_lcd() writes unknown characters even when unchanged.
+  void forget_lcd() { m_lcd_known.reset(); }
+
+  // Appends the messages that recreate every part of the mirror differing from
+  // a surface that just powered up: blank displays, dark LEDs and rings and
+  // faders at the bottom. The faders come last, after the displays.
+  void replay(MessageRun &messages) const;
+
+  [[nodiscard]] uint16_t get_fader(size_t fader) const {
+    return m_faders.at(fader);
+  }
+  [[nodiscard]] uint8_t get_led(size_t note) const { return m_leds.at(note); }
+  [[nodiscard]] const std::array<uint8_t, LCD_SIZE> &get_lcd() const {
+    return m_lcd;
+  }
+
+private:
+  [[nodiscard]] static bool
+  is_lcd_message(std::span<const unsigned char> message);
+  // Appends the changed characters to `updates` when not null.
+  bool write_lcd(std::span<const unsigned char> message, MessageRun *updates);
+  void append_lcd_message(size_t begin, size_t end,
+                          MessageRun &messages) const;
+
+  // 14 bit pitch bend values.
+  std::array<uint16_t, NR_OF_FADERS> m_faders{};
+  // Note velocities: off, blinking or on.
+  std::array<uint8_t, NR_OF_LEDS> m_leds{};
+  std::array<uint8_t, NR_OF_VPOT_RINGS> m_vpot_rings{};
+  std::array<uint8_t, NR_OF_DIGITS> m_digits{};
+  std::array<uint8_t, LCD_SIZE> m_lcd{};
+  // Characters written since forget_lcd().
+  std::bitset<LCD_SIZE> m_lcd_known;
+  // Mackie model id of the last LCD message, reused for the replay.
+  uint8_t m_lcd_model;
+};
+
+} // namespace sls3mcubridge
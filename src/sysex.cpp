@@ -0,0 +1,55 @@
+#include "sysex.hpp"
+
+#include "midimessage.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace sls3mcubridge {
+
+// Incomplete messages growing beyond this are dropped instead of waiting for
+// an end that may never come.
+const size_t MAX_ASSEMBLED_SIZE = 1048576;
+
+std::span<const std::byte>
+SysExAssembler::add(std::span<const std::byte> fragment) {
+  if (m_complete) {
+    m_buffer.clear();
+    m_complete = false;
+  }
+  if (fragment.empty()) {
+    return {};
+  }
+  bool starts = fragment.front() == std::byte(SYSEX_START);
+  bool ends = fragment.back() == std::byte(SYSEX_END);
+  if (starts) {
+    if (!m_buffer.empty()) {
+      spdlog::warn("Dropped an incomplete SysEx message of " +
+                   std::to_string(m_buffer.size()) + " bytes");
+      m_buffer.clear();
+    }
+    if (ends) {
+      return fragment;
+    }
+  } else if (m_buffer.empty()) {
+    spdlog::warn("Dropped a SysEx fragment without start");
+    return {};
+  }
+  if (m_buffer.size() + fragment.size() > MAX_ASSEMBLED_SIZE) {
+    spdlog::warn("Dropped a SysEx message larger than " +
+                 std::to_string(MAX_ASSEMBLED_SIZE) + " bytes");
+    m_buffer.clear();
+    return {};
+  }
+  m_buffer.insert(m_buffer.end(), fragment.begin(), fragment.end());
+  if (!ends) {
+    return {};
+  }
+  m_complete = true;
+  return m_buffer;
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Joins a SysEx message the mixer split over several packages: the first
+// fragment starts with 0xf0, the last one ends with 0xf7. Fragments are
+// appended to one buffer that keeps its capacity between messages, a message
+// that arrives in one package is handed back without copying it.
+class SysExAssembler {
+public:
+  // Returns the message `fragment` completes, an empty span while the message
+  // is incomplete or when the fragment is dropped. The span is valid until the
+  // next call.
+  std::span<const std::byte> add(std::span<const std::byte> fragment);
+
+  // Whether the last message returned by add() was joined from fragments.
+  [[nodiscard]] bool was_assembled() const { return m_complete; }
+
+private:
+  std::vector<std::byte> m_buffer;
+  // m_buffer holds the message returned by the last call.
+  bool m_complete = false;
+};
+
+} // namespace sls3mcubridge
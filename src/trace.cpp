@@ -0,0 +1,282 @@
+#include "trace.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <ios>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+namespace sls3mcubridge {
+
+namespace {
+const std::array<std::byte, 8> TRACE_MAGIC = {
+    std::byte('S'), std::byte('L'), std::byte('S'), std::byte('3'),
+    std::byte('T'), std::byte('R'), std::byte('C'), std::byte(0x01)};
+
+// Threads that record, the bridge has a few io threads and midi input threads
+// per device. Threads beyond this do not record.
+const uint32_t MAX_TRACE_THREADS = 64;
+const mode_t TRACE_FILE_MODE = 0644;
+const std::array<int, 5> CRASH_SIGNALS = {SIGSEGV, SIGBUS, SIGFPE, SIGILL,
+                                          SIGABRT};
+
+const std::array<std::string_view, 6> STAGE_NAMES = {
+    "mixer_frame",     "midi_to_daw", "midi_from_daw",
+    "coalescer_flush", "tcp_write",   "tcp_written"};
+const std::array<std::string_view, 5> BODY_TYPE_NAMES = {
+    "unknown", "initial_response", "incomming_midi", "outgoing_midi", "sysex"};
+const double NANOSECONDS_PER_MICROSECOND = 1000.0;
+
+// Rings are never freed, a dump may read them after their thread ended.
+std::array<std::atomic<TraceRing *>, MAX_TRACE_THREADS> rings{};
+std::atomic<uint32_t> nr_rings{0};
+// Copied once by enable_tracing(), so a signal handler can open it.
+std::array<char, PATH_MAX> dump_path{};
+
+TraceRing *register_thread() {
+  auto index = nr_rings.fetch_add(1, std::memory_order_relaxed);
+  if (index >= MAX_TRACE_THREADS) {
+    return nullptr;
+  }
+  auto *ring = new TraceRing(index); // NOLINT(cppcoreguidelines-owning-memory)
+  rings.at(index).store(ring, std::memory_order_release);
+  return ring;
+}
+
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+const char *as_chars(const std::byte *data) {
+  return reinterpret_cast<const char *>(data);
+}
+
+char *as_chars(std::byte *data) { return reinterpret_cast<char *>(data); }
+
+const char *as_chars(const TraceRecord *records) {
+  return reinterpret_cast<const char *>(records);
+}
+
+char *as_chars(TraceRecord *record) { return reinterpret_cast<char *>(record); }
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+bool write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    auto written = ::write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+// Async-signal-safe, used by dump_trace() and the crash handler.
+bool write_trace(const char *path) {
+  auto fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                   TRACE_FILE_MODE);
+  if (fd < 0) {
+    return false;
+  }
+  bool succeeded =
+      write_all(fd, as_chars(TRACE_MAGIC.data()), TRACE_MAGIC.size());
+  auto count = std::min(nr_rings.load(std::memory_order_relaxed),
+                        MAX_TRACE_THREADS);
+  for (uint32_t i = 0; i < count && succeeded; i++) {
+    const auto *ring = rings.at(i).load(std::memory_order_acquire);
+    // A thread that is registering right now has no records yet.
+    if (ring != nullptr) {
+      succeeded = ring->write_to(fd);
+    }
+  }
+  return ::close(fd) == 0 && succeeded;
+}
+
+void crash_handler(int signal) {
+  write_trace(dump_path.data());
+  // SA_RESETHAND restored the default action, raising again terminates the
+  // process the way the signal would have.
+  std::raise(signal);
+}
+
+std::string to_hex(const TraceRecord &record) {
+  static const std::string_view DIGITS = "0123456789abcdef";
+  const unsigned int NIBBLE_BITS = 4;
+  const unsigned int NIBBLE_MASK = 0x0F;
+
+  auto kept = std::min<size_t>(record.kept, TraceRecord::MAX_BYTES);
+  std::string hex;
+  for (size_t i = 0; i < kept; i++) {
+    auto value = std::to_integer<unsigned int>(record.bytes.at(i));
+    if (i > 0) {
+      hex += ' ';
+    }
+    hex += DIGITS.at(value >> NIBBLE_BITS);
+    hex += DIGITS.at(value & NIBBLE_MASK);
+  }
+  return hex;
+}
+
+std::string_view stage_name(TraceStage stage) {
+  auto index = static_cast<size_t>(stage);
+  return index < STAGE_NAMES.size() ? STAGE_NAMES.at(index) : "unknown";
+}
+} // namespace
+
+std::atomic<bool> trace_detail::enabled{false};
+
+void trace_detail::record(TraceStage stage, uint8_t device, uint8_t body_type,
+                          size_t size, std::span<const std::byte> bytes) {
+  thread_local TraceRing *ring = register_thread();
+  if (ring != nullptr) {
+    ring->record(stage, device, body_type, size, bytes);
+  }
+}
+
+void TraceRing::record(TraceStage stage, uint8_t device, uint8_t body_type,
+                       size_t size, std::span<const std::byte> bytes) {
+  auto head = m_head.load(std::memory_order_relaxed);
+  auto &record = m_records.at(head & (CAPACITY - 1));
+  record.timestamp = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+  record.thread = m_thread;
+  record.size = static_cast<uint16_t>(std::min<size_t>(size, UINT16_MAX));
+  record.stage = stage;
+  record.device = device;
+  record.body_type = body_type;
+  auto kept = std::min(bytes.size(), TraceRecord::MAX_BYTES);
+  record.kept = static_cast<uint8_t>(kept);
+  std::fill(std::copy_n(bytes.begin(), kept, record.bytes.begin()),
+            record.bytes.end(), std::byte(0));
+  m_head.store(head + 1, std::memory_order_release);
+}
+
+bool TraceRing::write_to(int fd) const {
+  auto head = m_head.load(std::memory_order_acquire);
+  auto count = std::min<uint64_t>(head, CAPACITY);
+  auto first = (head - count) & (CAPACITY - 1);
+  // The records from `first` to the end of the array, then the wrapped ones
+  // from the start of it.
+  auto until_end = std::min<uint64_t>(count, CAPACITY - first);
+  return write_all(fd, as_chars(&m_records.at(first)),
+                   until_end * sizeof(TraceRecord)) &&
+         write_all(fd, as_chars(m_records.data()),
+                   (count - until_end) * sizeof(TraceRecord));
+}
+
+void enable_tracing(const std::string &path) {
+  if (path.size() >= dump_path.size()) {
+    throw std::invalid_argument("Trace path " + path + " is too long");
+  }
+  std::fill(std::copy(path.begin(), path.end(), dump_path.begin()),
+            dump_path.end(), '\0');
+  trace_detail::enabled.store(true, std::memory_order_relaxed);
+  spdlog::info("Tracing to " + path);
+}
+
+void disable_tracing() {
+  trace_detail::enabled.store(false, std::memory_order_relaxed);
+}
+
+bool dump_trace() {
+  if (!tracing_enabled()) {
+    return false;
+  }
+  if (!write_trace(dump_path.data())) {
+    spdlog::warn(std::string("Could not write trace to ") + dump_path.data());
+    return false;
+  }
+  spdlog::info(std::string("Trace written to ") + dump_path.data());
+  return true;
+}
+
+void dump_trace_on_crash() {
+  struct sigaction action {};
+  action.sa_handler = crash_handler;
+  action.sa_flags = SA_RESETHAND;
+  sigemptyset(&action.sa_mask);
+  for (auto signal : CRASH_SIGNALS) {
+    sigaction(signal, &action, nullptr);
+  }
+}
+
+TraceReader::TraceReader(const std::string &path)
+    : m_file(path, std::ios::binary) {
+  std::array<std::byte, TRACE_MAGIC.size()> magic{};
+  m_file.read(as_chars(magic.data()), magic.size());
+  if (!m_file || magic != TRACE_MAGIC) {
+    throw std::runtime_error(path + " is not a trace file");
+  }
+}
+
+bool TraceReader::next(TraceRecord &record) {
+  m_file.read(as_chars(&record), sizeof(TraceRecord));
+  return static_cast<bool>(m_file);
+}
+
+void write_chrome_trace(TraceReader &reader, std::ostream &out) {
+  std::vector<TraceRecord> records;
+  TraceRecord record;
+  uint32_t nr_threads = 0;
+  while (reader.next(record)) {
+    records.push_back(record);
+    nr_threads = std::max(nr_threads, record.thread + 1);
+  }
+  std::stable_sort(records.begin(), records.end(),
+                   [](const TraceRecord &lhs, const TraceRecord &rhs) {
+                     return lhs.timestamp < rhs.timestamp;
+                   });
+  auto start = records.empty() ? 0 : records.front().timestamp;
+
+  out << R"({"displayTimeUnit":"ns","traceEvents":[)";
+  const char *separator = "\n";
+  for (uint32_t thread = 0; thread < nr_threads; thread++) {
+    out << separator << R"({"name":"thread_name","ph":"M","pid":1,"tid":)"
+        << thread << R"(,"args":{"name":"thread )" << thread << R"("}})";
+    separator = ",\n";
+  }
+  out << std::fixed;
+  out.precision(3);
+  for (const auto &event : records) {
+    out << separator << R"({"name":")" << stage_name(event.stage)
+        << R"(","ph":"i","s":"t","ts":)"
+        << static_cast<double>(event.timestamp - start) /
+               NANOSECONDS_PER_MICROSECOND
+        << R"(,"pid":1,"tid":)" << event.thread << R"(,"args":{"size":)"
+        << event.size;
+    if (event.device != TRACE_NONE) {
+      out << R"(,"device":)" << static_cast<unsigned int>(event.device);
+    }
+    if (event.body_type < BODY_TYPE_NAMES.size()) {
+      out << R"(,"body_type":")" << BODY_TYPE_NAMES.at(event.body_type)
+          << '"';
+    }
+    if (event.kept > 0) {
+      out << R"(,"bytes":")" << to_hex(event) << '"';
+    }
+    out << "}}";
+    separator = ",\n";
+  }
+  out << "\n]}\n";
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <type_traits>
+
+namespace sls3mcubridge {
+
+enum class TraceStage : uint8_t {
+  MixerFrame,     // package received from the mixer
+  MidiToDaw,      // midi message sent to the DAW
+  MidiFromDaw,    // midi message received from the DAW
+  CoalescerFlush, // pending DAW messages of a device encoded for the mixer
+  TcpWrite,       // bytes handed to the mixer connection
+  TcpWritten,     // write to the mixer completed
+};
+
+// Device and body type of records that have none.
+const uint8_t TRACE_NONE = UINT8_MAX;
+
+// One fixed-size event of the flight recorder.
+struct TraceRecord {
+  static constexpr size_t MAX_BYTES = 14;
+
+  // steady_clock time in nanoseconds.
+  uint64_t timestamp = 0;
+  // Index of the recording thread, in the order threads started tracing.
+  uint32_t thread = 0;
+  // Size of the traced message or write, of which the first MAX_BYTES bytes
+  // are kept.
+  uint16_t size = 0;
+  TraceStage stage = TraceStage::MixerFrame;
+  uint8_t device = TRACE_NONE;
+  uint8_t body_type = TRACE_NONE;
+  // Number of bytes kept in `bytes`.
+  uint8_t kept = 0;
+  std::array<std::byte, MAX_BYTES> bytes{};
+};
+
+static_assert(std::is_trivially_copyable_v<TraceRecord>);
+static_assert(sizeof(TraceRecord) == 32);
+
+// The last CAPACITY records of one thread. Only the owning thread records,
+// a dump may read it from any thread or a signal handler at the same time,
+// so records written during a dump may come out torn.
+class TraceRing {
+public:
+  static constexpr size_t CAPACITY = 4096;
+
+  explicit TraceRing(uint32_t thread) : m_thread(thread) {}
+
+  // Keeps the first MAX_BYTES of `bytes`, `size` is the size of the whole
+  // message or write.
+  void record(TraceStage stage, uint8_t device, uint8_t body_type, size_t size,
+              std::span<const std::byte> bytes);
+  // Writes the records, oldest first, to `fd`. Async-signal-safe.
+  bool write_to(int fd) const;
+
+private:
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0);
+
+  std::array<TraceRecord, CAPACITY> m_records{};
+  std::atomic<uint64_t> m_head{0};
+  uint32_t m_thread;
+};
+
+namespace trace_detail {
+extern std::atomic<bool> enabled;
+void record(TraceStage stage, uint8_t device, uint8_t body_type, size_t size,
+            std::span<const std::byte> bytes);
+} // namespace trace_detail
+
+// Starts recording on every thread. Each thread records into a ring of its
+// own, created the first time it records. dump_trace() writes the rings to
+// `path`.
+void enable_tracing(const std::string &path);
+// Stops recording, the records so far are kept.
+void disable_tracing();
+[[nodiscard]] inline bool tracing_enabled() {
+  return trace_detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Records an event on the ring of the calling thread, does nothing when
+// tracing is disabled.
+inline void trace(TraceStage stage, uint8_t device, uint8_t body_type,
+                  std::span<const std::byte> bytes) {
+  if (tracing_enabled()) {
+    trace_detail::record(stage, device, body_type, bytes.size(), bytes);
+  }
+}
+// Records an event of `size` bytes without keeping any of them.
+inline void trace(TraceStage stage, uint8_t device, size_t size) {
+  if (tracing_enabled()) {
+    trace_detail::record(stage, device, TRACE_NONE, size, {});
+  }
+}
+
+// Writes the records of all threads to the path given to enable_tracing().
+bool dump_trace();
+// Dumps the trace when the process crashes on SIGSEGV, SIGBUS, SIGFPE, SIGILL
+// or SIGABRT, then lets the signal take its default action.
+void dump_trace_on_crash();
+
+// Reads a file written by dump_trace(). Records are stored in the memory
+// layout of TraceRecord, so the file is read on a machine of the same byte
+// order as the one that wrote it.
+class TraceReader {
+public:
+  // Throws std::runtime_error when the file is not a trace.
+  explicit TraceReader(const std::string &path);
+  // Reads the next record into `record`, returns false at the end of the file.
+  bool next(TraceRecord &record);
+
+private:
+  std::ifstream m_file;
+};
+
+// Writes the records of `reader` as instant events in the Chrome trace event
+// JSON format, which Perfetto and chrome://tracing open. One track per
+// recording thread, timestamps in microseconds since the first record.
+void write_chrome_trace(TraceReader &reader, std::ostream &out);
+
+} // namespace sls3mcubridge
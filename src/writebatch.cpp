@@ -0,0 +1,79 @@
+#include "writebatch.hpp"
+
+#include "package.hpp"
+
+#include "asio/buffer.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace sls3mcubridge {
+
+const size_t INITIAL_BUFFER_COUNT = 16;
+
+WriteBatch::WriteBatch(size_t capacity) : m_storage(capacity) {
+  m_buffers.reserve(INITIAL_BUFFER_COUNT);
+  m_marks.reserve(INITIAL_BUFFER_COUNT);
+}
+
+bool WriteBatch::add(const tcp::ISerialize &item) {
+  auto size = item.serialized_size();
+  if (size > remaining()) {
+    return false;
+  }
+
+  auto *begin = m_storage.data() + m_storage_used;
+  append_to_storage(begin, item.serialize_into(std::span(begin, size)));
+  return true;
+}
+
+bool WriteBatch::add_copy(const asio::const_buffer &buffer) {
+  if (buffer.size() > remaining()) {
+    return false;
+  }
+  auto *begin = m_storage.data() + m_storage_used;
+  std::memcpy(begin, buffer.data(), buffer.size());
+  append_to_storage(begin, buffer.size());
+  return true;
+}
+
+void WriteBatch::append_to_storage(std::byte *begin, size_t size) {
+  m_storage_used += size;
+  m_size += size;
+
+  if (m_last_in_storage) {
+    const auto &last = m_buffers.back();
+    m_buffers.back() = asio::const_buffer(last.data(), last.size() + size);
+  } else {
+    m_buffers.emplace_back(begin, size);
+    m_last_in_storage = true;
+  }
+}
+
+void WriteBatch::add(const asio::const_buffer &buffer) {
+  m_buffers.push_back(buffer);
+  m_size += buffer.size();
+  m_last_in_storage = false;
+}
+
+void WriteBatch::mark(size_t device,
+                      std::chrono::steady_clock::time_point received) {
+  m_marks.push_back({device, received});
+}
+
+void WriteBatch::add_marks(const std::vector<LatencyMark> &marks) {
+  m_marks.insert(m_marks.end(), marks.begin(), marks.end());
+}
+
+void WriteBatch::clear() {
+  m_marks.clear();
+  m_buffers.clear();
+  m_storage_used = 0;
+  m_size = 0;
+  m_last_in_storage = false;
+}
+
+} // namespace sls3mcubridge
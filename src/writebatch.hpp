@@ -0,0 +1,64 @@
+#pragma once
+
+#include "package.hpp"
+
+#include "asio/buffer.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace sls3mcubridge {
+
+// Receive time of the oldest midi message of a device carried by a batch.
+struct LatencyMark {
+  size_t device;
+  std::chrono::steady_clock::time_point received;
+};
+
+// Collects packages and raw buffers for one gathered socket write. Packages
+// are serialized into storage owned by the batch, raw buffers are referenced
+// in place and have to outlive the write.
+class WriteBatch {
+public:
+  explicit WriteBatch(size_t capacity);
+
+  // Serializes `item` behind the previous content. Returns false and leaves
+  // the batch untouched when the item does not fit in the remaining storage.
+  bool add(const tcp::ISerialize &item);
+  // References `buffer` without copying it.
+  void add(const asio::const_buffer &buffer);
+  // Copies the content of `buffer` into the batch. Returns false when it does
+  // not fit in the remaining storage.
+  bool add_copy(const asio::const_buffer &buffer);
+  // Remembers when the content for `device` was received, to measure the
+  // latency once the batch is written.
+  void mark(size_t device, std::chrono::steady_clock::time_point received);
+  void add_marks(const std::vector<LatencyMark> &marks);
+
+  [[nodiscard]] const std::vector<asio::const_buffer> &buffers() const {
+    return m_buffers;
+  }
+  [[nodiscard]] const std::vector<LatencyMark> &marks() const {
+    return m_marks;
+  }
+  [[nodiscard]] size_t size() const { return m_size; }
+  [[nodiscard]] bool empty() const { return m_size == 0; }
+  [[nodiscard]] size_t remaining() const {
+    return m_storage.size() - m_storage_used;
+  }
+  void clear();
+
+private:
+  void append_to_storage(std::byte *begin, size_t size);
+
+  std::vector<std::byte> m_storage;
+  size_t m_storage_used = 0;
+  size_t m_size = 0;
+  std::vector<asio::const_buffer> m_buffers;
+  // Whether the last buffer points into m_storage and can be extended.
+  bool m_last_in_storage = false;
+  std::vector<LatencyMark> m_marks;
+};
+
+} // namespace sls3mcubridge
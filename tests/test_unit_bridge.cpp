@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <thread>
+
+#include "asio/co_spawn.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "bridge.hpp"
+#include "libremidi/message.hpp"
+#include "mockmixer.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+const std::chrono::seconds DEVICES_TIMEOUT(5);
+const std::chrono::microseconds FEED_PAUSE(10);
+// Packages of the fed bridge after which the mixer drops the connection.
+const size_t DISCONNECT_AFTER = 20;
+} // namespace
+
+TEST(TestBridge, testDevicesAddedOnReconnectWhileFed) {
+  asio::io_context io_context;
+  asio::ip::tcp::acceptor acceptor(
+      io_context,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  TrafficConfig first_mixer;
+  first_mixer.disconnect_after = DISCONNECT_AFTER;
+  serve_mock_mixer(io_context, acceptor, first_mixer, nullptr);
+
+  BridgeConfig config;
+  config.meter_interval = std::chrono::milliseconds(10);
+  config.midi_port_prefix = "TestBridge_";
+  auto bridge =
+      std::make_shared<Bridge>(io_context.get_executor(), "127.0.0.1",
+                               acceptor.local_endpoint().port(), config);
+  bool started = false;
+  std::exception_ptr start_error;
+  asio::co_spawn(io_context, bridge->start(),
+                 [&started, &start_error](const std::exception_ptr &error) {
+                   started = true;
+                   start_error = error;
+                 });
+  while (!started) {
+    io_context.run_one();
+  }
+  if (start_error) {
+    bridge->stop();
+    acceptor.close();
+    GTEST_SKIP() << "No midi backend to create the devices on";
+  }
+  EXPECT_EQ(bridge->get_nr_midi_devices(), 1);
+
+  // The bridge reconnects to a mixer with three devices.
+  acceptor.cancel();
+  TrafficConfig second_mixer;
+  second_mixer.devices = 3;
+  serve_mock_mixer(io_context, acceptor, second_mixer, nullptr);
+
+  // Feeds the first device the way its midi input thread does, until the
+  // first mixer drops the connection and the reconnect adds two more devices
+  // on the executor.
+  std::atomic<bool> feeding = true;
+  std::thread daw([reader = bridge->midi_reader(0), &feeding]() {
+    unsigned char value = 0;
+    while (feeding) {
+      reader(libremidi::message({0xe0, 0x00, value}));
+      // Channel pressure, a meter.
+      reader(libremidi::message({0xd0, value}));
+      value = (value + 1) & 0x7f;
+      // Keeps the queues of the executor from growing without bound.
+      std::this_thread::sleep_for(FEED_PAUSE);
+    }
+  });
+  auto deadline = std::chrono::steady_clock::now() + DEVICES_TIMEOUT;
+  while (bridge->get_nr_midi_devices() < 3 &&
+         std::chrono::steady_clock::now() < deadline) {
+    io_context.run_for(std::chrono::milliseconds(10));
+  }
+  feeding = false;
+  daw.join();
+  EXPECT_EQ(bridge->get_nr_midi_devices(), 3);
+
+  bridge->stop();
+  bridge.reset();
+  acceptor.close();
+  io_context.restart();
+  io_context.run();
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,181 @@
+#include "gtest/gtest.h"
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "asio/io_context.hpp"
+#include "capture.hpp"
+#include "libremidi/message.hpp"
+#include "package.hpp"
+#include "replay.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+const std::array<std::byte, 16> INCOMMING_MIDI_FRAME = {
+    std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+    std::byte(0x0a), std::byte(0x00), std::byte(0x4d), std::byte(0x4d),
+    std::byte(0x00), std::byte(0x00), std::byte(0x6d), std::byte(0x00),
+    std::byte(0x90), std::byte(0x10), std::byte(0x7f), std::byte(0x00),
+};
+
+const std::array<std::byte, 3> NOTE_ON_BYTES = {
+    std::byte(0x90), std::byte(0x10), std::byte(0x7f)};
+
+std::string capture_path(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+} // namespace
+
+TEST(TestCapture, testRecordsAreReadBack) {
+  auto path = capture_path("test_capture_read_back.cap");
+  {
+    CaptureWriter writer(path);
+    writer.record(CaptureSource::TcpRead, 0, INCOMMING_MIDI_FRAME);
+    writer.record(CaptureSource::MidiFromDaw, 2, NOTE_ON_BYTES);
+  }
+
+  CaptureReader reader(path);
+  CaptureRecord record;
+  ASSERT_TRUE(reader.next(record));
+  ASSERT_EQ(record.source, CaptureSource::TcpRead);
+  ASSERT_EQ(record.data, std::vector<std::byte>(INCOMMING_MIDI_FRAME.begin(),
+                                                INCOMMING_MIDI_FRAME.end()));
+  auto first_timestamp = record.timestamp;
+
+  ASSERT_TRUE(reader.next(record));
+  ASSERT_EQ(record.source, CaptureSource::MidiFromDaw);
+  ASSERT_EQ(record.device, 2);
+  ASSERT_EQ(record.data,
+            std::vector<std::byte>(NOTE_ON_BYTES.begin(), NOTE_ON_BYTES.end()));
+  ASSERT_GE(record.timestamp, first_timestamp);
+  ASSERT_FALSE(reader.next(record));
+  std::filesystem::remove(path);
+}
+
+TEST(TestCapture, testFullRingDropsRecords) {
+  auto path = capture_path("test_capture_full_ring.cap");
+  const size_t nr_records = 64;
+  std::vector<std::byte> data(64 * 1024, std::byte(0x41));
+  uint64_t dropped = 0;
+  {
+    CaptureWriter writer(path);
+    // 4 MiB at once, more than the ring holds before it is drained.
+    for (size_t i = 0; i < nr_records; i++) {
+      writer.record(CaptureSource::TcpRead, 0, data);
+    }
+    dropped = writer.get_dropped();
+  }
+  ASSERT_GT(dropped, 0);
+
+  CaptureReader reader(path);
+  CaptureRecord record;
+  size_t nr_read = 0;
+  while (reader.next(record)) {
+    ASSERT_EQ(record.data, data);
+    nr_read++;
+  }
+  ASSERT_EQ(nr_read + dropped, nr_records);
+  std::filesystem::remove(path);
+}
+
+TEST(TestCapture, testRecordsOfSeveralThreadsAreKept) {
+  auto path = capture_path("test_capture_threads.cap");
+  const size_t nr_threads = 4;
+  const size_t nr_records = 20000;
+  uint64_t dropped = 0;
+  {
+    CaptureWriter writer(path);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < nr_threads; thread++) {
+      threads.emplace_back([&writer, thread]() {
+        for (size_t i = 0; i < nr_records; i++) {
+          // Sizes from 1 to 7 bytes, so records wrap at every offset.
+          std::vector<std::byte> data(1 + i % 7, std::byte(i));
+          writer.record(CaptureSource::MidiFromDaw,
+                        static_cast<uint8_t>(thread), data);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    dropped = writer.get_dropped();
+  }
+
+  CaptureReader reader(path);
+  CaptureRecord record;
+  std::vector<size_t> next(nr_threads, 0);
+  size_t nr_read = 0;
+  while (reader.next(record)) {
+    ASSERT_LT(record.device, nr_threads);
+    // Records of one thread keep their order, dropped ones are skipped.
+    auto &expected = next.at(record.device);
+    while (record.data !=
+           std::vector<std::byte>(1 + expected % 7, std::byte(expected))) {
+      expected++;
+      ASSERT_LT(expected, nr_records);
+    }
+    expected++;
+    nr_read++;
+  }
+  ASSERT_EQ(nr_read + dropped, nr_threads * nr_records);
+  std::filesystem::remove(path);
+}
+
+TEST(TestCapture, testReaderRejectsOtherFiles) {
+  auto path = capture_path("test_capture_not_a_capture.cap");
+  {
+    std::ofstream file(path);
+    file << "not a capture";
+  }
+  ASSERT_THROW(CaptureReader{path}, std::runtime_error);
+  std::filesystem::remove(path);
+}
+
+TEST(TestReplay, testReplayDrivesCallbacks) {
+  auto path = capture_path("test_capture_replay.cap");
+  {
+    CaptureWriter writer(path);
+    // A frame split over two reads, as the socket may deliver it.
+    writer.record(CaptureSource::TcpRead, 0,
+                  std::span(INCOMMING_MIDI_FRAME).first(5));
+    writer.record(CaptureSource::TcpRead, 0,
+                  std::span(INCOMMING_MIDI_FRAME).subspan(5));
+    writer.record(CaptureSource::TcpWrite, 0, INCOMMING_MIDI_FRAME);
+    writer.record(CaptureSource::MidiFromDaw, 1, NOTE_ON_BYTES);
+  }
+
+  asio::io_context io_context;
+  std::vector<int> package_devices;
+  std::vector<std::pair<int, libremidi::midi_bytes>> midi_messages;
+  auto replay = std::make_shared<Replay>(
+      io_context.get_executor(), path, 0,
+      [&package_devices](tcp::PackageView &package) {
+        package_devices.push_back(
+            package.get_body<tcp::IncommingMidiBodyView>().device.get_index());
+      },
+      [&midi_messages](int device, const libremidi::message &message) {
+        midi_messages.emplace_back(device, message.bytes);
+      });
+  replay->start();
+  io_context.run();
+
+  ASSERT_EQ(replay->get_replayed(), 4);
+  ASSERT_EQ(package_devices, std::vector<int>{1});
+  ASSERT_EQ(midi_messages.size(), 1);
+  ASSERT_EQ(midi_messages.front().first, 1);
+  ASSERT_EQ(midi_messages.front().second,
+            (libremidi::midi_bytes{0x90, 0x10, 0x7f}));
+  std::filesystem::remove(path);
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,250 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "asio/awaitable.hpp"
+#include "asio/buffer.hpp"
+#include "asio/co_spawn.hpp"
+#include "asio/detached.hpp"
+#include "asio/error.hpp"
+#include "asio/error_code.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/post.hpp"
+#include "asio/read.hpp"
+#include "asio/write.hpp"
+#include "client.hpp"
+#include "lowlatency.hpp"
+#include "metrics.hpp"
+#include "midimessage.hpp"
+#include "package.hpp"
+#include "writebatch.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+// Connects `client` to a peer accepted on `acceptor`.
+asio::ip::tcp::socket connect(asio::io_context &io_context,
+                              asio::ip::tcp::acceptor &acceptor,
+                              const std::shared_ptr<Client> &client) {
+  asio::co_spawn(io_context,
+                 client->async_connect("127.0.0.1",
+                                       acceptor.local_endpoint().port(),
+                                       std::chrono::seconds(1)),
+                 asio::detached);
+  io_context.run();
+  io_context.restart();
+  return acceptor.accept();
+}
+
+// Runs handlers until `size` bytes are waiting on `peer`.
+void run_until_available(asio::io_context &io_context,
+                         const asio::ip::tcp::socket &peer, size_t size) {
+  while (peer.available() < size && io_context.run_one() > 0) {
+  }
+}
+} // namespace
+
+TEST(TestClient, testQueuedWritesArriveInOrder) {
+  asio::io_context io_context;
+  asio::ip::tcp::acceptor acceptor(
+      io_context, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  auto client = std::make_shared<Client>(io_context.get_executor());
+  auto peer = connect(io_context, acceptor, client);
+  client->start_reading([](tcp::PackageView & /*package*/) {});
+
+  std::vector<std::byte> expected;
+  for (unsigned char note = 0; note < 100; note++) {
+    auto body = tcp::IncommingMidiBody(std::byte(0x6c),
+                                       ShortMessage({0x90, note, 0x7f}));
+    auto batch = WriteBatch(body.get_size());
+    ASSERT_TRUE(batch.add(body));
+    client->write(batch);
+    auto bytes = body.serialize();
+    expected.insert(expected.end(), bytes.begin(), bytes.end());
+  }
+  run_until_available(io_context, peer, expected.size());
+
+  std::vector<std::byte> received(expected.size());
+  asio::read(peer, asio::buffer(received));
+  ASSERT_EQ(received, expected);
+}
+
+TEST(TestClient, testReadPackageWaitsForCompletePackage) {
+  asio::io_context io_context;
+  asio::ip::tcp::acceptor acceptor(
+      io_context, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  auto client = std::make_shared<Client>(io_context.get_executor());
+  auto peer = connect(io_context, acceptor, client);
+
+  std::shared_ptr<tcp::Body> body = std::make_shared<tcp::IncommingMidiBody>(
+      std::byte(0x6c), ShortMessage({0x90, 0x10, 0x7f}));
+  auto package = tcp::Package(body);
+  auto bytes = package.serialize();
+  // Header and body arrive in separate reads.
+  asio::write(peer, asio::buffer(bytes.data(), tcp::HEADER_SIZE));
+
+  std::shared_ptr<tcp::Body> received;
+  asio::co_spawn(
+      io_context,
+      [&]() -> asio::awaitable<void> {
+        received =
+            co_await client->async_read_package(std::chrono::seconds(1));
+      },
+      asio::detached);
+  io_context.run_one();
+  asio::write(peer, asio::buffer(bytes.data() + tcp::HEADER_SIZE,
+                                 bytes.size() - tcp::HEADER_SIZE));
+  io_context.run();
+
+  ASSERT_NE(received, nullptr);
+  ASSERT_EQ(received->get_type(), tcp::Body::Type::IncommingMidi);
+}
+
+TEST(TestClient, testReadPackageTimesOut) {
+  asio::io_context io_context;
+  asio::ip::tcp::acceptor acceptor(
+      io_context, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  auto client = std::make_shared<Client>(io_context.get_executor());
+  auto peer = connect(io_context, acceptor, client);
+
+  std::exception_ptr error;
+  asio::co_spawn(io_context,
+                 client->async_read_package(std::chrono::milliseconds(10)),
+                 [&error](std::exception_ptr exc,
+                          const std::shared_ptr<tcp::Body> & /*body*/) {
+                   error = std::move(exc);
+                 });
+  io_context.run();
+
+  ASSERT_NE(error, nullptr);
+  ASSERT_THROW(std::rethrow_exception(error), std::runtime_error);
+}
+
+TEST(TestClient, testDisconnectOnEof) {
+  asio::io_context io_context;
+  asio::ip::tcp::acceptor acceptor(
+      io_context, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  auto client = std::make_shared<Client>(io_context.get_executor());
+  auto peer = connect(io_context, acceptor, client);
+  int disconnects = 0;
+  client->set_disconnect_handler(
+      [&disconnects](const asio::error_code &error) {
+        ASSERT_EQ(error, asio::error::eof);
+        disconnects++;
+      });
+  client->start_reading([](tcp::PackageView & /*package*/) {});
+  ASSERT_TRUE(client->is_connected());
+
+  peer.close();
+  // Returns because the client stops reading instead of retrying.
+  io_context.run();
+
+  ASSERT_EQ(disconnects, 1);
+  ASSERT_FALSE(client->is_connected());
+}
+
+TEST(TestClient, testWritesWhileDisconnected) {
+  asio::io_context io_context;
+  asio::ip::tcp::acceptor acceptor(
+      io_context, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  auto client = std::make_shared<Client>(io_context.get_executor());
+  auto peer = connect(io_context, acceptor, client);
+  client->start_reading([](tcp::PackageView & /*package*/) {});
+  peer.close();
+  io_context.run();
+  io_context.restart();
+
+  auto dropped = tcp::IncommingMidiBody(std::byte(0x6c),
+                                        ShortMessage({0x90, 0x10, 0x7f}));
+  auto buffered = tcp::IncommingMidiBody(
+      std::byte(0x6c), ShortMessage({0x90, 0x11, 0x7f}));
+  auto batch = WriteBatch(dropped.serialized_size());
+  ASSERT_TRUE(batch.add(dropped));
+  client->write(batch);
+  ASSERT_EQ(client->get_queued_size(), 0);
+  client->set_buffer_while_disconnected(true);
+  batch.clear();
+  ASSERT_TRUE(batch.add(buffered));
+  client->write(batch);
+  ASSERT_EQ(client->get_queued_size(), buffered.serialized_size());
+
+  // Sent once reading on the new connection starts.
+  peer = connect(io_context, acceptor, client);
+  client->start_reading([](tcp::PackageView & /*package*/) {});
+  auto expected = buffered.serialize();
+  run_until_available(io_context, peer, expected.size());
+  std::vector<std::byte> received(expected.size());
+  asio::read(peer, asio::buffer(received));
+  ASSERT_EQ(received, expected);
+  ASSERT_EQ(peer.available(), 0);
+}
+
+TEST(TestClient, testBatchThatDoesNotFitIsDroppedWhole) {
+  asio::io_context io_context;
+  auto client = std::make_shared<Client>(io_context.get_executor());
+  auto metrics = std::make_shared<Metrics>();
+  client->set_metrics(metrics);
+  // Queued without a connection, nothing is written in the meantime.
+  client->set_buffer_while_disconnected(true);
+
+  std::vector<std::byte> bytes(MAX_QUEUED_WRITE_SIZE / 2 + 1);
+  auto batch = WriteBatch(bytes.size());
+  ASSERT_TRUE(batch.add_copy(asio::buffer(bytes)));
+  client->write(batch);
+  ASSERT_EQ(client->get_queued_size(), bytes.size());
+  client->write(batch);
+  ASSERT_EQ(client->get_queued_size(), bytes.size());
+
+  std::ostringstream text;
+  metrics->write_prometheus(text);
+  ASSERT_NE(text.str().find("sls3_dropped_tcp_writes_total 1\n"),
+            std::string::npos);
+}
+
+TEST(TestClient, testSpinReadLetsOtherHandlersRun) {
+  asio::io_context io_context;
+  asio::ip::tcp::acceptor acceptor(
+      io_context, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  auto client = std::make_shared<Client>(io_context.get_executor());
+  LowLatencyConfig low_latency;
+  // SO_BUSY_POLL may need CAP_NET_ADMIN.
+  low_latency.busy_poll = std::chrono::microseconds(0);
+  low_latency.spin_read = std::chrono::seconds(1);
+  client->set_low_latency(low_latency);
+  auto peer = connect(io_context, acceptor, client);
+  auto started = std::chrono::steady_clock::now();
+  size_t nr_packages = 0;
+  client->start_reading(
+      [&nr_packages](tcp::PackageView & /*package*/) { nr_packages++; });
+
+  // Runs while the client still polls the socket.
+  bool ran = false;
+  asio::post(io_context, [&ran]() { ran = true; });
+  while (!ran) {
+    io_context.run_one();
+  }
+  ASSERT_LT(std::chrono::steady_clock::now() - started,
+            low_latency.spin_read / 2);
+
+  std::shared_ptr<tcp::Body> body = std::make_shared<tcp::IncommingMidiBody>(
+      std::byte(0x6c), ShortMessage({0x90, 0x10, 0x7f}));
+  auto package = tcp::Package(body);
+  asio::write(peer, asio::buffer(package.serialize()));
+  while (nr_packages == 0) {
+    io_context.run_one();
+  }
+
+  // Nothing is left to run once the client is closed.
+  client->close();
+  io_context.run();
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,414 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "asio/buffer.hpp"
+#include "asio/executor_work_guard.hpp"
+#include "asio/io_context.hpp"
+#include "coalescer.hpp"
+#include "framer.hpp"
+#include "midimessage.hpp"
+#include "package.hpp"
+#include "writebatch.hpp"
+
+namespace {
+// Allocations of the whole test binary, counted by the operator new below.
+std::atomic<size_t> nr_allocations = 0;
+} // namespace
+
+void *operator new(size_t size) {
+  nr_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t /*size*/) noexcept {
+  std::free(memory);
+}
+
+namespace sls3mcubridge {
+
+namespace {
+const std::byte DEVICE = std::byte(0x68);
+const std::array<unsigned char, 6> SHORT_SYSEX = {0xf0, 0x00, 0x00,
+                                                  0x66, 0x14, 0xf7};
+
+// Splits the written bytes back into packages.
+std::vector<std::vector<std::byte>>
+split_packages(const std::vector<std::vector<std::byte>> &writes) {
+  std::vector<std::vector<std::byte>> packages;
+  // A write is a segment, or all fragments of a long SysEx message.
+  tcp::StreamFramer framer(2 * tcp::MAX_PACKAGE_SIZE);
+  for (const auto &write : writes) {
+    auto free_space = framer.prepare();
+    std::copy(write.begin(), write.end(), free_space.begin());
+    framer.commit(write.size());
+    while (auto frame = framer.next_frame()) {
+      packages.emplace_back(frame->begin(), frame->end());
+    }
+    framer.compact();
+  }
+  return packages;
+}
+
+struct Recorder {
+  std::vector<std::vector<std::byte>> writes;
+  size_t max_write = MAX_SEGMENT_SIZE;
+  MidiCoalescer::Sink sink() {
+    return [this](const WriteBatch &batch) {
+      std::vector<std::byte> bytes(batch.size());
+      asio::buffer_copy(asio::buffer(bytes), batch.buffers());
+      ASSERT_LE(bytes.size(), max_write);
+      writes.push_back(bytes);
+    };
+  }
+  void encode(const MessageRun &messages) {
+    WriteBatch batch(MAX_SEGMENT_SIZE);
+    auto recorder_sink = sink();
+    MidiCoalescer::encode(DEVICE, messages, batch, recorder_sink);
+    if (!batch.empty()) {
+      recorder_sink(batch);
+    }
+  }
+};
+
+// A SysEx message of `size` bytes.
+std::vector<unsigned char> long_sysex(size_t size) {
+  std::vector<unsigned char> sysex;
+  for (size_t i = 0; i < size; i++) {
+    sysex.push_back(static_cast<unsigned char>(i % 0x80));
+  }
+  sysex.front() = 0xf0;
+  sysex.back() = 0xf7;
+  return sysex;
+}
+
+std::vector<ShortMessage> control_changes(size_t count) {
+  std::vector<ShortMessage> messages;
+  for (size_t i = 0; i < count; i++) {
+    messages.push_back(
+        ShortMessage({0xb0, static_cast<unsigned char>(i % 0x80), 0x30}));
+  }
+  return messages;
+}
+
+void append(MessageRun &run, const std::vector<ShortMessage> &messages) {
+  for (const auto &message : messages) {
+    run.push_back(message);
+  }
+}
+
+MessageRun run_of(const std::vector<ShortMessage> &messages) {
+  MessageRun run;
+  append(run, messages);
+  return run;
+}
+
+tcp::Body::Type type_of(std::vector<std::byte> &package) {
+  return tcp::PackageView(tcp::BufferView(package.data(),
+                                          package.data() + package.size()))
+      .get_type();
+}
+
+size_t nr_of_messages(std::vector<std::byte> &package) {
+  return tcp::PackageView(tcp::BufferView(package.data(),
+                                          package.data() + package.size()))
+      .get_body<tcp::OutgoingMidiBodyView>()
+      .get_nr_of_messages();
+}
+} // namespace
+
+TEST(TestMidiCoalescer, testChannelMessagesShareOnePackage) {
+  Recorder recorder;
+  recorder.encode(run_of(control_changes(15)));
+
+  ASSERT_EQ(recorder.writes.size(), 1);
+  auto packages = split_packages(recorder.writes);
+  ASSERT_EQ(packages.size(), 1);
+  ASSERT_EQ(nr_of_messages(packages[0]), 15);
+}
+
+TEST(TestMidiCoalescer, testBodyHoldsAsManyMessagesAsItsCountField) {
+  Recorder recorder;
+  recorder.encode(run_of(control_changes(UINT8_MAX + 1)));
+
+  auto packages = split_packages(recorder.writes);
+  ASSERT_EQ(packages.size(), 2);
+  ASSERT_EQ(nr_of_messages(packages[0]), UINT8_MAX);
+  ASSERT_EQ(nr_of_messages(packages[1]), 1);
+}
+
+TEST(TestMidiCoalescer, testEncodingChannelMessagesDoesNotAllocate) {
+  // Full and partial bodies, a short message in a body of its own and more
+  // than one segment.
+  auto messages = run_of(control_changes(UINT8_MAX + 10));
+  messages.push_back(ShortMessage({0xd0, 0x15}));
+  append(messages, control_changes(UINT8_MAX));
+  WriteBatch batch(MAX_SEGMENT_SIZE);
+  size_t writes = 0;
+  MidiCoalescer::Sink sink = [&writes](const WriteBatch & /*batch*/) {
+    writes++;
+  };
+  // The batch grows its buffer list once, like the batch a coalescer reuses.
+  MidiCoalescer::encode(DEVICE, messages, batch, sink);
+
+  batch.clear();
+  writes = 0;
+  auto allocations = nr_allocations.load();
+  MidiCoalescer::encode(DEVICE, messages, batch, sink);
+  ASSERT_EQ(nr_allocations.load(), allocations);
+  ASSERT_GT(writes, 0);
+}
+
+TEST(TestMidiCoalescer, testLargeBurstIsSplitInPackagesAndSegments) {
+  Recorder recorder;
+  recorder.encode(run_of(control_changes(1000)));
+
+  ASSERT_GT(recorder.writes.size(), 1);
+  auto packages = split_packages(recorder.writes);
+  size_t total = 0;
+  for (auto &package : packages) {
+    ASSERT_EQ(type_of(package), tcp::Body::Type::OutgoingMidi);
+    ASSERT_LE(package.size(), tcp::MAX_PACKAGE_SIZE);
+    total += nr_of_messages(package);
+  }
+  ASSERT_EQ(total, 1000);
+}
+
+TEST(TestMidiCoalescer, testOrderIsKeptAroundSysexAndShortMessages) {
+  auto messages = run_of(control_changes(2));
+  messages.push_back(std::span(SHORT_SYSEX));
+  messages.push_back(ShortMessage({0xd0, 0x15}));
+  append(messages, control_changes(3));
+
+  Recorder recorder;
+  recorder.encode(messages);
+
+  auto packages = split_packages(recorder.writes);
+  ASSERT_EQ(packages.size(), 4);
+  ASSERT_EQ(nr_of_messages(packages[0]), 2);
+  ASSERT_EQ(type_of(packages[1]), tcp::Body::Type::SysEx);
+  ASSERT_EQ(type_of(packages[2]), tcp::Body::Type::OutgoingMidi);
+  ASSERT_EQ(nr_of_messages(packages[3]), 3);
+}
+
+TEST(TestMidiCoalescer, testLongSysexIsSentInOneBody) {
+  auto sysex = long_sysex(4096);
+  MessageRun messages;
+  messages.push_back(std::span(sysex));
+  Recorder recorder;
+  recorder.max_write = MAX_SEGMENT_SIZE + tcp::MAX_PACKAGE_SIZE;
+  recorder.encode(messages);
+
+  auto packages = split_packages(recorder.writes);
+  ASSERT_EQ(packages.size(), 1);
+  auto view = tcp::PackageView(tcp::BufferView(
+      packages[0].data(), packages[0].data() + packages[0].size()));
+  const auto &body = view.get_body<tcp::SysExMidiBodyView>();
+  ASSERT_EQ(body.message.distance(), sysex.size());
+  ASSERT_TRUE(std::equal(sysex.begin(), sysex.end(), body.message.begin(),
+                         [](unsigned char expected, std::byte sent) {
+                           return std::byte(expected) == sent;
+                         }));
+}
+
+TEST(TestMidiCoalescer, testLargeSysexIsFragmented) {
+  auto sysex = long_sysex(tcp::MAX_SYSEX_FRAGMENT_SIZE + 4096);
+  MessageRun messages = run_of(control_changes(2));
+  messages.push_back(std::span(sysex));
+  Recorder recorder;
+  recorder.max_write = 2 * tcp::MAX_PACKAGE_SIZE;
+  recorder.encode(messages);
+
+  // All fragments go to the client in one write, which queues the whole
+  // message or drops it.
+  ASSERT_EQ(recorder.writes.size(), 2);
+  ASSERT_EQ(split_packages({recorder.writes[0]}).size(), 1);
+  std::vector<unsigned char> joined;
+  auto packages = split_packages({recorder.writes[1]});
+  ASSERT_EQ(packages.size(), 2);
+  for (auto &package : packages) {
+    auto view = tcp::PackageView(
+        tcp::BufferView(package.data(), package.data() + package.size()));
+    const auto &body = view.get_body<tcp::SysExMidiBodyView>();
+    ASSERT_LE(body.message.distance(), tcp::MAX_SYSEX_FRAGMENT_SIZE);
+    for (const auto &iter : body.message) {
+      joined.push_back(std::to_integer<unsigned char>(iter));
+    }
+  }
+  ASSERT_EQ(joined, sysex);
+}
+
+TEST(TestMidiCoalescer, testSysexLongerThanTheWriteQueueIsDropped) {
+  auto sysex = long_sysex(MAX_SYSEX_SIZE + 1);
+  MessageRun messages = run_of(control_changes(2));
+  messages.push_back(std::span(sysex));
+  Recorder recorder;
+  recorder.encode(messages);
+
+  auto packages = split_packages(recorder.writes);
+  ASSERT_EQ(packages.size(), 1);
+  ASSERT_EQ(nr_of_messages(packages[0]), 2);
+}
+
+TEST(TestMidiCoalescer, testPushedMessagesAreFlushedTogether) {
+  asio::io_context io_context;
+  Recorder recorder;
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), DEVICE, std::chrono::microseconds(0), false,
+      recorder.sink());
+
+  for (const auto &message : control_changes(5)) {
+    coalescer->push(message);
+  }
+  io_context.run();
+
+  ASSERT_EQ(recorder.writes.size(), 1);
+  auto packages = split_packages(recorder.writes);
+  ASSERT_EQ(packages.size(), 1);
+  ASSERT_EQ(nr_of_messages(packages[0]), 5);
+}
+
+TEST(TestMidiCoalescer, testPushedSysexKeepsItsPlace) {
+  asio::io_context io_context;
+  Recorder recorder;
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), DEVICE, std::chrono::microseconds(0), true,
+      recorder.sink());
+
+  coalescer->push(ShortMessage({0xe0, 0x00, 0x10}));
+  coalescer->push_sysex(SHORT_SYSEX);
+  coalescer->push(ShortMessage({0xe0, 0x00, 0x20}));
+  io_context.run();
+
+  // The SysEx message is a barrier, the fader value before it is kept.
+  auto packages = split_packages(recorder.writes);
+  ASSERT_EQ(packages.size(), 3);
+  ASSERT_EQ(packages[0].back(), std::byte(0x10));
+  ASSERT_EQ(type_of(packages[1]), tcp::Body::Type::SysEx);
+  ASSERT_EQ(packages[2].back(), std::byte(0x20));
+}
+
+TEST(TestMidiCoalescer, testWindowHoldsBackFollowingMessages) {
+  asio::io_context io_context;
+  Recorder recorder;
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), DEVICE, std::chrono::milliseconds(20), false,
+      recorder.sink());
+
+  coalescer->push(control_changes(1).front());
+  io_context.run();
+  io_context.restart();
+  ASSERT_EQ(recorder.writes.size(), 1);
+
+  for (const auto &message : control_changes(4)) {
+    coalescer->push(message);
+  }
+  auto start = std::chrono::steady_clock::now();
+  io_context.run();
+
+  ASSERT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(10));
+  ASSERT_EQ(recorder.writes.size(), 2);
+  auto packages = split_packages({recorder.writes[1]});
+  ASSERT_EQ(nr_of_messages(packages[0]), 4);
+}
+
+TEST(TestMidiCoalescer, testCollapseKeepsNewestFaderValue) {
+  asio::io_context io_context;
+  Recorder recorder;
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), DEVICE, std::chrono::microseconds(0), true,
+      recorder.sink());
+
+  for (unsigned char value = 0; value < 50; value++) {
+    coalescer->push(ShortMessage({0xe0, 0x00, value}));
+  }
+  io_context.run();
+
+  auto packages = split_packages(recorder.writes);
+  ASSERT_EQ(packages.size(), 1);
+  ASSERT_EQ(nr_of_messages(packages[0]), 1);
+  ASSERT_EQ(packages[0].back(), std::byte(49));
+  ASSERT_EQ(coalescer->get_filter()->get_collapsed(), 49);
+}
+
+TEST(TestMidiCoalescer, testLastValueOfEveryProducerArrives) {
+  const unsigned char nr_producers = 4;
+  const int nr_values = 200;
+  asio::io_context io_context;
+  auto work = asio::make_work_guard(io_context);
+  std::thread io_thread([&io_context]() { io_context.run(); });
+
+  std::array<std::atomic<int>, nr_producers> last_values;
+  MidiCoalescer::Sink sink = [&last_values](const WriteBatch &batch) {
+    std::vector<std::byte> bytes(batch.size());
+    asio::buffer_copy(asio::buffer(bytes), batch.buffers());
+    for (auto &package : split_packages({bytes})) {
+      auto messages = tcp::PackageView(tcp::BufferView(
+                                           package.data(),
+                                           package.data() + package.size()))
+                          .get_body<tcp::OutgoingMidiBodyView>()
+                          .messages;
+      for (auto it = messages.begin(); it != messages.end(); it += 3) {
+        auto channel = std::to_integer<int>(it[0]) & 0x0f;
+        last_values[channel].store(std::to_integer<int>(it[1]) |
+                                   std::to_integer<int>(it[2]) << 7);
+      }
+    }
+  };
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), DEVICE, std::chrono::microseconds(0), true,
+      sink);
+
+  // A lost wakeup leaves the last values queued until the next push.
+  int failed_round = -1;
+  for (int round = 0; round < 100 && failed_round < 0; round++) {
+    for (auto &last_value : last_values) {
+      last_value.store(-1);
+    }
+    std::vector<std::thread> producers;
+    for (unsigned char channel = 0; channel < nr_producers; channel++) {
+      producers.emplace_back([&coalescer, channel]() {
+        for (int value = 0; value < nr_values; value++) {
+          coalescer->push(ShortMessage(
+              {static_cast<unsigned char>(0xe0 | channel),
+               static_cast<unsigned char>(value & 0x7f),
+               static_cast<unsigned char>(value >> 7)}));
+        }
+      });
+    }
+    for (auto &producer : producers) {
+      producer.join();
+    }
+    auto all_arrived = [&last_values]() {
+      return std::ranges::all_of(last_values, [](const auto &last_value) {
+        return last_value.load() == nr_values - 1;
+      });
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!all_arrived() && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!all_arrived()) {
+      failed_round = round;
+    }
+  }
+
+  work.reset();
+  io_thread.join();
+  ASSERT_EQ(failed_round, -1);
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,235 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "framer.hpp"
+#include "package.hpp"
+
+namespace sls3mcubridge::tcp {
+
+namespace {
+const std::array<std::byte, 16> INCOMMING_MIDI_FRAME = {
+    std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+    std::byte(0x0a), std::byte(0x00), std::byte(0x4d), std::byte(0x4d),
+    std::byte(0x00), std::byte(0x00), std::byte(0x6c), std::byte(0x00),
+    std::byte(0x90), std::byte(0x10), std::byte(0x7f), std::byte(0x00),
+};
+
+const std::array<std::byte, 21> SYSEX_FRAME = {
+    std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+    std::byte(0x0f), std::byte(0x00), std::byte(0x53), std::byte(0x53),
+    std::byte(0x00), std::byte(0x00), std::byte(0x6d), std::byte(0x00),
+    std::byte(0x07), std::byte(0x00), std::byte(0xf0), std::byte(0x00),
+    std::byte(0x00), std::byte(0x66), std::byte(0x15), std::byte(0x00),
+    std::byte(0xf7)};
+
+void feed(StreamFramer &framer, const std::byte *data, size_t size) {
+  auto free_space = framer.prepare();
+  ASSERT_GE(free_space.distance(), size);
+  std::copy(data, data + size, free_space.begin());
+  framer.commit(size);
+}
+
+std::vector<std::byte> to_vector(BufferView<std::byte *> view) {
+  return {view.begin(), view.end()};
+}
+} // namespace
+
+TEST(TestStreamFramer, testSingleFrame) {
+  auto framer = StreamFramer(64);
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+
+  auto frame = framer.next_frame();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(to_vector(*frame), std::vector<std::byte>(
+                                   INCOMMING_MIDI_FRAME.begin(),
+                                   INCOMMING_MIDI_FRAME.end()));
+  ASSERT_FALSE(framer.next_frame().has_value());
+  ASSERT_EQ(framer.buffered(), 0);
+}
+
+TEST(TestStreamFramer, testMultipleFramesInOneRead) {
+  auto framer = StreamFramer(64);
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+  feed(framer, SYSEX_FRAME.data(), SYSEX_FRAME.size());
+
+  auto first = framer.next_frame();
+  auto second = framer.next_frame();
+  ASSERT_TRUE(first.has_value());
+  ASSERT_TRUE(second.has_value());
+  ASSERT_EQ(Package(*first).get_body()->get_type(), Body::Type::IncommingMidi);
+  ASSERT_EQ(Package(*second).get_body()->get_type(), Body::Type::SysEx);
+  ASSERT_FALSE(framer.next_frame().has_value());
+}
+
+TEST(TestStreamFramer, testFrameSplitAcrossReads) {
+  auto framer = StreamFramer(64);
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+  feed(framer, SYSEX_FRAME.data(), 3);
+
+  ASSERT_TRUE(framer.next_frame().has_value());
+  ASSERT_FALSE(framer.next_frame().has_value());
+  framer.compact();
+  ASSERT_EQ(framer.buffered(), 3);
+
+  feed(framer, SYSEX_FRAME.data() + 3, SYSEX_FRAME.size() - 3);
+  auto frame = framer.next_frame();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(to_vector(*frame),
+            std::vector<std::byte>(SYSEX_FRAME.begin(), SYSEX_FRAME.end()));
+}
+
+TEST(TestStreamFramer, testByteByByte) {
+  auto framer = StreamFramer(HEADER_SIZE + 16);
+  size_t frames = 0;
+  for (int round = 0; round < 3; round++) {
+    for (const auto &iter : SYSEX_FRAME) {
+      feed(framer, &iter, 1);
+      while (auto frame = framer.next_frame()) {
+        ASSERT_EQ(frame->distance(), SYSEX_FRAME.size());
+        frames++;
+      }
+      framer.compact();
+    }
+  }
+  ASSERT_EQ(frames, 3);
+}
+
+TEST(TestStreamFramer, testInvalidHeaderThrows) {
+  auto framer = StreamFramer(64);
+  auto corrupt = INCOMMING_MIDI_FRAME;
+  corrupt[1] = std::byte('X');
+  feed(framer, corrupt.data(), corrupt.size());
+
+  ASSERT_THROW(framer.next_frame(), std::invalid_argument);
+  framer.reset();
+  ASSERT_EQ(framer.buffered(), 0);
+}
+
+TEST(TestStreamFramer, testFrameLargerThanCapacityThrows) {
+  auto framer = StreamFramer(HEADER_SIZE + 4);
+  feed(framer, INCOMMING_MIDI_FRAME.data(), HEADER_SIZE);
+
+  ASSERT_THROW(framer.next_frame(), std::length_error);
+}
+
+TEST(TestStreamFramer, testResyncSkipsCorruptBytes) {
+  auto framer = StreamFramer(128, true);
+  const std::array<std::byte, 5> garbage = {std::byte('U'), std::byte(0x13),
+                                            std::byte('U'), std::byte('C'),
+                                            std::byte(0x37)};
+  feed(framer, garbage.data(), garbage.size());
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+  feed(framer, SYSEX_FRAME.data(), SYSEX_FRAME.size());
+  feed(framer, garbage.data(), 3);
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+
+  std::vector<std::vector<std::byte>> frames;
+  while (auto frame = framer.next_frame()) {
+    frames.push_back(to_vector(*frame));
+  }
+  std::vector<std::byte> midi_frame(INCOMMING_MIDI_FRAME.begin(),
+                                    INCOMMING_MIDI_FRAME.end());
+  std::vector<std::byte> sysex_frame(SYSEX_FRAME.begin(), SYSEX_FRAME.end());
+  ASSERT_EQ(frames, (std::vector<std::vector<std::byte>>{
+                        midi_frame, sysex_frame, midi_frame}));
+  ASSERT_EQ(framer.get_resyncs(), 2);
+  ASSERT_EQ(framer.get_skipped_bytes(), 8);
+}
+
+TEST(TestStreamFramer, testResyncKeepsPartialHeader) {
+  auto framer = StreamFramer(64, true);
+  const std::array<std::byte, 8> garbage = {
+      std::byte(0x01), std::byte(0x02), std::byte(0x03), std::byte(0x04),
+      std::byte(0x05), std::byte(0x06), std::byte('U'),  std::byte('C')};
+  feed(framer, garbage.data(), garbage.size());
+
+  ASSERT_FALSE(framer.next_frame().has_value());
+  framer.compact();
+  ASSERT_EQ(framer.buffered(), 2);
+
+  feed(framer, INCOMMING_MIDI_FRAME.data() + 2,
+       INCOMMING_MIDI_FRAME.size() - 2);
+  auto frame = framer.next_frame();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(frame->distance(), INCOMMING_MIDI_FRAME.size());
+  ASSERT_EQ(framer.get_skipped_bytes(), 6);
+}
+
+TEST(TestStreamFramer, testResyncRejectsHeaderNotFollowedByHeader) {
+  auto framer = StreamFramer(64, true);
+  // Looks like a header announcing a 4 byte body of an unknown type, followed
+  // by more garbage.
+  const std::array<std::byte, 12> garbage = {
+      std::byte(0x42), std::byte('U'),  std::byte('C'),  std::byte(0x00),
+      std::byte(0x01), std::byte(0x04), std::byte(0x00), std::byte(0x42),
+      std::byte(0x42), std::byte(0x00), std::byte(0x00), std::byte(0x42)};
+  feed(framer, garbage.data(), garbage.size());
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+
+  auto frame = framer.next_frame();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(to_vector(*frame), std::vector<std::byte>(
+                                   INCOMMING_MIDI_FRAME.begin(),
+                                   INCOMMING_MIDI_FRAME.end()));
+  ASSERT_EQ(framer.get_resyncs(), 1);
+  ASSERT_EQ(framer.get_skipped_bytes(), garbage.size());
+}
+
+TEST(TestStreamFramer, testResyncRejectsUnknownBodyFollowedByHeader) {
+  auto framer = StreamFramer(64, true);
+  // Looks like a frame with a 4 byte body of an unknown type, its length
+  // points right at the next header.
+  const std::array<std::byte, 11> garbage = {
+      std::byte(0x42), std::byte('U'),  std::byte('C'),  std::byte(0x00),
+      std::byte(0x01), std::byte(0x04), std::byte(0x00), std::byte(0x42),
+      std::byte(0x42), std::byte(0x00), std::byte(0x00)};
+  feed(framer, garbage.data(), garbage.size());
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+
+  auto frame = framer.next_frame();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(to_vector(*frame), std::vector<std::byte>(
+                                   INCOMMING_MIDI_FRAME.begin(),
+                                   INCOMMING_MIDI_FRAME.end()));
+  ASSERT_FALSE(framer.next_frame().has_value());
+  ASSERT_EQ(framer.get_skipped_bytes(), garbage.size());
+}
+
+TEST(TestStreamFramer, testResyncRejectsUnknownBodyAtEndOfBuffer) {
+  auto framer = StreamFramer(64, true);
+  // The same frame lookalike, ending exactly where the buffered bytes end.
+  const std::array<std::byte, 11> garbage = {
+      std::byte(0x42), std::byte('U'),  std::byte('C'),  std::byte(0x00),
+      std::byte(0x01), std::byte(0x04), std::byte(0x00), std::byte(0x42),
+      std::byte(0x42), std::byte(0x00), std::byte(0x00)};
+  feed(framer, garbage.data(), garbage.size());
+
+  ASSERT_FALSE(framer.next_frame().has_value());
+  framer.compact();
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+  auto frame = framer.next_frame();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(to_vector(*frame), std::vector<std::byte>(
+                                   INCOMMING_MIDI_FRAME.begin(),
+                                   INCOMMING_MIDI_FRAME.end()));
+  ASSERT_EQ(framer.get_skipped_bytes(), garbage.size());
+}
+
+TEST(TestStreamFramer, testResyncSkipsFrameLargerThanCapacity) {
+  auto framer = StreamFramer(64, true);
+  auto oversized = INCOMMING_MIDI_FRAME;
+  oversized[5] = std::byte(0x10);
+  feed(framer, oversized.data(), oversized.size());
+  feed(framer, INCOMMING_MIDI_FRAME.data(), INCOMMING_MIDI_FRAME.size());
+
+  auto frame = framer.next_frame();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_EQ(framer.get_skipped_bytes(), oversized.size());
+  ASSERT_FALSE(framer.next_frame().has_value());
+}
+
+} // namespace sls3mcubridge::tcp
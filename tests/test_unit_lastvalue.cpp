@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include <vector>
+
+#include "lastvalue.hpp"
+#include "midimessage.hpp"
+
+namespace sls3mcubridge {
+
+TEST(TestLastValueFilter, testNewestFaderValueWins) {
+  std::vector<ShortMessage> messages = {{0xe0, 0x00, 0x10},
+                                        {0xe1, 0x00, 0x10},
+                                        {0xe0, 0x00, 0x20},
+                                        {0xe0, 0x00, 0x30}};
+  auto filter = LastValueFilter(false);
+
+  ASSERT_EQ(filter.collapse(messages), 2);
+  ASSERT_EQ(messages, (std::vector<ShortMessage>{{0xe0, 0x00, 0x30},
+                                                 {0xe1, 0x00, 0x10}}));
+  ASSERT_EQ(filter.get_forwarded(), 2);
+  ASSERT_EQ(filter.get_collapsed(), 2);
+}
+
+TEST(TestLastValueFilter, testControllersAreKeyedSeparately) {
+  std::vector<ShortMessage> messages = {{0xb0, 0x30, 0x01},
+                                        {0xb0, 0x31, 0x02},
+                                        {0xb0, 0x30, 0x03}};
+  auto filter = LastValueFilter(false);
+
+  ASSERT_EQ(filter.collapse(messages), 1);
+  ASSERT_EQ(messages, (std::vector<ShortMessage>{{0xb0, 0x30, 0x03},
+                                                 {0xb0, 0x31, 0x02}}));
+}
+
+TEST(TestLastValueFilter, testNotesAreBarriers) {
+  // fader touch, move, release, move
+  std::vector<ShortMessage> messages = {{0x90, 0x68, 0x7f},
+                                        {0xe0, 0x00, 0x10},
+                                        {0xe0, 0x00, 0x20},
+                                        {0x90, 0x68, 0x00},
+                                        {0xe0, 0x00, 0x30},
+                                        {0xe0, 0x00, 0x40}};
+  auto filter = LastValueFilter(false);
+
+  ASSERT_EQ(filter.collapse(messages), 2);
+  ASSERT_EQ(messages, (std::vector<ShortMessage>{{0x90, 0x68, 0x7f},
+                                                 {0xe0, 0x00, 0x20},
+                                                 {0x90, 0x68, 0x00},
+                                                 {0xe0, 0x00, 0x40}}));
+}
+
+TEST(TestLastValueFilter, testRelativeEncoderTicksAreSummed) {
+  std::vector<ShortMessage> messages = {{0xb0, 0x10, 0x01},
+                                        {0xb0, 0x10, 0x02},
+                                        {0xb0, 0x10, 0x41},
+                                        {0xb0, 0x10, 0x41}};
+  auto filter = LastValueFilter(true);
+
+  ASSERT_EQ(filter.collapse(messages), 2);
+  ASSERT_EQ(messages, (std::vector<ShortMessage>{{0xb0, 0x10, 0x03},
+                                                 {0xb0, 0x10, 0x42}}));
+}
+
+TEST(TestLastValueFilter, testAbsoluteEncoderRingsWithoutRelative) {
+  std::vector<ShortMessage> messages = {{0xb0, 0x10, 0x01},
+                                        {0xb0, 0x10, 0x02}};
+  auto filter = LastValueFilter(false);
+
+  ASSERT_EQ(filter.collapse(messages), 1);
+  ASSERT_EQ(messages, (std::vector<ShortMessage>{{0xb0, 0x10, 0x02}}));
+}
+
+TEST(TestLastValueFilter, testShortMessagesCollapseInPlace) {
+  std::vector<ShortMessage> messages = {{0xb0, 0x10, 0x41},
+                                        {0xe0, 0x00, 0x10},
+                                        {0xb0, 0x10, 0x42},
+                                        {0xe0, 0x00, 0x20}};
+  auto filter = LastValueFilter(true);
+
+  ASSERT_EQ(filter.collapse(messages), 2);
+  ASSERT_EQ(messages, (std::vector<ShortMessage>{{0xb0, 0x10, 0x43},
+                                                 {0xe0, 0x00, 0x20}}));
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "asio/io_context.hpp"
+#include "coalescer.hpp"
+#include "latency.hpp"
+#include "midimessage.hpp"
+#include "writebatch.hpp"
+
+namespace sls3mcubridge {
+
+TEST(TestLatencyHistogram, testBucketsCoverAllValuesInOrder) {
+  ASSERT_EQ(LatencyHistogram::bucket_index(0), 0);
+  for (uint64_t value = 1; value < 100000; value++) {
+    auto index = LatencyHistogram::bucket_index(value);
+    ASSERT_LT(value, LatencyHistogram::bucket_end(index));
+    ASSERT_GE(index, LatencyHistogram::bucket_index(value - 1));
+    ASSERT_LE(index, LatencyHistogram::bucket_index(value - 1) + 1);
+  }
+  ASSERT_EQ(LatencyHistogram::bucket_index(UINT64_MAX),
+            LatencyHistogram::NR_OF_BUCKETS - 1);
+}
+
+TEST(TestLatencyHistogram, testPercentilesWithinBucketPrecision) {
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 1000; i++) {
+    histogram.record(std::chrono::microseconds(i));
+  }
+
+  auto summary = histogram.summarize();
+  ASSERT_EQ(summary.count, 1000);
+  ASSERT_EQ(summary.max, std::chrono::microseconds(1000));
+  ASSERT_GE(summary.p50, std::chrono::microseconds(500));
+  ASSERT_LE(summary.p50, std::chrono::microseconds(500) * 1.125);
+  ASSERT_GE(summary.p99, std::chrono::microseconds(990));
+  ASSERT_LE(summary.p999, summary.max);
+}
+
+TEST(TestLatencyHistogram, testNegativeLatencyAndEmptyHistogram) {
+  LatencyHistogram histogram;
+  histogram.record(std::chrono::nanoseconds(-5));
+  auto summary = histogram.summarize();
+  ASSERT_EQ(summary.count, 1);
+  ASSERT_EQ(summary.max, std::chrono::nanoseconds(0));
+  ASSERT_EQ(LatencyHistogram().summarize().count, 0);
+}
+
+TEST(TestLatencyMonitor, testSamplesAreKeptPerDirectionAndDevice) {
+  LatencyMonitor monitor;
+  monitor.record(LatencyMonitor::Direction::MixerToDaw, 1,
+                 std::chrono::microseconds(10));
+  monitor.record(LatencyMonitor::Direction::DawToMixer, 1,
+                 std::chrono::microseconds(10));
+  monitor.record(LatencyMonitor::Direction::DawToMixer, 1,
+                 std::chrono::microseconds(20));
+  // Ignored, the mixer has no such device.
+  monitor.record(LatencyMonitor::Direction::DawToMixer,
+                 LatencyMonitor::NR_OF_DEVICES, std::chrono::microseconds(1));
+
+  ASSERT_EQ(monitor.get(LatencyMonitor::Direction::MixerToDaw, 1)
+                .summarize()
+                .count,
+            1);
+  ASSERT_EQ(monitor.get(LatencyMonitor::Direction::DawToMixer, 1)
+                .summarize()
+                .count,
+            2);
+  ASSERT_EQ(monitor.get(LatencyMonitor::Direction::DawToMixer, 0)
+                .summarize()
+                .count,
+            0);
+}
+
+TEST(TestLatencyMonitor, testCoalescerMarksOldestMessage) {
+  asio::io_context io_context;
+  std::vector<LatencyMark> marks;
+  auto before = std::chrono::steady_clock::now();
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::microseconds(0),
+      false,
+      [&marks](const WriteBatch &batch) {
+        marks.insert(marks.end(), batch.marks().begin(), batch.marks().end());
+      });
+
+  coalescer->push(ShortMessage({0xb0, 0x10, 0x01}));
+  coalescer->push(ShortMessage({0xb0, 0x11, 0x01}));
+  io_context.run();
+
+  ASSERT_EQ(marks.size(), 1);
+  ASSERT_EQ(marks.front().device, 1);
+  ASSERT_GE(marks.front().received, before);
+}
+
+} // namespace sls3mcubridge
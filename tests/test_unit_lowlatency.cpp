@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "lowlatency.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+int get_option(int fd, int level, int option) {
+  int value = 0;
+  socklen_t size = sizeof(value);
+  getsockopt(fd, level, option, &value, &size);
+  return value;
+}
+
+// A TCP connection on the loopback interface, closed when it goes out of
+// scope.
+class LoopbackConnection {
+public:
+  LoopbackConnection()
+      : m_listener(socket(AF_INET, SOCK_STREAM, 0)),
+        m_client(socket(AF_INET, SOCK_STREAM, 0)) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto *generic = reinterpret_cast<sockaddr *>(&address);
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    bind(m_listener, generic, size);
+    listen(m_listener, 1);
+    getsockname(m_listener, generic, &size);
+    m_connected = connect(m_client, generic, size) == 0;
+  }
+  LoopbackConnection(const LoopbackConnection &obj) = delete;
+  LoopbackConnection(LoopbackConnection &&obj) = delete;
+  LoopbackConnection &operator=(const LoopbackConnection &obj) = delete;
+  LoopbackConnection &operator=(LoopbackConnection &&obj) = delete;
+  ~LoopbackConnection() {
+    close(m_client);
+    close(m_listener);
+  }
+
+  [[nodiscard]] int client() const { return m_client; }
+  [[nodiscard]] bool connected() const { return m_connected; }
+
+private:
+  int m_listener;
+  int m_client;
+  bool m_connected = false;
+};
+} // namespace
+
+TEST(TestLowLatency, testOptionsAreSet) {
+  LoopbackConnection connection;
+  ASSERT_TRUE(connection.connected());
+  LowLatencyConfig config;
+  // SO_BUSY_POLL may need CAP_NET_ADMIN, the other options do not.
+  config.busy_poll = std::chrono::microseconds(0);
+  config.send_buffer = 32 * 1024;
+  config.receive_buffer = 32 * 1024;
+  ASSERT_TRUE(apply_low_latency(connection.client(), config));
+
+  ASSERT_EQ(get_option(connection.client(), IPPROTO_TCP, TCP_NODELAY), 1);
+  // The kernel doubles the requested sizes for its bookkeeping.
+  ASSERT_GE(get_option(connection.client(), SOL_SOCKET, SO_SNDBUF),
+            config.send_buffer);
+  ASSERT_GE(get_option(connection.client(), SOL_SOCKET, SO_RCVBUF),
+            config.receive_buffer);
+  rearm_quickack(connection.client());
+  ASSERT_EQ(get_option(connection.client(), IPPROTO_TCP, TCP_QUICKACK), 1);
+}
+
+TEST(TestLowLatency, testInvalidSocketFails) {
+  ASSERT_FALSE(apply_low_latency(-1, LowLatencyConfig{}));
+}
+
+} // namespace sls3mcubridge
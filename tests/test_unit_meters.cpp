@@ -0,0 +1,229 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asio/executor_work_guard.hpp"
+#include "asio/io_context.hpp"
+#include "coalescer.hpp"
+#include "meters.hpp"
+#include "metrics.hpp"
+#include "midimessage.hpp"
+#include "package.hpp"
+#include "writebatch.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+std::vector<std::byte> to_bytes(const WriteBatch &batch) {
+  std::vector<std::byte> bytes;
+  for (const auto &buffer : batch.buffers()) {
+    const auto *begin = static_cast<const std::byte *>(buffer.data());
+    bytes.insert(bytes.end(), begin, begin + buffer.size());
+  }
+  return bytes;
+}
+
+// Bytes of `messages` sent to the device the way the coalescer sends them.
+std::vector<std::byte> encoded(const std::vector<ShortMessage> &messages) {
+  MessageRun run;
+  for (const auto &message : messages) {
+    run.push_back(message);
+  }
+  WriteBatch batch(MAX_SEGMENT_SIZE);
+  MidiCoalescer::encode(std::byte(0x68), run, batch,
+                        [](const WriteBatch & /*batch*/) {});
+  return to_bytes(batch);
+}
+
+ShortMessage meter(unsigned char data) { return ShortMessage({0xd0, data}); }
+
+// Number of UCNet frames in `bytes`.
+size_t count_frames(const std::vector<std::byte> &bytes) {
+  const size_t body_size_offset = 4;
+  size_t frames = 0;
+  size_t pos = 0;
+  while (pos + tcp::HEADER_SIZE <= bytes.size()) {
+    auto body_size =
+        std::to_integer<size_t>(bytes.at(pos + body_size_offset)) |
+        (std::to_integer<size_t>(bytes.at(pos + body_size_offset + 1)) << 8);
+    pos += tcp::HEADER_SIZE + body_size;
+    frames++;
+  }
+  return pos == bytes.size() ? frames : 0;
+}
+
+struct Written {
+  size_t writes = 0;
+  std::vector<std::byte> bytes;
+
+  void add(const WriteBatch &batch) {
+    writes++;
+    auto added = to_bytes(batch);
+    bytes.insert(bytes.end(), added.begin(), added.end());
+  }
+};
+} // namespace
+
+TEST(TestMeterDecimator, testHighestLevelPerStripInOneWrite) {
+  asio::io_context io_context;
+  Written written;
+  auto meters = std::make_shared<MeterDecimator>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::milliseconds(10),
+      [&written](const WriteBatch &batch) { written.add(batch); });
+
+  ASSERT_TRUE(meters->push(ShortMessage({0xd0, 0x05})));
+  ASSERT_TRUE(meters->push(ShortMessage({0xd0, 0x09})));
+  ASSERT_TRUE(meters->push(ShortMessage({0xd0, 0x03})));
+  ASSERT_TRUE(meters->push(ShortMessage({0xd0, 0x72})));
+  // Overload set and cleared, the clear wins.
+  ASSERT_TRUE(meters->push(ShortMessage({0xd0, 0x7e})));
+  ASSERT_TRUE(meters->push(ShortMessage({0xd0, 0x7f})));
+  io_context.run();
+
+  ASSERT_EQ(written.writes, 1);
+  ASSERT_EQ(written.bytes, encoded({meter(0x09), meter(0x72), meter(0x7f)}));
+}
+
+TEST(TestMeterDecimator, testRefreshesAtMostOncePerInterval) {
+  asio::io_context io_context;
+  Written written;
+  auto interval = std::chrono::milliseconds(20);
+  auto meters = std::make_shared<MeterDecimator>(
+      io_context.get_executor(), std::byte(0x68), interval,
+      [&written](const WriteBatch &batch) { written.add(batch); });
+
+  auto started = std::chrono::steady_clock::now();
+  meters->push(ShortMessage({0xd0, 0x05}));
+  io_context.run();
+  io_context.restart();
+  meters->push(ShortMessage({0xd0, 0x06}));
+  io_context.run();
+
+  ASSERT_GE(std::chrono::steady_clock::now() - started, interval);
+  ASSERT_EQ(written.writes, 2);
+  auto expected = encoded({meter(0x05)});
+  auto second = encoded({meter(0x06)});
+  expected.insert(expected.end(), second.begin(), second.end());
+  ASSERT_EQ(written.bytes, expected);
+}
+
+TEST(TestMeterDecimator, testAllStripsInOneWrite) {
+  asio::io_context io_context;
+  Written written;
+  auto meters = std::make_shared<MeterDecimator>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::milliseconds(10),
+      [&written](const WriteBatch &batch) { written.add(batch); });
+
+  std::vector<ShortMessage> expected;
+  for (unsigned char strip = 0; strip < MeterDecimator::NR_OF_STRIPS;
+       strip++) {
+    auto data = static_cast<unsigned char>((strip << 4) | 0x0c);
+    ASSERT_TRUE(meters->push(ShortMessage({0xd0, data})));
+    expected.push_back(meter(data));
+  }
+  io_context.run();
+
+  ASSERT_EQ(written.writes, 1);
+  // Every meter is a well-formed two byte message in a body of its own.
+  ASSERT_EQ(count_frames(written.bytes), MeterDecimator::NR_OF_STRIPS);
+  ASSERT_EQ(written.bytes, encoded(expected));
+}
+
+TEST(TestMeterDecimator, testOtherMessagesAreNotTaken) {
+  asio::io_context io_context;
+  auto meters = std::make_shared<MeterDecimator>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::milliseconds(10),
+      [](const WriteBatch & /*batch*/) {});
+
+  // Pitch bend and channel pressure on another channel.
+  ASSERT_FALSE(meters->push(ShortMessage({0xe0, 0x00, 0x40})));
+  ASSERT_FALSE(meters->push(ShortMessage({0xd1, 0x05})));
+}
+
+TEST(TestMeterDecimator, testCountsDecimatedMeters) {
+  asio::io_context io_context;
+  auto metrics = std::make_shared<Metrics>();
+  auto meters = std::make_shared<MeterDecimator>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::milliseconds(10),
+      [](const WriteBatch & /*batch*/) {});
+  meters->set_metrics(metrics);
+
+  meters->push(ShortMessage({0xd0, 0x05}));
+  meters->push(ShortMessage({0xd0, 0x04}));
+  meters->push(ShortMessage({0xd0, 0x15}));
+  io_context.run();
+
+  std::ostringstream text;
+  metrics->write_prometheus(text);
+  ASSERT_NE(text.str().find("sls3_decimated_meters_total 1\n"),
+            std::string::npos);
+}
+
+TEST(TestMeterDecimator, testLastLevelOfEveryProducerArrives) {
+  const unsigned char nr_producers = 4;
+  const unsigned char max_level = 0x0c;
+  asio::io_context io_context;
+  auto work = asio::make_work_guard(io_context);
+  std::thread io_thread([&io_context]() { io_context.run(); });
+
+  std::array<std::atomic<int>, nr_producers> last_levels;
+  auto meters = std::make_shared<MeterDecimator>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::milliseconds(0),
+      [&last_levels](const WriteBatch &batch) {
+        // Every meter is a body of its own.
+        auto bytes = to_bytes(batch);
+        for (auto *it = bytes.data(); it != bytes.data() + bytes.size();) {
+          tcp::PackageView package(
+              tcp::BufferView(it, bytes.data() + bytes.size()));
+          const auto &body = package.get_body<tcp::OutgoingMidiBodyView>();
+          auto data = std::to_integer<int>(body.messages.begin()[1]);
+          last_levels.at(data >> 4).store(data & 0x0f);
+          it += package.get_size();
+        }
+      });
+
+  // A lost wakeup leaves the highest levels pending until the next push.
+  int failed_round = -1;
+  for (int round = 0; round < 100 && failed_round < 0; round++) {
+    for (auto &last_level : last_levels) {
+      last_level.store(-1);
+    }
+    std::vector<std::thread> producers;
+    for (unsigned char strip = 0; strip < nr_producers; strip++) {
+      producers.emplace_back([&meters, strip]() {
+        for (unsigned char level = 0; level <= max_level; level++) {
+          meters->push(meter(static_cast<unsigned char>(strip << 4 | level)));
+        }
+      });
+    }
+    for (auto &producer : producers) {
+      producer.join();
+    }
+    auto all_arrived = [&last_levels]() {
+      return std::ranges::all_of(last_levels, [](const auto &last_level) {
+        return last_level.load() == max_level;
+      });
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!all_arrived() && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!all_arrived()) {
+      failed_round = round;
+    }
+  }
+
+  work.reset();
+  io_thread.join();
+  ASSERT_EQ(failed_round, -1);
+}
+
+} // namespace sls3mcubridge
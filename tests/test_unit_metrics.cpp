@@ -0,0 +1,228 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+#include "asio/buffer.hpp"
+#include "asio/io_context.hpp"
+#include "asio/local/stream_protocol.hpp"
+#include "asio/read.hpp"
+#include "coalescer.hpp"
+#include "metrics.hpp"
+#include "midimessage.hpp"
+#include "package.hpp"
+#include "writebatch.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+std::string snapshot(const Metrics &metrics) {
+  std::ostringstream output;
+  metrics.write_prometheus(output);
+  return output.str();
+}
+
+bool contains(const std::string &text, const std::string &line) {
+  return text.find(line + "\n") != std::string::npos;
+}
+
+// Keeps the number of descriptors to take when exhausting them small.
+const rlim_t LOWERED_FILE_LIMIT = 256;
+
+std::string socket_path(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// Takes every free file descriptor until it goes out of scope, so accepting
+// a connection fails with EMFILE.
+class FileDescriptorExhaustion {
+public:
+  FileDescriptorExhaustion() {
+    getrlimit(RLIMIT_NOFILE, &m_limit);
+    rlimit lowered = m_limit;
+    lowered.rlim_cur = std::min(m_limit.rlim_cur, LOWERED_FILE_LIMIT);
+    setrlimit(RLIMIT_NOFILE, &lowered);
+    for (int descriptor = dup(0); descriptor >= 0; descriptor = dup(0)) {
+      m_taken.push_back(descriptor);
+    }
+  }
+  FileDescriptorExhaustion(const FileDescriptorExhaustion &obj) = delete;
+  FileDescriptorExhaustion(FileDescriptorExhaustion &&obj) = delete;
+  FileDescriptorExhaustion &
+  operator=(const FileDescriptorExhaustion &obj) = delete;
+  FileDescriptorExhaustion &operator=(FileDescriptorExhaustion &&obj) = delete;
+  ~FileDescriptorExhaustion() {
+    for (auto descriptor : m_taken) {
+      close(descriptor);
+    }
+    setrlimit(RLIMIT_NOFILE, &m_limit);
+  }
+
+private:
+  rlimit m_limit{};
+  std::vector<int> m_taken;
+};
+} // namespace
+
+TEST(TestMetrics, testCountersInSnapshot) {
+  Metrics metrics;
+  metrics.count_tcp(Metrics::Direction::MixerToDaw, 100);
+  metrics.count_frame(Metrics::Direction::MixerToDaw,
+                      tcp::Body::Type::IncommingMidi, 16);
+  metrics.count_frame(Metrics::Direction::MixerToDaw,
+                      tcp::Body::Type::IncommingMidi, 16);
+  metrics.count_midi(Metrics::Direction::DawToMixer, 2, 3);
+  // Ignored, the mixer has no such device.
+  metrics.count_midi(Metrics::Direction::DawToMixer, Metrics::NR_OF_DEVICES,
+                     3);
+  metrics.count(Metrics::Event::UnknownBody);
+  metrics.count(Metrics::Event::Resync);
+  metrics.count_skipped(7);
+
+  auto text = snapshot(metrics);
+  ASSERT_TRUE(contains(text, "# TYPE sls3_tcp_bytes_total counter"));
+  ASSERT_TRUE(
+      contains(text, "sls3_tcp_bytes_total{direction=\"mixer_to_daw\"} 100"));
+  ASSERT_TRUE(contains(text, "sls3_frames_total{direction=\"mixer_to_daw\","
+                             "type=\"incomming_midi\"} 2"));
+  ASSERT_TRUE(contains(text, "sls3_frame_bytes_total{direction=\"mixer_to_"
+                             "daw\",type=\"incomming_midi\"} 32"));
+  ASSERT_TRUE(contains(
+      text, "sls3_midi_messages_total{direction=\"daw_to_mixer\",device=\"2\"} "
+            "1"));
+  ASSERT_TRUE(contains(text, "sls3_unknown_bodies_total 1"));
+  ASSERT_TRUE(contains(text, "sls3_parse_failures_total 0"));
+  ASSERT_TRUE(contains(text, "sls3_resyncs_total 1"));
+  ASSERT_TRUE(contains(text, "sls3_skipped_bytes_total 7"));
+}
+
+TEST(TestMetrics, testCallbacksShareOneHeader) {
+  Metrics metrics;
+  metrics.add_callback({"sls3_test_depth", "Test gauge.", "gauge",
+                        "device=\"0\"", []() { return 3; }});
+  metrics.add_callback({"sls3_test_depth", "Test gauge.", "gauge",
+                        "device=\"1\"", []() { return 4; }});
+
+  auto text = snapshot(metrics);
+  ASSERT_EQ(text.find("# TYPE sls3_test_depth gauge"),
+            text.rfind("# TYPE sls3_test_depth gauge"));
+  ASSERT_TRUE(contains(text, "sls3_test_depth{device=\"0\"} 3"));
+  ASSERT_TRUE(contains(text, "sls3_test_depth{device=\"1\"} 4"));
+}
+
+TEST(TestMetrics, testCallbacksAddedLaterShareOneHeader) {
+  Metrics metrics;
+  metrics.add_callback({"sls3_test_depth", "Test gauge.", "gauge",
+                        "device=\"0\"", []() { return 3; }});
+  metrics.add_callback({"sls3_test_total", "Test counter.", "counter",
+                        "device=\"0\"", []() { return 5; }});
+  // A device created after a reconnect.
+  metrics.add_callback({"sls3_test_depth", "Test gauge.", "gauge",
+                        "device=\"1\"", []() { return 4; }});
+
+  auto text = snapshot(metrics);
+  ASSERT_EQ(text.find("# TYPE sls3_test_depth gauge"),
+            text.rfind("# TYPE sls3_test_depth gauge"));
+  ASSERT_LT(text.find("sls3_test_depth{device=\"1\"} 4"),
+            text.find("# TYPE sls3_test_total counter"));
+  ASSERT_TRUE(contains(text, "sls3_test_total{device=\"0\"} 5"));
+}
+
+TEST(TestMetrics, testWriteFile) {
+  auto path =
+      (std::filesystem::temp_directory_path() / "test_metrics.prom").string();
+  Metrics metrics;
+  metrics.count(Metrics::Event::ParseFailure);
+  metrics.write_file(path);
+
+  std::ifstream file(path);
+  std::stringstream content;
+  content << file.rdbuf();
+  ASSERT_EQ(content.str(), snapshot(metrics));
+  ASSERT_FALSE(std::filesystem::exists(path + ".tmp"));
+  std::filesystem::remove(path);
+}
+
+TEST(TestMetrics, testCoalescerCountsSentPackages) {
+  asio::io_context io_context;
+  auto metrics = std::make_shared<Metrics>();
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::microseconds(0),
+      false,
+      [](const WriteBatch & /*batch*/) {});
+  coalescer->set_metrics(metrics);
+
+  coalescer->push(ShortMessage({0xb0, 0x10, 0x01}));
+  coalescer->push(ShortMessage({0xb0, 0x11, 0x01}));
+  coalescer->push_sysex(std::vector<unsigned char>{0xf0, 0x00, 0xf7});
+  io_context.run();
+
+  auto text = snapshot(*metrics);
+  ASSERT_TRUE(contains(text, "sls3_frames_total{direction=\"daw_to_mixer\","
+                             "type=\"outgoing_midi\"} 1"));
+  ASSERT_TRUE(contains(
+      text, "sls3_frames_total{direction=\"daw_to_mixer\",type=\"sysex\"} 1"));
+}
+
+TEST(TestMetricsServer, testServesSnapshot) {
+  asio::io_context io_context;
+  auto metrics = std::make_shared<Metrics>();
+  metrics->count(Metrics::Event::ParseFailure);
+  auto path = socket_path("test_metrics_serve.sock");
+  auto server =
+      std::make_shared<MetricsServer>(io_context.get_executor(), path, metrics);
+  server->start();
+
+  asio::local::stream_protocol::socket client(io_context);
+  client.connect(asio::local::stream_protocol::endpoint(path));
+  io_context.run_for(std::chrono::milliseconds(50));
+  std::string received;
+  asio::error_code error;
+  asio::read(client, asio::dynamic_buffer(received), error);
+  ASSERT_EQ(received, snapshot(*metrics));
+
+  // Nothing is left to run once the server stopped.
+  server->stop();
+  io_context.restart();
+  io_context.run();
+  std::filesystem::remove(path);
+}
+
+TEST(TestMetricsServer, testFailingAcceptBacksOff) {
+  asio::io_context io_context;
+  auto metrics = std::make_shared<Metrics>();
+  auto path = socket_path("test_metrics_back_off.sock");
+  auto server =
+      std::make_shared<MetricsServer>(io_context.get_executor(), path, metrics);
+  server->start();
+  asio::local::stream_protocol::socket client(io_context);
+  client.connect(asio::local::stream_protocol::endpoint(path));
+
+  {
+    FileDescriptorExhaustion exhaustion;
+    // Retried every 100 ms instead of right away.
+    auto handlers = io_context.run_for(std::chrono::milliseconds(250));
+    ASSERT_LE(handlers, 5);
+  }
+  // Served once descriptors are free again.
+  io_context.run_for(std::chrono::milliseconds(250));
+  std::string received;
+  asio::error_code error;
+  asio::read(client, asio::dynamic_buffer(received), error);
+  ASSERT_EQ(received, snapshot(*metrics));
+
+  server->stop();
+  io_context.restart();
+  io_context.run();
+  std::filesystem::remove(path);
+}
+
+} // namespace sls3mcubridge
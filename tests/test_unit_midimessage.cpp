@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+#include <array>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "midimessage.hpp"
+
+namespace sls3mcubridge {
+
+TEST(TestShortMessage, testBytesAreInline) {
+  auto message = ShortMessage({0xe0, 0x10, 0x7f});
+
+  ASSERT_EQ(message.size(), 3);
+  ASSERT_EQ(message[0], 0xe0);
+  ASSERT_EQ(message[2], 0x7f);
+  ASSERT_EQ(std::vector<unsigned char>(message.begin(), message.end()),
+            (std::vector<unsigned char>{0xe0, 0x10, 0x7f}));
+  ASSERT_EQ(message.as_bytes().data(),
+            static_cast<const void *>(message.data()));
+}
+
+TEST(TestShortMessage, testCreateByBuffer) {
+  std::array<std::byte, 2> input = {std::byte(0xc0), std::byte(0x05)};
+
+  auto message = ShortMessage(std::span<const std::byte>(input));
+
+  ASSERT_EQ(message, ShortMessage({0xc0, 0x05}));
+  ASSERT_NE(message, ShortMessage({0xc0, 0x05, 0x00}));
+}
+
+TEST(TestShortMessage, testLongMessageThrows) {
+  std::array<unsigned char, 4> input = {0xf0, 0x00, 0x66, 0xf7};
+
+  ASSERT_THROW(ShortMessage(std::span<const unsigned char>(input)),
+               std::length_error);
+}
+
+TEST(TestMessageRun, testSysexKeepsItsPlace) {
+  std::array<unsigned char, 5> sysex = {0xf0, 0x00, 0x66, 0x14, 0xf7};
+  MessageRun run;
+  run.push_back(ShortMessage({0xe0, 0x10, 0x7f}));
+  run.push_back(sysex);
+  run.push_back(ShortMessage({0xd0, 0x15}));
+
+  std::vector<std::vector<unsigned char>> messages;
+  run.for_each([&messages](std::span<const unsigned char> message) {
+    messages.emplace_back(message.begin(), message.end());
+  });
+  ASSERT_EQ(messages, (std::vector<std::vector<unsigned char>>{
+                          {0xe0, 0x10, 0x7f},
+                          {sysex.begin(), sysex.end()},
+                          {0xd0, 0x15}}));
+  // The SysEx message stands in the short messages as its start byte.
+  ASSERT_EQ(run.short_messages().at(1), ShortMessage({0xf0}));
+  ASSERT_EQ(run.nr_sysex(), 1);
+  ASSERT_EQ(run.sysex_size(), sysex.size());
+
+  run.clear();
+  ASSERT_TRUE(run.empty());
+  ASSERT_EQ(run.sysex_size(), 0);
+}
+
+TEST(TestMessageRun, testLongChannelMessageThrows) {
+  std::array<unsigned char, 4> input = {0x90, 0x10, 0x7f, 0x00};
+  MessageRun run;
+
+  ASSERT_THROW(run.push_back(input), std::length_error);
+}
+
+} // namespace sls3mcubridge
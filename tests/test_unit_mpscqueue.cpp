@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "mpscqueue.hpp"
+
+namespace sls3mcubridge {
+
+TEST(TestMpscQueue, testFifoOrder) {
+  auto queue = MpscQueue<int>(4);
+  ASSERT_TRUE(queue.try_push(1));
+  ASSERT_TRUE(queue.try_push(2));
+  ASSERT_TRUE(queue.try_push(3));
+
+  int value = 0;
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_EQ(value, 1);
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_EQ(value, 2);
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_EQ(value, 3);
+  ASSERT_FALSE(queue.try_pop(value));
+}
+
+TEST(TestMpscQueue, testPushFailsWhenFull) {
+  auto queue = MpscQueue<int>(3);
+  ASSERT_EQ(queue.capacity(), 4);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(queue.try_push(i));
+  }
+  ASSERT_FALSE(queue.try_push(4));
+
+  int value = 0;
+  ASSERT_TRUE(queue.try_pop(value));
+  ASSERT_TRUE(queue.try_push(4));
+}
+
+TEST(TestMpscQueue, testConcurrentProducers) {
+  const int producers = 4;
+  const int per_producer = 20000;
+  auto queue = MpscQueue<int>(256);
+
+  std::vector<std::thread> threads;
+  for (int producer = 0; producer < producers; producer++) {
+    threads.emplace_back([&queue, producer]() {
+      for (int i = 0; i < per_producer; i++) {
+        while (!queue.try_push(producer * per_producer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::vector<int> last_seen(producers, -1);
+  int received = 0;
+  while (received < producers * per_producer) {
+    int value = 0;
+    if (!queue.try_pop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto producer = value / per_producer;
+    // Messages of one producer keep their order.
+    ASSERT_GT(value % per_producer, last_seen[producer]);
+    last_seen[producer] = value % per_producer;
+    received++;
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  int value = 0;
+  ASSERT_FALSE(queue.try_pop(value));
+}
+
+} // namespace sls3mcubridge
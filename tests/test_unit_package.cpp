@@ -2,9 +2,13 @@
 #include "gtest/gtest.h"
 #include <array>
 #include <cstddef>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <variant>
 #include <vector>
 
-#include "libremidi/message.hpp"
+#include "midimessage.hpp"
 #include "package.hpp"
 
 namespace sls3mcubridge::tcp {
@@ -30,7 +34,7 @@ TEST(TestTcpPackageCreation, testIncommingmidibodyCreateByArgs) {
       std::byte(0x7f), std::byte(0x00)};
 
   auto device = std::byte(0x6c);
-  auto message = libremidi::message({0x90, 0x10, 0x7f});
+  auto message = ShortMessage({0x90, 0x10, 0x7f});
 
   auto body = IncommingMidiBody(device, message);
 
@@ -71,8 +75,8 @@ TEST(TestTcpPackageCreation, testOutgoingmidibodyCreateByArgs) {
       std::byte(0x30)};
 
   auto device = std::byte(0x68);
-  auto messages = {libremidi::message({0xb0, 0x40, 0x30}),
-                   libremidi::message({0xb0, 0x41, 0x30})};
+  std::vector<ShortMessage> messages = {{0xb0, 0x40, 0x30},
+                                        {0xb0, 0x41, 0x30}};
 
   auto body = OutgoingMidiBody(device, messages);
 
@@ -105,8 +109,9 @@ TEST(TestTcpPackageCreation, testSysexmidibodyCreateByArgs) {
       std::byte(0x15), std::byte(0x00), std::byte(0xf7)};
 
   auto device = std::byte(0x68);
-  auto message = libremidi::message({0xf0, 0x00, 0x00, 0x66, 0x15, 0x00, 0xf7});
-  auto body = SysExMidiBody(device, message);
+  auto message =
+      std::to_array<unsigned char>({0xf0, 0x00, 0x00, 0x66, 0x15, 0x00, 0xf7});
+  auto body = SysExMidiBody(device, std::as_bytes(std::span(message)));
 
   ASSERT_EQ(body.get_type(), Body::Type::SysEx);
   ASSERT_EQ(expected_output, body.serialize());
@@ -154,6 +159,26 @@ TEST(TestTcpPackageCreation, testHeaderCreateByArg) {
   ASSERT_EQ(expected_output, output.serialize());
 }
 
+TEST(TestTcpPackageCreation, testHeaderBodySizeIsLittleEndian) {
+  std::vector<std::byte> expected_output = {std::byte('U'),  std::byte('C'),
+                                            std::byte(0x00), std::byte(0x01),
+                                            std::byte(0x34), std::byte(0x12)};
+
+  auto output = Header();
+  output.set_body_size(0x1234);
+
+  ASSERT_EQ(expected_output, output.serialize());
+  ASSERT_EQ(Header(BufferView(expected_output.data(),
+                              expected_output.data() + HEADER_SIZE))
+                .get_body_size(),
+            0x1234);
+}
+
+TEST(TestTcpPackageCreation, testHeaderRejectsOversizedBody) {
+  auto header = Header();
+  ASSERT_THROW(header.set_body_size(MAX_BODY_SIZE + 1), std::length_error);
+}
+
 TEST(TestTcpPackageCreation, testPackageSerialization) {
   std::array<std::byte, 16> input = {
       std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
@@ -337,4 +362,200 @@ TEST(TestTcpPackageCreation, testInitialBodyGetMidiDevices) {
   ASSERT_EQ(body.get_nr_of_midi_devices(), 3);
 }
 
+TEST(TestTcpPackageView, testIncommingmidibodyViewByBuffer) {
+  std::array<std::byte, 10> input = {
+      std::byte(0x4d), std::byte(0x4d), std::byte(0x00), std::byte(0x00),
+      std::byte(0x6c), std::byte(0x00), std::byte(0x90), std::byte(0x10),
+      std::byte(0x7f), std::byte(0x00)};
+
+  auto body = decode_body(BufferView(input.begin(), input.end()));
+
+  ASSERT_EQ(body.index(), Body::Type::IncommingMidi);
+  const auto &midi_body = std::get<IncommingMidiBodyView>(body);
+  ASSERT_EQ(midi_body.device.get_index(), 0);
+  ASSERT_EQ(std::vector<std::byte>(midi_body.message.begin(),
+                                   midi_body.message.end()),
+            std::vector<std::byte>(input.begin() + 6, input.end() - 1));
+}
+
+TEST(TestTcpPackageView, testOutgoingmidibodyViewByBuffer) {
+  std::array<std::byte, 13> input = {
+      std::byte(0x4d), std::byte(0x41), std::byte(0x00), std::byte(0x00),
+      std::byte(0x68), std::byte(0x00), std::byte(0x02), std::byte(0xb0),
+      std::byte(0x40), std::byte(0x30), std::byte(0xb0), std::byte(0x41),
+      std::byte(0x30)};
+
+  auto body = decode_body(BufferView(input.begin(), input.end()));
+
+  ASSERT_EQ(body.index(), Body::Type::OutgoingMidi);
+  const auto &midi_body = std::get<OutgoingMidiBodyView>(body);
+  ASSERT_EQ(midi_body.device.get_index(), 1);
+  ASSERT_EQ(midi_body.get_nr_of_messages(), 2);
+}
+
+TEST(TestTcpPackageView, testSysexmidibodyViewByBuffer) {
+  std::array<std::byte, 15> input = {
+      std::byte(0x53), std::byte(0x53), std::byte(0x00), std::byte(0x00),
+      std::byte(0x68), std::byte(0x00), std::byte(0x07), std::byte(0x00),
+      std::byte(0xf0), std::byte(0x00), std::byte(0x00), std::byte(0x66),
+      std::byte(0x15), std::byte(0x00), std::byte(0xf7)};
+
+  auto body = decode_body(BufferView(input.begin(), input.end()));
+
+  ASSERT_EQ(body.index(), Body::Type::SysEx);
+  const auto &midi_body = std::get<SysExMidiBodyView>(body);
+  ASSERT_EQ(midi_body.device.get_index(), 1);
+  ASSERT_EQ(midi_body.message.begin(), input.begin() + 8);
+  ASSERT_EQ(midi_body.message.distance(), 7);
+}
+
+TEST(TestTcpPackageView, testSysexmidibodyViewWrongLength) {
+  std::array<std::byte, 14> input = {
+      std::byte(0x53), std::byte(0x53), std::byte(0x00), std::byte(0x00),
+      std::byte(0x68), std::byte(0x00), std::byte(0x07), std::byte(0x00),
+      std::byte(0xf0), std::byte(0x00), std::byte(0x00), std::byte(0x66),
+      std::byte(0x15), std::byte(0xf7)};
+
+  ASSERT_THROW(decode_body(BufferView(input.begin(), input.end())),
+               std::invalid_argument);
+}
+
+TEST(TestTcpPackageView, testLargeSysexRoundTrip) {
+  std::vector<unsigned char> message(1000, 0x41);
+  message.front() = 0xf0;
+  message.back() = 0xf7;
+  std::shared_ptr<Body> body = std::make_shared<SysExMidiBody>(
+      std::byte(0x68), std::as_bytes(std::span(message)));
+  auto bytes = Package(body).serialize();
+
+  // 1008 byte body, 1000 byte SysEx.
+  ASSERT_EQ(bytes[4], std::byte(0xf0));
+  ASSERT_EQ(bytes[5], std::byte(0x03));
+  ASSERT_EQ(bytes[12], std::byte(0xe8));
+  ASSERT_EQ(bytes[13], std::byte(0x03));
+  auto package =
+      PackageView(BufferView(bytes.data(), bytes.data() + bytes.size()));
+  const auto &midi_body = package.get_body<SysExMidiBodyView>();
+  ASSERT_EQ(midi_body.message.distance(), 1000);
+  ASSERT_EQ(midi_body.message.begin()[999], std::byte(0xf7));
+}
+
+TEST(TestTcpPackageCreation, testSysexmidibodyRefersToBuffer) {
+  std::array<std::byte, 15> input = {
+      std::byte(0x53), std::byte(0x53), std::byte(0x00), std::byte(0x00),
+      std::byte(0x68), std::byte(0x00), std::byte(0x07), std::byte(0x00),
+      std::byte(0xf0), std::byte(0x00), std::byte(0x00), std::byte(0x66),
+      std::byte(0x15), std::byte(0x00), std::byte(0xf7)};
+
+  auto body = std::static_pointer_cast<SysExMidiBody>(
+      Body::create(BufferView(input.begin(), input.end())));
+
+  ASSERT_EQ(body->get_message().data(), &input[8]);
+  ASSERT_EQ(body->get_message().size(), 7);
+}
+
+TEST(TestTcpPackageCreation, testOutgoingmidibodyMessagesByBuffer) {
+  std::array<std::byte, 13> input = {
+      std::byte(0x4d), std::byte(0x41), std::byte(0x00), std::byte(0x00),
+      std::byte(0x68), std::byte(0x00), std::byte(0x02), std::byte(0xb0),
+      std::byte(0x40), std::byte(0x30), std::byte(0xb0), std::byte(0x41),
+      std::byte(0x30)};
+
+  auto body = std::static_pointer_cast<OutgoingMidiBody>(
+      Body::create(BufferView(input.begin(), input.end())));
+
+  ASSERT_EQ(body->get_messages().size(), 2);
+  ASSERT_EQ(body->get_messages()[1], ShortMessage({0xb0, 0x41, 0x30}));
+}
+
+TEST(TestTcpPackageView, testUnkownbodyViewByBuffer) {
+  std::array<std::byte, 10> input = {
+      std::byte(0x3d), std::byte(0x4d), std::byte(0x00), std::byte(0x00),
+      std::byte(0x6c), std::byte(0x00), std::byte(0x90), std::byte(0x10),
+      std::byte(0x7f), std::byte(0x00)};
+
+  auto body = decode_body(BufferView(input.begin(), input.end()));
+
+  ASSERT_EQ(body.index(), Body::Type::Unkown);
+  ASSERT_EQ(std::get<UnkownBodyView>(body).content.distance(), 6);
+}
+
+TEST(TestTcpPackageView, testPackageView) {
+  std::array<std::byte, 16> input = {
+      std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+      std::byte(0x0a), std::byte(0x00), std::byte(0x4d), std::byte(0x4d),
+      std::byte(0x00), std::byte(0x00), std::byte(0x6c), std::byte(0x00),
+      std::byte(0x90), std::byte(0x10), std::byte(0x7f), std::byte(0x00),
+  };
+
+  auto output = PackageView(BufferView(input.begin(), input.end()));
+
+  ASSERT_EQ(output.get_type(), Body::Type::IncommingMidi);
+  ASSERT_EQ(output.get_size(), input.size());
+  ASSERT_EQ(output.get_body<IncommingMidiBodyView>().message.distance(), 3);
+}
+
+TEST(TestTcpPackageView, testPackageViewTruncated) {
+  std::array<std::byte, 12> input = {
+      std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+      std::byte(0x0a), std::byte(0x00), std::byte(0x4d), std::byte(0x4d),
+      std::byte(0x00), std::byte(0x00), std::byte(0x6c), std::byte(0x00),
+  };
+
+  ASSERT_THROW(PackageView(BufferView(input.begin(), input.end())),
+               std::invalid_argument);
+}
+
+TEST(TestTcpPackageView, testTypeFromInt) {
+  ASSERT_EQ(Body::type_from_int(0x424f), Body::Type::InitialResponse);
+  ASSERT_EQ(Body::type_from_int(0x4d4d), Body::Type::IncommingMidi);
+  ASSERT_EQ(Body::type_from_int(0x4d41), Body::Type::OutgoingMidi);
+  ASSERT_EQ(Body::type_from_int(0x5353), Body::Type::SysEx);
+  ASSERT_EQ(Body::type_from_int(0x3d4d), Body::Type::Unkown);
+  ASSERT_EQ(Body::type_from_int(0x0000), Body::Type::Unkown);
+}
+
+TEST(TestTcpPackageView, testSysexmidibodyViewMissingFields) {
+  std::array<std::byte, 7> input = {
+      std::byte(0x53), std::byte(0x53), std::byte(0x00), std::byte(0x00),
+      std::byte(0x68), std::byte(0x00), std::byte(0x07)};
+
+  ASSERT_THROW(decode_body(BufferView(input.begin(), input.end())),
+               std::invalid_argument);
+  ASSERT_THROW(Body::create(BufferView(input.begin(), input.end())),
+               std::invalid_argument);
+}
+
+TEST(TestTcpPackageSerializeInto, testPackageSerializeInto) {
+  std::vector<std::byte> expected_output = {
+      std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+      std::byte(0x0d), std::byte(0x00), std::byte(0x4d), std::byte(0x41),
+      std::byte(0x00), std::byte(0x00), std::byte(0x68), std::byte(0x00),
+      std::byte(0x02), std::byte(0xb0), std::byte(0x40), std::byte(0x30),
+      std::byte(0xb0), std::byte(0x41), std::byte(0x30)};
+
+  std::vector<ShortMessage> messages = {{0xb0, 0x40, 0x30},
+                                        {0xb0, 0x41, 0x30}};
+  std::shared_ptr<Body> body =
+      std::make_shared<OutgoingMidiBody>(std::byte(0x68), messages);
+  auto package = Package(body);
+
+  std::array<std::byte, MAX_PACKAGE_SIZE> buffer{};
+  ASSERT_EQ(package.serialized_size(), expected_output.size());
+  auto size = package.serialize_into(buffer);
+  ASSERT_EQ(size, expected_output.size());
+  ASSERT_EQ(std::vector<std::byte>(buffer.begin(), buffer.begin() + size),
+            expected_output);
+}
+
+TEST(TestTcpPackageSerializeInto, testSysexSerializeIntoTooSmall) {
+  auto message =
+      std::to_array<unsigned char>({0xf0, 0x00, 0x00, 0x66, 0x15, 0x00, 0xf7});
+  auto body = SysExMidiBody(std::byte(0x68), std::as_bytes(std::span(message)));
+
+  std::array<std::byte, 14> buffer{};
+  ASSERT_EQ(body.serialized_size(), 15);
+  ASSERT_THROW(body.serialize_into(buffer), std::length_error);
+}
+
 } // namespace sls3mcubridge::tcp
@@ -0,0 +1,51 @@
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <sched.h>
+#include <thread>
+
+#include "realtime.hpp"
+
+namespace sls3mcubridge {
+
+// Every test changes the scheduling of a thread of its own.
+
+TEST(TestRealtime, testInvalidPriorityFails) {
+  RealtimeConfig config;
+  config.priority = 0;
+  bool succeeded = true;
+  std::thread([&]() { succeeded = make_thread_realtime(config, "test"); })
+      .join();
+  ASSERT_FALSE(succeeded);
+}
+
+TEST(TestRealtime, testInvalidCpuFails) {
+  RealtimeConfig config;
+  config.priority = 0;
+  config.cpus = {-1};
+  bool succeeded = true;
+  std::thread([&]() { succeeded = make_thread_realtime(config, "test"); })
+      .join();
+  ASSERT_FALSE(succeeded);
+}
+
+TEST(TestRealtime, testThreadIsPinned) {
+  RealtimeConfig config;
+  config.cpus = {sched_getcpu()};
+  int cpu = -1;
+  std::thread([&]() {
+    // Pinning works without privileges, SCHED_FIFO may not.
+    make_thread_realtime(config, "test");
+    cpu = sched_getcpu();
+  }).join();
+  ASSERT_EQ(cpu, config.cpus.front());
+}
+
+TEST(TestRealtime, testPrefault) {
+  std::thread([]() { prefault_stack(); }).join();
+  // The mallopt() settings would hold for every later test of this binary,
+  // the heap is prefaulted in a child process.
+  EXPECT_EXIT(std::exit(prefault_heap(1024 * 1024) ? 0 : 1),
+              testing::ExitedWithCode(0), "");
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,199 @@
+#include "gtest/gtest.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "asio/io_context.hpp"
+#include "coalescer.hpp"
+#include "metrics.hpp"
+#include "midimessage.hpp"
+#include "surfacestate.hpp"
+#include "writebatch.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+using Bytes = std::vector<unsigned char>;
+
+std::vector<Bytes> messages_of(const MessageRun &run) {
+  std::vector<Bytes> output;
+  run.for_each([&output](std::span<const unsigned char> message) {
+    output.emplace_back(message.begin(), message.end());
+  });
+  return output;
+}
+
+std::vector<Bytes> replay(const SurfaceState &surface) {
+  MessageRun messages;
+  surface.replay(messages);
+  return messages_of(messages);
+}
+
+Bytes lcd_message(uint8_t offset, const std::string &text) {
+  Bytes message = {0xf0, 0x00, 0x00, 0x66, 0x14, 0x12, offset};
+  for (auto character : text) {
+    message.push_back(static_cast<unsigned char>(character));
+  }
+  message.push_back(0xf7);
+  return message;
+}
+} // namespace
+
+TEST(TestSurfaceState, testNothingToReplayAfterPowerUp) {
+  SurfaceState surface;
+  ASSERT_TRUE(replay(surface).empty());
+}
+
+TEST(TestSurfaceState, testReplaysOnlyChangedState) {
+  SurfaceState surface;
+  // LED on, LED switched off again, fader, V-pot ring, timecode digit and a
+  // meter, which is not mirrored.
+  surface.update_from_daw(Bytes({0x90, 0x10, 0x7f}));
+  surface.update_from_daw(Bytes({0x90, 0x11, 0x01}));
+  surface.update_from_daw(Bytes({0x90, 0x11, 0x00}));
+  surface.update_from_daw(Bytes({0xe3, 0x12, 0x34}));
+  surface.update_from_daw(Bytes({0xb0, 0x32, 0x15}));
+  surface.update_from_daw(Bytes({0xb0, 0x49, 0x31}));
+  surface.update_from_daw(Bytes({0xd0, 0x1c}));
+
+  ASSERT_EQ(replay(surface), (std::vector<Bytes>{
+                                 {0xb0, 0x49, 0x31},
+                                 {0xb0, 0x32, 0x15},
+                                 {0x90, 0x10, 0x7f},
+                                 {0xe3, 0x12, 0x34}}));
+}
+
+TEST(TestSurfaceState, testLcdUpdatesReplayAsOneMessage) {
+  SurfaceState surface;
+  // "AB" at the start of the first line, "C" at the start of the second.
+  surface.update_from_daw(Bytes(
+      {0xf0, 0x00, 0x00, 0x66, 0x15, 0x12, 0x02, 0x41, 0x42, 0xf7}));
+  surface.update_from_daw(Bytes(
+      {0xf0, 0x00, 0x00, 0x66, 0x15, 0x12, 0x38, 0x43, 0xf7}));
+  // Past the end of the LCD.
+  surface.update_from_daw(Bytes(
+      {0xf0, 0x00, 0x00, 0x66, 0x15, 0x12, 0x6f, 0x44, 0x45, 0xf7}));
+
+  // One range from the first to the last character set, the blanks in
+  // between included.
+  Bytes characters(0x6f - 0x02 + 1, 0x20);
+  characters.at(0) = 0x41;
+  characters.at(1) = 0x42;
+  characters.at(0x38 - 0x02) = 0x43;
+  characters.at(0x6f - 0x02) = 0x44;
+  Bytes expected = {0xf0, 0x00, 0x00, 0x66, 0x15, 0x12, 0x02};
+  expected.insert(expected.end(), characters.begin(), characters.end());
+  expected.push_back(0xf7);
+  ASSERT_EQ(replay(surface), std::vector<Bytes>{expected});
+}
+
+TEST(TestSurfaceState, testSurfaceFaderMovesAreMirrored) {
+  SurfaceState surface;
+  surface.update_from_daw(Bytes({0xe0, 0x00, 0x40}));
+  std::array<std::byte, 3> moved = {std::byte(0xe0), std::byte(0x7f),
+                                    std::byte(0x7f)};
+  surface.update_from_surface(moved);
+  // Buttons pressed on the surface do not light their LED.
+  std::array<std::byte, 3> pressed = {std::byte(0x90), std::byte(0x10),
+                                      std::byte(0x7f)};
+  surface.update_from_surface(pressed);
+
+  ASSERT_EQ(surface.get_fader(0), 0x3fff);
+  ASSERT_EQ(surface.get_led(0x10), 0);
+}
+
+TEST(TestSurfaceState, testCoalescerUpdatesSurface) {
+  asio::io_context io_context;
+  auto surface = std::make_shared<SurfaceState>();
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::microseconds(0),
+      false,
+      [](const WriteBatch & /*batch*/) {});
+  coalescer->set_surface_state(surface);
+
+  coalescer->push(ShortMessage({0x90, 0x10, 0x7f}));
+  ASSERT_EQ(surface->get_led(0x10), 0);
+  io_context.run();
+
+  ASSERT_EQ(surface->get_led(0x10), 0x7f);
+}
+
+TEST(TestSurfaceState, testLcdDiffOnlyWritesChangedCharacters) {
+  SurfaceState surface;
+  MessageRun updates;
+  // Unknown characters are written even when blank.
+  ASSERT_TRUE(surface.diff_lcd(lcd_message(0x00, "Vol  "), updates));
+  ASSERT_EQ(messages_of(updates),
+            std::vector<Bytes>{lcd_message(0x00, "Vol  ")});
+
+  updates.clear();
+  ASSERT_TRUE(surface.diff_lcd(lcd_message(0x00, "Vol 1"), updates));
+  ASSERT_EQ(messages_of(updates), std::vector<Bytes>{lcd_message(0x04, "1")});
+
+  updates.clear();
+  ASSERT_TRUE(surface.diff_lcd(lcd_message(0x00, "Vol 1"), updates));
+  ASSERT_TRUE(updates.empty());
+
+  surface.forget_lcd();
+  ASSERT_TRUE(surface.diff_lcd(lcd_message(0x00, "Vol 1"), updates));
+  ASSERT_EQ(updates.size(), 1);
+
+  ASSERT_FALSE(
+      surface.diff_lcd(Bytes{0x90, 0x10, 0x7f}, updates));
+  ASSERT_EQ(updates.size(), 1);
+}
+
+TEST(TestSurfaceState, testLcdDiffMergesCloseChanges) {
+  SurfaceState surface;
+  MessageRun updates;
+  std::string line(56, 'a');
+  surface.diff_lcd(lcd_message(0x00, line), updates);
+
+  // Sending the unchanged character in between is shorter than a second
+  // message.
+  line.at(0) = 'b';
+  line.at(2) = 'b';
+  // Far enough apart for a message of its own.
+  line.at(50) = 'b';
+  updates.clear();
+  surface.diff_lcd(lcd_message(0x00, line), updates);
+
+  ASSERT_EQ(messages_of(updates),
+            (std::vector<Bytes>{lcd_message(0x00, "bab"),
+                                lcd_message(50, "b")}));
+}
+
+TEST(TestSurfaceState, testCoalescerDropsUnchangedLcdRewrites) {
+  asio::io_context io_context;
+  auto metrics = std::make_shared<Metrics>();
+  size_t written = 0;
+  auto coalescer = std::make_shared<MidiCoalescer>(
+      io_context.get_executor(), std::byte(0x68), std::chrono::microseconds(0),
+      false,
+      [&written](const WriteBatch &batch) { written += batch.size(); });
+  coalescer->set_metrics(metrics);
+  coalescer->set_surface_state(std::make_shared<SurfaceState>());
+  coalescer->set_compress_lcd(true);
+
+  coalescer->push_sysex(lcd_message(0x00, "Track 1"));
+  io_context.run();
+  auto first_write = written;
+  io_context.restart();
+  coalescer->push_sysex(lcd_message(0x00, "Track 1"));
+  io_context.run();
+
+  ASSERT_GT(first_write, 0);
+  ASSERT_EQ(written, first_write);
+  std::ostringstream text;
+  metrics->write_prometheus(text);
+  ASSERT_NE(text.str().find("sls3_lcd_bytes_saved_total{device=\"1\"} " +
+                            std::to_string(first_write) + "\n"),
+            std::string::npos);
+}
+
+} // namespace sls3mcubridge
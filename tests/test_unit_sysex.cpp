@@ -0,0 +1,78 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <span>
+#include <vector>
+
+#include "sysex.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+std::vector<std::byte> bytes(std::initializer_list<int> values) {
+  std::vector<std::byte> output;
+  for (auto value : values) {
+    output.push_back(std::byte(value));
+  }
+  return output;
+}
+
+std::vector<std::byte> to_vector(std::span<const std::byte> message) {
+  return {message.begin(), message.end()};
+}
+} // namespace
+
+TEST(TestSysExAssembler, testCompleteMessageIsNotCopied) {
+  SysExAssembler assembler;
+  auto message = bytes({0xf0, 0x00, 0x66, 0xf7});
+
+  auto output = assembler.add(message);
+
+  ASSERT_EQ(output.data(), message.data());
+  ASSERT_EQ(output.size(), message.size());
+  ASSERT_FALSE(assembler.was_assembled());
+}
+
+TEST(TestSysExAssembler, testFragmentsAreJoined) {
+  SysExAssembler assembler;
+  ASSERT_TRUE(assembler.add(bytes({0xf0, 0x00})).empty());
+  ASSERT_TRUE(assembler.add(bytes({0x66, 0x14})).empty());
+  auto output = assembler.add(bytes({0x12, 0xf7}));
+
+  ASSERT_EQ(to_vector(output), bytes({0xf0, 0x00, 0x66, 0x14, 0x12, 0xf7}));
+  ASSERT_TRUE(assembler.was_assembled());
+
+  // The next message starts from scratch.
+  ASSERT_TRUE(assembler.add(bytes({0xf0, 0x01})).empty());
+  ASSERT_EQ(to_vector(assembler.add(bytes({0xf7}))), bytes({0xf0, 0x01, 0xf7}));
+}
+
+TEST(TestSysExAssembler, testIncompleteMessagesAreDropped) {
+  SysExAssembler assembler;
+  // A continuation without start.
+  ASSERT_TRUE(assembler.add(bytes({0x00, 0xf7})).empty());
+  // A start replacing an incomplete message.
+  ASSERT_TRUE(assembler.add(bytes({0xf0, 0x00})).empty());
+  ASSERT_TRUE(assembler.add(bytes({0xf0, 0x01})).empty());
+  ASSERT_EQ(to_vector(assembler.add(bytes({0xf7}))), bytes({0xf0, 0x01, 0xf7}));
+}
+
+TEST(TestSysExAssembler, testMultiKilobyteMessage) {
+  SysExAssembler assembler;
+  std::vector<std::byte> message(16384, std::byte(0x41));
+  message.front() = std::byte(0xf0);
+  message.back() = std::byte(0xf7);
+
+  std::span<const std::byte> remaining(message);
+  std::span<const std::byte> output;
+  while (!remaining.empty()) {
+    auto fragment = remaining.first(std::min<size_t>(remaining.size(), 255));
+    output = assembler.add(fragment);
+    remaining = remaining.subspan(fragment.size());
+  }
+
+  ASSERT_EQ(to_vector(output), message);
+}
+
+} // namespace sls3mcubridge
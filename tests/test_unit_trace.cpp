@@ -0,0 +1,162 @@
+#include "gtest/gtest.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "package.hpp"
+#include "trace.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+const std::array<std::byte, 3> NOTE_ON_BYTES = {
+    std::byte(0x90), std::byte(0x10), std::byte(0x7f)};
+
+std::string trace_path(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// The trace holds the records of every thread that traced in this process,
+// each test records from a thread of its own on a device no other test uses.
+std::vector<TraceRecord> dump_device(const std::string &path, uint8_t device) {
+  std::vector<TraceRecord> records;
+  if (!dump_trace()) {
+    return records;
+  }
+  TraceReader reader(path);
+  TraceRecord record;
+  while (reader.next(record)) {
+    if (record.device == device) {
+      records.push_back(record);
+    }
+  }
+  std::filesystem::remove(path);
+  return records;
+}
+} // namespace
+
+TEST(TestTrace, testRecordsAreDumped) {
+  const uint8_t device = 1;
+  auto path = trace_path("test_trace_dumped.trace");
+  enable_tracing(path);
+  std::thread([&]() {
+    trace(TraceStage::MixerFrame, device, tcp::Body::Type::IncommingMidi,
+          NOTE_ON_BYTES);
+    trace(TraceStage::TcpWrite, device, 100);
+  }).join();
+  auto records = dump_device(path, device);
+  disable_tracing();
+
+  ASSERT_EQ(records.size(), 2);
+  ASSERT_EQ(records.at(0).stage, TraceStage::MixerFrame);
+  ASSERT_EQ(records.at(0).body_type, tcp::Body::Type::IncommingMidi);
+  ASSERT_EQ(records.at(0).size, NOTE_ON_BYTES.size());
+  ASSERT_EQ(records.at(0).kept, NOTE_ON_BYTES.size());
+  ASSERT_TRUE(std::equal(NOTE_ON_BYTES.begin(), NOTE_ON_BYTES.end(),
+                         records.at(0).bytes.begin()));
+  ASSERT_EQ(records.at(1).stage, TraceStage::TcpWrite);
+  ASSERT_EQ(records.at(1).body_type, TRACE_NONE);
+  ASSERT_EQ(records.at(1).size, 100);
+  ASSERT_EQ(records.at(1).kept, 0);
+  ASSERT_GE(records.at(1).timestamp, records.at(0).timestamp);
+}
+
+TEST(TestTrace, testDisabledRecordsNothing) {
+  const uint8_t device = 2;
+  auto path = trace_path("test_trace_disabled.trace");
+  disable_tracing();
+  std::thread([&]() {
+    trace(TraceStage::MidiFromDaw, device, TRACE_NONE, NOTE_ON_BYTES);
+  }).join();
+  enable_tracing(path);
+  auto records = dump_device(path, device);
+  disable_tracing();
+  ASSERT_TRUE(records.empty());
+}
+
+TEST(TestTrace, testLongMessagesAreCut) {
+  const uint8_t device = 3;
+  auto path = trace_path("test_trace_cut.trace");
+  std::vector<std::byte> sysex(300, std::byte(0x42));
+  enable_tracing(path);
+  std::thread([&]() {
+    trace(TraceStage::MidiToDaw, device, TRACE_NONE, sysex);
+  }).join();
+  auto records = dump_device(path, device);
+  disable_tracing();
+
+  ASSERT_EQ(records.size(), 1);
+  ASSERT_EQ(records.at(0).size, sysex.size());
+  ASSERT_EQ(records.at(0).kept, size_t{TraceRecord::MAX_BYTES});
+}
+
+TEST(TestTrace, testRingKeepsLastRecords) {
+  auto path = trace_path("test_trace_ring.bin");
+  auto ring = std::make_unique<TraceRing>(0);
+  const size_t nr_records = TraceRing::CAPACITY + 10;
+  for (size_t i = 0; i < nr_records; i++) {
+    ring->record(TraceStage::TcpWritten, TRACE_NONE, TRACE_NONE, i, {});
+  }
+  auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_TRUE(ring->write_to(fd));
+  ::close(fd);
+
+  std::vector<TraceRecord> records(TraceRing::CAPACITY + 1);
+  std::ifstream file(path, std::ios::binary);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  file.read(reinterpret_cast<char *>(records.data()),
+            static_cast<std::streamsize>(records.size() * sizeof(TraceRecord)));
+  ASSERT_EQ(file.gcount(), TraceRing::CAPACITY * sizeof(TraceRecord));
+  for (size_t i = 0; i < TraceRing::CAPACITY; i++) {
+    ASSERT_EQ(records.at(i).size, nr_records - TraceRing::CAPACITY + i);
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(TestTrace, testReaderRejectsOtherFiles) {
+  auto path = trace_path("test_trace_not_a_trace.trace");
+  {
+    std::ofstream file(path);
+    file << "not a trace";
+  }
+  ASSERT_THROW(TraceReader{path}, std::runtime_error);
+  std::filesystem::remove(path);
+}
+
+TEST(TestTrace, testChromeTrace) {
+  const uint8_t device = 4;
+  auto path = trace_path("test_trace_chrome.trace");
+  enable_tracing(path);
+  std::thread([&]() {
+    trace(TraceStage::MidiFromDaw, device, TRACE_NONE, NOTE_ON_BYTES);
+  }).join();
+  ASSERT_TRUE(dump_trace());
+  disable_tracing();
+
+  TraceReader reader(path);
+  std::stringstream json;
+  write_chrome_trace(reader, json);
+  auto output = json.str();
+  ASSERT_EQ(output.find(R"({"displayTimeUnit":"ns","traceEvents":[)"), 0);
+  ASSERT_NE(output.find(R"("name":"midi_from_daw","ph":"i")"),
+            std::string::npos);
+  ASSERT_NE(output.find(R"("device":4,"bytes":"90 10 7f")"),
+            std::string::npos);
+  ASSERT_NE(output.find(R"("name":"thread_name","ph":"M")"),
+            std::string::npos);
+  ASSERT_EQ(output.substr(output.size() - 3), "]}\n");
+  std::filesystem::remove(path);
+}
+
+} // namespace sls3mcubridge
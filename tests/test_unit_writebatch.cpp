@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "asio/buffer.hpp"
+#include "midimessage.hpp"
+#include "package.hpp"
+#include "writebatch.hpp"
+
+namespace sls3mcubridge {
+
+namespace {
+std::vector<std::byte> flatten(const WriteBatch &batch) {
+  std::vector<std::byte> output(batch.size());
+  asio::buffer_copy(asio::buffer(output), batch.buffers());
+  return output;
+}
+} // namespace
+
+TEST(TestWriteBatch, testConsecutivePackagesShareOneBuffer) {
+  auto first = tcp::IncommingMidiBody(std::byte(0x6c),
+                                      ShortMessage({0x90, 0x10, 0x7f}));
+  auto second = tcp::IncommingMidiBody(std::byte(0x6d),
+                                       ShortMessage({0x90, 0x11, 0x00}));
+  auto batch = WriteBatch(64);
+
+  ASSERT_TRUE(batch.add(first));
+  ASSERT_TRUE(batch.add(second));
+
+  ASSERT_EQ(batch.buffers().size(), 1);
+  ASSERT_EQ(batch.size(), first.get_size() + second.get_size());
+  auto expected = first.serialize();
+  auto second_bytes = second.serialize();
+  expected.insert(expected.end(), second_bytes.begin(), second_bytes.end());
+  ASSERT_EQ(flatten(batch), expected);
+}
+
+TEST(TestWriteBatch, testRawBuffersAreGathered) {
+  const std::array<std::byte, 2> raw = {std::byte('U'), std::byte('C')};
+  auto body = tcp::IncommingMidiBody(std::byte(0x6c),
+                                     ShortMessage({0x90, 0x10, 0x7f}));
+  auto batch = WriteBatch(64);
+
+  batch.add(asio::buffer(raw));
+  ASSERT_TRUE(batch.add(body));
+  batch.add(asio::buffer(raw));
+
+  ASSERT_EQ(batch.buffers().size(), 3);
+  ASSERT_EQ(batch.buffers().front().data(), raw.data());
+  ASSERT_EQ(batch.size(), 2 * raw.size() + body.get_size());
+}
+
+TEST(TestWriteBatch, testAddFailsWhenFull) {
+  auto body = tcp::IncommingMidiBody(std::byte(0x6c),
+                                     ShortMessage({0x90, 0x10, 0x7f}));
+  auto batch = WriteBatch(body.get_size() + 1);
+
+  ASSERT_TRUE(batch.add(body));
+  ASSERT_FALSE(batch.add(body));
+  ASSERT_EQ(batch.size(), body.get_size());
+
+  batch.clear();
+  ASSERT_TRUE(batch.empty());
+  ASSERT_TRUE(batch.add(body));
+}
+
+TEST(TestWriteBatch, testAddCopyMergesWithSerializedPackages) {
+  const std::array<std::byte, 2> raw = {std::byte('U'), std::byte('C')};
+  auto body = tcp::IncommingMidiBody(std::byte(0x6c),
+                                     ShortMessage({0x90, 0x10, 0x7f}));
+  auto batch = WriteBatch(body.get_size() + raw.size());
+
+  ASSERT_TRUE(batch.add(body));
+  ASSERT_TRUE(batch.add_copy(asio::buffer(raw)));
+  ASSERT_FALSE(batch.add_copy(asio::buffer(raw)));
+
+  ASSERT_EQ(batch.buffers().size(), 1);
+  auto expected = body.serialize();
+  expected.insert(expected.end(), raw.begin(), raw.end());
+  ASSERT_EQ(flatten(batch), expected);
+}
+
+} // namespace sls3mcubridge
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/signal_set.hpp"
+#include "asio/steady_timer.hpp"
+#include "cxxopts.hpp"
+#include "spdlog/spdlog.h"
+
+#include "capture.hpp"
+#include "mockmixer.hpp"
+
+// Runs the mixer stand-in of mockmixer.hpp until interrupted.
+
+namespace sls3mcubridge {
+
+namespace {
+const int PORT = 53000;
+const int MAX_DEVICES = 5;
+} // namespace
+
+} // namespace sls3mcubridge
+
+int main(int argc, char **argv) {
+  cxxopts::Options options(
+      "sls3_mcu_bridge_mock_mixer",
+      "Stand-in for a Presonus Studio Live Series 3 mixer to test the bridge");
+
+  cxxopts::ParseResult parse_result;
+  try {
+    options.add_options()("port", "tcp port to listen on.",
+                          cxxopts::value<int>()->default_value(
+                              std::to_string(sls3mcubridge::PORT)))(
+        "devices", "number of midi devices announced to the bridge (1-5).",
+        cxxopts::value<int>()->default_value("1"))(
+        "rate", "packages per second sent after the handshake.",
+        cxxopts::value<double>()->default_value("0"))(
+        "burst", "packages sent back to back.",
+        cxxopts::value<int>()->default_value("1"))(
+        "sysex-every",
+        "make every nth package an LCD SysEx instead of a fader move, 0 for "
+        "never.",
+        cxxopts::value<int>()->default_value("0"))(
+        "disconnect-after",
+        "drop the connection after this many packages of the bridge, 0 for "
+        "never.",
+        cxxopts::value<int>()->default_value("0"))(
+        "duration", "seconds to run, 0 runs until interrupted.",
+        cxxopts::value<int>()->default_value("0"))(
+        "record", "capture all traffic to this file.",
+        cxxopts::value<std::string>());
+    parse_result = options.parse(argc, argv);
+  } catch (const std::exception &exc) {
+    std::cout << exc.what() << "\n" << "\n";
+    std::cout << options.help() << "\n";
+    return -1;
+  }
+
+  sls3mcubridge::TrafficConfig config;
+  config.devices = std::clamp(parse_result["devices"].as<int>(), 1,
+                              sls3mcubridge::MAX_DEVICES);
+  config.rate = parse_result["rate"].as<double>();
+  config.burst =
+      static_cast<size_t>(std::max(parse_result["burst"].as<int>(), 1));
+  config.sysex_every =
+      static_cast<size_t>(std::max(parse_result["sysex-every"].as<int>(), 0));
+  config.disconnect_after = static_cast<size_t>(
+      std::max(parse_result["disconnect-after"].as<int>(), 0));
+
+  try {
+    std::shared_ptr<sls3mcubridge::CaptureWriter> capture;
+    if (parse_result["record"].count() > 0) {
+      capture = std::make_shared<sls3mcubridge::CaptureWriter>(
+          parse_result["record"].as<std::string>());
+    }
+
+    asio::io_context io_context;
+    asio::ip::tcp::acceptor acceptor(
+        io_context,
+        asio::ip::tcp::endpoint(asio::ip::tcp::v4(),
+                                static_cast<uint16_t>(
+                                    parse_result["port"].as<int>())));
+    spdlog::info("Mock mixer listening on port " +
+                 std::to_string(acceptor.local_endpoint().port()));
+    sls3mcubridge::serve_mock_mixer(io_context, acceptor, config, capture);
+
+    asio::signal_set signals(io_context, SIGINT, SIGTERM);
+    signals.async_wait([&io_context](const asio::error_code & /*error*/,
+                                     int /*signal*/) { io_context.stop(); });
+    asio::steady_timer duration(io_context);
+    if (parse_result["duration"].as<int>() > 0) {
+      duration.expires_after(
+          std::chrono::seconds(parse_result["duration"].as<int>()));
+      duration.async_wait([&io_context](const asio::error_code &error) {
+        if (!error) {
+          io_context.stop();
+        }
+      });
+    }
+
+    io_context.run();
+  } catch (const std::exception &exc) {
+    spdlog::error("Mock mixer failed: " + std::string(exc.what()));
+    return -1;
+  }
+}
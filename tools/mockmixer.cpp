@@ -0,0 +1,293 @@
+#include "mockmixer.hpp"
+
+#include "capture.hpp"
+#include "framer.hpp"
+#include "midimessage.hpp"
+#include "package.hpp"
+#include "writebatch.hpp"
+
+#include "asio/buffer.hpp"
+#include "asio/error.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/steady_timer.hpp"
+#include "asio/write.hpp"
+#include "spdlog/spdlog.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace sls3mcubridge {
+
+namespace {
+const size_t RECEIVE_BUFFER_SIZE = 1500;
+// Upper bound of the packages the mock sends, far below tcp::MAX_PACKAGE_SIZE.
+const size_t MAX_SENT_PACKAGE_SIZE = tcp::HEADER_SIZE + UINT8_MAX;
+const std::chrono::seconds REPORT_INTERVAL(1);
+
+// Device bytes of mixer to DAW traffic, 0x6c is the MAIN device.
+const uint8_t INCOMMING_MIDI_DEVICE_BASE = 0x6c;
+const std::byte INITIAL_RESPONSE_THIRD_BYTE = std::byte(0x65);
+const std::string_view MIDI_STRING = "midi";
+
+const size_t FADERS_PER_DEVICE = 8;
+// Mackie LCD update of 7 characters at offset 0.
+const std::array<unsigned char, 15> LCD_SYSEX = {
+    0xf0, 0x00, 0x00, 0x66, 0x14, 0x12, 0x00, 'M',
+    'o',  'c',  'k',  ' ',  ' ',  ' ',  0xf7};
+// Last character of the update, shows a counter.
+const size_t LCD_SYSEX_COUNTER = 13;
+const size_t DECIMAL_BASE = 10;
+
+class MockMixer : public std::enable_shared_from_this<MockMixer> {
+public:
+  MockMixer(asio::io_context &io_context, asio::ip::tcp::socket socket,
+            const TrafficConfig &config,
+            std::shared_ptr<CaptureWriter> capture)
+      : m_socket(std::move(socket)), m_config(config),
+        m_capture(std::move(capture)), m_burst_timer(io_context),
+        m_report_timer(io_context), m_framer(RECEIVE_BUFFER_SIZE),
+        m_batch(config.burst * MAX_SENT_PACKAGE_SIZE) {}
+
+  void start() {
+    spdlog::info("Bridge connected");
+    read();
+    report();
+  }
+
+private:
+  enum class State : uint8_t { WaitForHello, WaitForSetup, Running };
+
+  void read() {
+    auto free_space = m_framer.prepare();
+    m_socket.async_read_some(
+        asio::buffer(free_space.begin(), free_space.distance()),
+        [self = shared_from_this()](const asio::error_code &error,
+                                    size_t bytes_transferred) {
+          self->handle_read(error, bytes_transferred);
+        });
+  }
+
+  void handle_read(const asio::error_code &error, size_t bytes_transferred) {
+    if (error) {
+      spdlog::info("Bridge disconnected: " + error.message());
+      m_burst_timer.cancel();
+      m_report_timer.cancel();
+      return;
+    }
+    if (m_capture) {
+      m_capture->record(CaptureSource::TcpRead, 0,
+                        {m_framer.prepare().begin(), bytes_transferred});
+    }
+    m_framer.commit(bytes_transferred);
+    m_received_bytes += bytes_transferred;
+    try {
+      while (auto frame = m_framer.next_frame()) {
+        handle_package(tcp::PackageView(*frame));
+      }
+    } catch (const std::exception &exc) {
+      spdlog::warn("Received invalid data: " + std::string(exc.what()));
+      m_framer.reset();
+    }
+    m_framer.compact();
+    read();
+  }
+
+  void handle_package(const tcp::PackageView &package) {
+    m_received_packages++;
+    switch (m_state) {
+    case State::WaitForHello:
+      // The first package of the bridge asks for the midi devices.
+      send_initial_response();
+      m_state = State::WaitForSetup;
+      break;
+    case State::WaitForSetup:
+      // Followed by the device setup, after which the bridge is ready.
+      if (package.get_type() == tcp::Body::Type::InitialResponse) {
+        spdlog::info("Handshake done");
+        m_state = State::Running;
+        m_next_burst = std::chrono::steady_clock::now();
+        schedule_burst();
+      }
+      break;
+    case State::Running:
+    default:
+      if (m_config.disconnect_after > 0 &&
+          ++m_running_packages == m_config.disconnect_after) {
+        disconnect();
+      }
+      break;
+    }
+  }
+
+  void disconnect() {
+    spdlog::info("Dropping the connection");
+    asio::error_code error;
+    m_socket.close(error);
+    m_burst_timer.cancel();
+    m_report_timer.cancel();
+  }
+
+  void send_initial_response() {
+    std::vector<std::byte> body = {std::byte('B'), std::byte('O'),
+                                   INITIAL_RESPONSE_THIRD_BYTE, std::byte(0)};
+    for (int i = 0; i < m_config.devices; i++) {
+      for (const auto &iter : MIDI_STRING) {
+        body.push_back(std::byte(iter));
+      }
+      body.push_back(std::byte(0));
+    }
+    tcp::Header header;
+    header.set_body_size(body.size());
+
+    m_batch.clear();
+    m_batch.add(header);
+    m_batch.add_copy(asio::buffer(body));
+    write();
+  }
+
+  void schedule_burst() {
+    if (m_config.rate <= 0) {
+      return;
+    }
+    m_next_burst +=
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(m_config.burst) /
+                                          m_config.rate));
+    m_burst_timer.expires_at(m_next_burst);
+    m_burst_timer.async_wait(
+        [self = shared_from_this()](const asio::error_code &error) {
+          if (!error) {
+            self->send_burst();
+            self->schedule_burst();
+          }
+        });
+  }
+
+  void send_burst() {
+    if (m_write_in_flight) {
+      m_skipped_bursts++;
+      return;
+    }
+    m_batch.clear();
+    for (size_t i = 0; i < m_config.burst; i++) {
+      auto package = make_package();
+      m_batch.add(package);
+      m_sent_packages++;
+    }
+    write();
+  }
+
+  tcp::Package make_package() {
+    m_sequence++;
+    auto devices = static_cast<size_t>(m_config.devices);
+    auto device = std::byte(INCOMMING_MIDI_DEVICE_BASE + m_sequence % devices);
+    std::shared_ptr<tcp::Body> body;
+    if (m_config.sysex_every > 0 && m_sequence % m_config.sysex_every == 0) {
+      // The body refers to m_lcd, it is serialized before the next update.
+      m_lcd.at(LCD_SYSEX_COUNTER) =
+          static_cast<unsigned char>('0' + m_sequence % DECIMAL_BASE);
+      body = std::make_shared<tcp::SysExMidiBody>(
+          device, std::as_bytes(std::span(m_lcd)));
+    } else {
+      auto channel = static_cast<unsigned char>(
+          (m_sequence / devices) % FADERS_PER_DEVICE);
+      auto value = static_cast<unsigned int>(m_sequence);
+      body = std::make_shared<tcp::IncommingMidiBody>(
+          device,
+          ShortMessage({static_cast<unsigned char>(PITCH_BEND | channel),
+                        static_cast<unsigned char>(value & DATA_MASK),
+                        static_cast<unsigned char>((value >> DATA_BITS) &
+                                                   DATA_MASK)}));
+    }
+    return tcp::Package(body);
+  }
+
+  void write() {
+    m_write_in_flight = true;
+    if (m_capture) {
+      for (const auto &buffer : m_batch.buffers()) {
+        m_capture->record(
+            CaptureSource::TcpWrite, 0,
+            {static_cast<const std::byte *>(buffer.data()), buffer.size()});
+      }
+    }
+    asio::async_write(m_socket, m_batch.buffers(),
+                      [self = shared_from_this()](const asio::error_code &error,
+                                                  size_t /*bytes*/) {
+                        self->m_write_in_flight = false;
+                        if (error) {
+                          spdlog::warn("Failed to send: " + error.message());
+                        }
+                      });
+  }
+
+  void report() {
+    m_report_timer.expires_after(REPORT_INTERVAL);
+    m_report_timer.async_wait(
+        [self = shared_from_this()](const asio::error_code &error) {
+          if (error) {
+            return;
+          }
+          spdlog::info("sent " + std::to_string(self->m_sent_packages) +
+                       " packages, skipped " +
+                       std::to_string(self->m_skipped_bursts) +
+                       " bursts, received " +
+                       std::to_string(self->m_received_packages) +
+                       " packages (" + std::to_string(self->m_received_bytes) +
+                       " bytes)");
+          self->report();
+        });
+  }
+
+  asio::ip::tcp::socket m_socket;
+  TrafficConfig m_config;
+  std::shared_ptr<CaptureWriter> m_capture;
+  asio::steady_timer m_burst_timer;
+  asio::steady_timer m_report_timer;
+  tcp::StreamFramer m_framer;
+  WriteBatch m_batch;
+  bool m_write_in_flight = false;
+  State m_state = State::WaitForHello;
+  std::chrono::steady_clock::time_point m_next_burst;
+  size_t m_sequence = 0;
+  std::array<unsigned char, LCD_SYSEX.size()> m_lcd = LCD_SYSEX;
+  size_t m_sent_packages = 0;
+  size_t m_skipped_bursts = 0;
+  size_t m_received_packages = 0;
+  size_t m_running_packages = 0;
+  size_t m_received_bytes = 0;
+};
+} // namespace
+
+void serve_mock_mixer(asio::io_context &io_context,
+                      asio::ip::tcp::acceptor &acceptor,
+                      const TrafficConfig &config,
+                      const std::shared_ptr<CaptureWriter> &capture) {
+  acceptor.async_accept([&io_context, &acceptor, config,
+                         capture](const asio::error_code &error,
+                                  asio::ip::tcp::socket socket) {
+    if (error == asio::error::operation_aborted) {
+      // The acceptor was closed.
+      return;
+    }
+    if (error) {
+      spdlog::error("Failed to accept: " + error.message());
+      return;
+    }
+    std::make_shared<MockMixer>(io_context, std::move(socket), config, capture)
+        ->start();
+    serve_mock_mixer(io_context, acceptor, config, capture);
+  });
+}
+
+} // namespace sls3mcubridge
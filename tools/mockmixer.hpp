@@ -0,0 +1,44 @@
+#pragma once
+
+#include "capture.hpp"
+
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+
+// Stand-in for a StudioLive mixer. Answers the handshake of the bridge,
+// sends synthetic fader and LCD traffic and counts what the bridge sends.
+
+namespace sls3mcubridge {
+
+// Fader move of the first strip of the MAIN device as the mixer sends it.
+const std::array<std::byte, 16> FADER_FRAME = {
+    std::byte('U'),  std::byte('C'),  std::byte(0x00), std::byte(0x01),
+    std::byte(0x0a), std::byte(0x00), std::byte(0x4d), std::byte(0x4d),
+    std::byte(0x00), std::byte(0x00), std::byte(0x6c), std::byte(0x00),
+    std::byte(0xe0), std::byte(0x10), std::byte(0x7f), std::byte(0x00)};
+
+struct TrafficConfig {
+  int devices = 1;
+  // Packages per second, 0 only answers the handshake.
+  double rate = 0;
+  // Packages sent back to back every 1/rate * burst seconds.
+  size_t burst = 1;
+  // Every nth package is an LCD SysEx instead of a fader move, 0 for never.
+  size_t sysex_every = 0;
+  // Drops the connection after this many packages of the bridge following the
+  // handshake, 0 for never. The bridge reconnects like after a mixer restart.
+  size_t disconnect_after = 0;
+};
+
+// Serves every bridge connecting to `acceptor` with its own stand-in, until
+// the acceptor is closed.
+void serve_mock_mixer(asio::io_context &io_context,
+                      asio::ip::tcp::acceptor &acceptor,
+                      const TrafficConfig &config,
+                      const std::shared_ptr<CaptureWriter> &capture);
+
+} // namespace sls3mcubridge
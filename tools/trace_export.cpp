@@ -0,0 +1,58 @@
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "cxxopts.hpp"
+#include "spdlog/spdlog.h"
+
+#include "trace.hpp"
+
+// Converts a trace written by the bridge with --trace to the Chrome trace
+// event JSON format, open it in https://ui.perfetto.dev or chrome://tracing.
+
+int main(int argc, char **argv) {
+  cxxopts::Options options(
+      "sls3_mcu_bridge_trace_export",
+      "Convert a trace of sls3_mcu_bridge to Chrome trace event JSON");
+
+  cxxopts::ParseResult parse_result;
+  try {
+    options.add_options()("trace", "trace file written by the bridge.",
+                          cxxopts::value<std::string>())(
+        "output", "JSON file to write, standard output when not given.",
+        cxxopts::value<std::string>());
+    options.parse_positional({"trace"});
+    options.positional_help("trace");
+    parse_result = options.parse(argc, argv);
+  } catch (const std::exception &exc) {
+    std::cout << exc.what() << "\n" << "\n";
+    std::cout << options.help() << "\n";
+    return -1;
+  }
+
+  if (parse_result["trace"].count() == 0) {
+    std::cout << "trace is mandetory." << "\n" << "\n";
+    std::cout << options.help() << "\n";
+    return -1;
+  }
+
+  try {
+    sls3mcubridge::TraceReader reader(parse_result["trace"].as<std::string>());
+    if (parse_result["output"].count() == 0) {
+      sls3mcubridge::write_chrome_trace(reader, std::cout);
+      return 0;
+    }
+    auto path = parse_result["output"].as<std::string>();
+    std::ofstream output(path);
+    if (!output) {
+      spdlog::error("Could not open " + path);
+      return -1;
+    }
+    sls3mcubridge::write_chrome_trace(reader, output);
+  } catch (const std::exception &exc) {
+    spdlog::error(exc.what());
+    return -1;
+  }
+  return 0;
+}